@@ -0,0 +1,134 @@
+#include "concurrent_search_server.h"
+
+using namespace std;
+
+ConcurrentSearchServer::Snapshot::Snapshot(EpochReclaimer::ReadGuard guard, const SearchServer* server)
+    : guard_(move(guard)), server_(server) {
+}
+
+const SearchServer& ConcurrentSearchServer::Snapshot::operator*() const {
+    return *server_;
+}
+
+const SearchServer* ConcurrentSearchServer::Snapshot::operator->() const {
+    return server_;
+}
+
+ConcurrentSearchServer::ConcurrentSearchServer(SearchServer search_server, size_t publish_interval,
+                                               unique_ptr<WriteAheadLog> log)
+    : working_(move(search_server)),
+      published_owner_(make_shared<const SearchServer>(working_)),
+      published_(published_owner_.get()),
+      publish_interval_(max<size_t>(publish_interval, 1)),
+      log_(move(log)) {
+}
+
+ConcurrentSearchServer::Snapshot ConcurrentSearchServer::GetSnapshot() const {
+    // Эпоха объявляется раньше загрузки указателя: версия, которую увидит читатель, не будет освобождена.
+    auto guard = reclaimer_.Pin();
+    return {move(guard), published_.load()};
+}
+
+void ConcurrentSearchServer::AddDocument(int document_id, string_view document, DocumentStatus status,
+                                         const vector<int>& ratings) {
+    uint64_t generation;
+    {
+        lock_guard lock(write_mutex_);
+        CheckNotFailed();
+        working_.AddDocument(document_id, document, status, ratings);
+        generation = working_.GetGeneration();
+        if (log_) {
+            log_->Append({generation, LogRecord::Type::ADD, document_id, status, ratings, string(document)});
+        }
+    }
+    SyncLog(generation);
+    lock_guard lock(write_mutex_);
+    OnChanges(1);
+}
+
+void ConcurrentSearchServer::RemoveDocument(int document_id) {
+    uint64_t generation;
+    {
+        lock_guard lock(write_mutex_);
+        CheckNotFailed();
+        working_.RemoveDocument(document_id);
+        generation = working_.GetGeneration();
+        if (log_) {
+            log_->Append({generation, LogRecord::Type::REMOVE, document_id, DocumentStatus::ACTUAL, {}, {}});
+        }
+    }
+    SyncLog(generation);
+    lock_guard lock(write_mutex_);
+    OnChanges(1);
+}
+
+void ConcurrentSearchServer::Publish() {
+    lock_guard lock(write_mutex_);
+    CheckNotFailed();
+
+    // Все применённые изменения уже записаны в журнал, и этот поток дожидается их синхронизации сам.
+    if (pending_changes_ > 0) {
+        SyncLog(working_.GetGeneration());
+    }
+
+    PublishLocked();
+}
+
+void ConcurrentSearchServer::Checkpoint(const string& path) {
+    lock_guard lock(write_mutex_);
+    CheckNotFailed();
+    working_.SaveSnapshot(path);
+
+    if (log_) {
+        log_->Reset();
+    }
+}
+
+size_t ConcurrentSearchServer::GetPublishCount() const {
+    return publish_count_.load(memory_order_relaxed);
+}
+
+void ConcurrentSearchServer::PublishLocked() {
+
+    // Рабочая копия может содержать изменения других писателей, чьи записи ещё не на диске. Тогда версию
+    // опубликует писатель, чья синхронизация их покроет.
+    if (pending_changes_ == 0 || is_failed_ || (log_ && log_->GetDurableSequence() < working_.GetGeneration())) {
+        return;
+    }
+
+    auto next = make_shared<const SearchServer>(working_);
+    published_.store(next.get());
+    reclaimer_.Retire(exchange(published_owner_, move(next)));
+    reclaimer_.Reclaim();
+    pending_changes_ = 0;
+    publish_count_.fetch_add(1, memory_order_relaxed);
+}
+
+void ConcurrentSearchServer::CheckNotFailed() const {
+
+    if (is_failed_) {
+        throw runtime_error("Search server stopped after a log write error"s);
+    }
+}
+
+void ConcurrentSearchServer::OnChanges(size_t change_count) {
+    pending_changes_ += change_count;
+
+    if (pending_changes_ >= publish_interval_) {
+        PublishLocked();
+    }
+}
+
+void ConcurrentSearchServer::SyncLog(uint64_t generation) {
+
+    if (!log_) {
+        return;
+    }
+
+    try {
+        log_->Sync(generation);
+    } catch (...) {
+        is_failed_ = true;
+        throw;
+    }
+}
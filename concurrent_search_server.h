@@ -0,0 +1,113 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "document.h"
+#include "epoch_reclaimer.h"
+#include "search_server.h"
+#include "write_ahead_log.h"
+
+// Поисковый сервер для одновременных запросов и изменений. Запросы выполняются без блокировок на опубликованной
+// версии индекса; изменения применяются к рабочей копии по одному писателю за раз и видны запросам после
+// публикации. Версии делят запечатанные сегменты, слова и пословные частоты документов, поэтому публикация
+// копирует лишь изменяемый сегмент и плоские таблицы. Старая версия освобождается, когда её дочитают.
+class ConcurrentSearchServer {
+public:
+    // Опубликованная версия индекса; не освобождается, пока жив снимок.
+    class Snapshot {
+    public:
+        Snapshot(EpochReclaimer::ReadGuard guard, const SearchServer* server);
+
+        const SearchServer& operator*() const;
+
+        const SearchServer* operator->() const;
+
+    private:
+        EpochReclaimer::ReadGuard guard_;
+        const SearchServer* server_;
+    };
+
+    // Изменения публикуются автоматически, когда их накопится publish_interval; до этого - только вызовом Publish.
+    // С журналом изменение возвращает управление, лишь когда его запись окажется на диске; записи разных
+    // писателей синхронизируются с диском вместе. Запросы видят изменение не раньше, чем его запись на диске.
+    // Если синхронизация не удалась, изменение остаётся в рабочей копии, поэтому сервер перестаёт публиковать её
+    // и отклоняет изменения, Publish и Checkpoint; состояние восстанавливается из снимка и журнала.
+    explicit ConcurrentSearchServer(SearchServer search_server, size_t publish_interval = 1,
+                                    std::unique_ptr<WriteAheadLog> log = nullptr);
+
+    ConcurrentSearchServer(const ConcurrentSearchServer&) = delete;
+
+    ConcurrentSearchServer& operator=(const ConcurrentSearchServer&) = delete;
+
+    // Снимок нельзя держать дольше жизни сервера.
+    Snapshot GetSnapshot() const;
+
+    void AddDocument(int document_id, std::string_view document, DocumentStatus status,
+                     const std::vector<int>& ratings);
+
+    // Пакет публикуется целиком или не публикуется совсем; из журнала он тоже восстанавливается только целиком.
+    template<typename ExecutionPolicy>
+    void AddDocuments(ExecutionPolicy&& policy, const std::vector<DocumentData>& batch);
+
+    void RemoveDocument(int document_id);
+
+    // Делает видимыми запросам все применённые изменения.
+    void Publish();
+
+    // Сохраняет рабочую копию в снимок path и очищает журнал. Изменения на это время приостанавливаются.
+    void Checkpoint(const std::string& path);
+
+    // Число публикаций, начиная с исходной версии.
+    size_t GetPublishCount() const;
+
+private:
+    mutable EpochReclaimer reclaimer_;
+    std::mutex write_mutex_;
+    SearchServer working_;
+    std::shared_ptr<const SearchServer> published_owner_;
+    std::atomic<const SearchServer*> published_;
+    size_t publish_interval_;
+    size_t pending_changes_ = 0;
+    std::atomic<size_t> publish_count_ = 0;
+    std::unique_ptr<WriteAheadLog> log_;
+    // Синхронизация журнала не удалась: рабочая копия может содержать изменения, которых нет на диске.
+    std::atomic<bool> is_failed_ = false;
+
+    void PublishLocked();
+
+    void CheckNotFailed() const;
+
+    // Ждёт, пока записи журнала до поколения generation окажутся на диске; при ошибке отмечает сервер отказавшим.
+    void SyncLog(uint64_t generation);
+
+    void OnChanges(size_t change_count);
+};
+
+template<typename ExecutionPolicy>
+void ConcurrentSearchServer::AddDocuments(ExecutionPolicy&& policy, const std::vector<DocumentData>& batch) {
+    uint64_t generation;
+    {
+        std::lock_guard lock(write_mutex_);
+        CheckNotFailed();
+        working_.AddDocuments(std::forward<ExecutionPolicy>(policy), batch);
+        generation = working_.GetGeneration();
+        if (log_) {
+            std::vector<LogRecord> records;
+            records.reserve(batch.size());
+            for (const DocumentData& document: batch) {
+                records.push_back({generation - batch.size() + records.size() + 1, LogRecord::Type::ADD,
+                                   document.id, document.status, document.ratings, std::string(document.text)});
+            }
+            log_->AppendBatch(records);
+        }
+    }
+    SyncLog(generation);
+    std::lock_guard lock(write_mutex_);
+    OnChanges(batch.size());
+}
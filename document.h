@@ -1,7 +1,12 @@
 #pragma once
 
+#include <cstddef>
+#include <cstdint>
 #include <iosfwd>
 
+// Плотный внутренний номер документа, выдаётся по возрастанию при добавлении.
+using DocumentOrdinal = uint32_t;
+
 struct Document {
     Document() = default;
 
@@ -19,6 +24,8 @@ enum class DocumentStatus {
     REMOVED,
 };
 
+static const size_t DOCUMENT_STATUS_COUNT = 4;
+
 std::ostream& operator<<(std::ostream& out, const Document& document);
 
 void PrintDocument(const Document& document);
\ No newline at end of file
@@ -0,0 +1,189 @@
+#include "document_bitmap.h"
+#include <algorithm>
+#include <limits>
+
+using namespace std;
+
+DocumentBitmap::DocumentBitmap(const PostingList& postings) {
+    vector<uint16_t> values;
+    uint32_t key = 0;
+
+    for (PostingCursor cursor(postings, 0, numeric_limits<DocumentOrdinal>::max()); !cursor.IsEnd(); cursor.Next()) {
+        const DocumentOrdinal ordinal = cursor.GetOrdinal();
+        if (ordinal >> CHUNK_BITS != key) {
+            AddChunk(key, values);
+            key = ordinal >> CHUNK_BITS;
+        }
+        values.push_back(static_cast<uint16_t>(ordinal));
+    }
+
+    AddChunk(key, values);
+}
+
+bool DocumentBitmap::Contains(DocumentOrdinal ordinal) const {
+    const Chunk* chunk = FindChunk(ordinal >> CHUNK_BITS);
+
+    if (!chunk) {
+        return false;
+    }
+
+    const auto low = static_cast<uint16_t>(ordinal);
+
+    if (!chunk->words.empty()) {
+        return (chunk->words[low / 64] >> (low % 64)) & 1;
+    }
+
+    return binary_search(chunk->values.begin(), chunk->values.end(), low);
+}
+
+void DocumentBitmap::MarkRange(DocumentOrdinal first, DocumentOrdinal last, uint64_t* mask) const {
+    if (first >= last) {
+        return;
+    }
+
+    const size_t mask_size = (last - first + 63) / 64;
+    auto chunk = lower_bound(chunks_.begin(), chunks_.end(), first >> CHUNK_BITS,
+                             [](const Chunk& lhs, uint32_t key) {
+                                 return lhs.key < key;
+                             });
+
+    for (; chunk != chunks_.end() && (static_cast<size_t>(chunk->key) << CHUNK_BITS) < last; ++chunk) {
+        const size_t base = static_cast<size_t>(chunk->key) << CHUNK_BITS;
+
+        if (chunk->words.empty()) {
+            for (const uint16_t low: chunk->values) {
+                const size_t ordinal = base + low;
+                if (ordinal >= first && ordinal < last) {
+                    mask[(ordinal - first) / 64] |= uint64_t{1} << ((ordinal - first) % 64);
+                }
+            }
+            continue;
+        }
+
+        // Слово карты сдвигается на смещение куска относительно first и ложится на одно или два слова маски.
+        const size_t word_begin = base < first ? (first - base) / 64 : 0;
+        const size_t word_end = min(CHUNK_WORDS, (last - base + 63) / 64);
+
+        for (size_t word = word_begin; word < word_end; ++word) {
+            uint64_t bits = chunk->words[word];
+            const size_t word_first = base + 64 * word;
+            if (word_first < first) {
+                bits &= ~uint64_t{0} << (first - word_first);
+            }
+            if (word_first + 64 > last) {
+                bits &= ~uint64_t{0} >> (word_first + 64 - last);
+            }
+            if (bits == 0) {
+                continue;
+            }
+            if (word_first < first) {
+                mask[0] |= bits >> (first - word_first);
+                continue;
+            }
+            const size_t offset = word_first - first;
+            mask[offset / 64] |= bits << (offset % 64);
+            if (offset % 64 != 0 && offset / 64 + 1 < mask_size) {
+                mask[offset / 64 + 1] |= bits >> (64 - offset % 64);
+            }
+        }
+    }
+}
+
+size_t DocumentBitmap::size() const {
+    return size_;
+}
+
+size_t DocumentBitmap::GetMemoryUsage() const {
+    size_t memory_usage = chunks_.capacity() * sizeof(Chunk);
+
+    for (const Chunk& chunk: chunks_) {
+        memory_usage += chunk.values.capacity() * sizeof(uint16_t) + chunk.words.capacity() * sizeof(uint64_t);
+    }
+
+    return memory_usage;
+}
+
+void DocumentBitmap::AddChunk(uint32_t key, vector<uint16_t>& values) {
+    if (values.empty()) {
+        return;
+    }
+
+    Chunk& chunk = chunks_.emplace_back();
+    chunk.key = key;
+    size_ += values.size();
+
+    if (values.size() <= MAX_ARRAY_SIZE) {
+        chunk.values = values;
+    } else {
+        chunk.words.assign(CHUNK_WORDS, 0);
+        for (const uint16_t low: values) {
+            chunk.words[low / 64] |= uint64_t{1} << (low % 64);
+        }
+    }
+
+    values.clear();
+}
+
+const DocumentBitmap::Chunk* DocumentBitmap::FindChunk(uint32_t key) const {
+    const auto chunk = lower_bound(chunks_.begin(), chunks_.end(), key, [](const Chunk& lhs, uint32_t key) {
+        return lhs.key < key;
+    });
+
+    return chunk != chunks_.end() && chunk->key == key ? &*chunk : nullptr;
+}
+
+DocumentBitmapCache::DocumentBitmapCache(const DocumentBitmapCache&) {
+}
+
+DocumentBitmapCache& DocumentBitmapCache::operator=(const DocumentBitmapCache& other) {
+    if (this != &other) {
+        lock_guard lock(mutex_);
+        bitmaps_.clear();
+    }
+    return *this;
+}
+
+DocumentBitmapCache::DocumentBitmapCache(DocumentBitmapCache&& other) noexcept {
+    lock_guard lock(other.mutex_);
+    bitmaps_ = move(other.bitmaps_);
+}
+
+DocumentBitmapCache& DocumentBitmapCache::operator=(DocumentBitmapCache&& other) noexcept {
+    if (this != &other) {
+        scoped_lock lock(mutex_, other.mutex_);
+        bitmaps_ = move(other.bitmaps_);
+    }
+    return *this;
+}
+
+shared_ptr<const DocumentBitmap> DocumentBitmapCache::Get(size_t key, const PostingList& postings) {
+    {
+        lock_guard lock(mutex_);
+        const auto it = bitmaps_.find(key);
+        if (it != bitmaps_.end()) {
+            return it->second;
+        }
+    }
+
+    // Карта строится без блокировки, чтобы не задерживать запросы по другим постинг-листам.
+    auto bitmap = make_shared<const DocumentBitmap>(postings);
+    lock_guard lock(mutex_);
+
+    return bitmaps_.emplace(key, move(bitmap)).first->second;
+}
+
+void DocumentBitmapCache::Invalidate(size_t key) {
+    lock_guard lock(mutex_);
+    bitmaps_.erase(key);
+}
+
+size_t DocumentBitmapCache::GetMemoryUsage() const {
+    lock_guard lock(mutex_);
+    size_t memory_usage = 0;
+
+    for (const auto& [key, bitmap]: bitmaps_) {
+        memory_usage += bitmap->GetMemoryUsage();
+    }
+
+    return memory_usage;
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "document.h"
+#include "posting_list.h"
+
+// Сжатое множество номеров документов в духе Roaring: номера делятся на куски по 2^16,
+// разреженный кусок хранится отсортированным массивом младших 16 бит, плотный - битовой картой.
+class DocumentBitmap {
+public:
+    DocumentBitmap() = default;
+
+    explicit DocumentBitmap(const PostingList& postings);
+
+    bool Contains(DocumentOrdinal ordinal) const;
+
+    // Устанавливает в mask бит i для каждого элемента first + i из [first, last).
+    // mask должна вмещать (last - first + 63) / 64 слов.
+    void MarkRange(DocumentOrdinal first, DocumentOrdinal last, uint64_t* mask) const;
+
+    size_t size() const;
+
+    size_t GetMemoryUsage() const;
+
+private:
+    static constexpr size_t CHUNK_BITS = 16;
+    static constexpr size_t CHUNK_SIZE = size_t{1} << CHUNK_BITS;
+    static constexpr size_t CHUNK_WORDS = CHUNK_SIZE / 64;
+    // Больше стольких элементов массив занимает больше места, чем битовая карта куска (8 КиБ).
+    static constexpr size_t MAX_ARRAY_SIZE = 4096;
+
+    // Ровно одно из полей values и words непусто.
+    struct Chunk {
+        uint32_t key;
+        std::vector<uint16_t> values;
+        std::vector<uint64_t> words;
+    };
+
+    std::vector<Chunk> chunks_; // По возрастанию key.
+    size_t size_ = 0;
+
+    void AddChunk(uint32_t key, std::vector<uint16_t>& values);
+
+    const Chunk* FindChunk(uint32_t key) const;
+};
+
+// Битовые карты длинных постинг-листов; ключ - номер постинг-листа у владельца. Запросы читают кэш параллельно;
+// карта, отданная запросу, живёт, пока он её держит, даже если постинги тем временем изменились.
+class DocumentBitmapCache {
+public:
+    DocumentBitmapCache() = default;
+
+    // Кэш - производные данные, поэтому копия начинает с пустого кэша.
+    DocumentBitmapCache(const DocumentBitmapCache&);
+
+    DocumentBitmapCache& operator=(const DocumentBitmapCache&);
+
+    // Перемещение переносит карты: владелец кэша перемещается вместе со своими постинг-листами.
+    DocumentBitmapCache(DocumentBitmapCache&& other) noexcept;
+
+    DocumentBitmapCache& operator=(DocumentBitmapCache&& other) noexcept;
+
+    // Возвращает карту постинг-листа, при первом обращении строя её по postings.
+    std::shared_ptr<const DocumentBitmap> Get(size_t key, const PostingList& postings);
+
+    // Вызывается при каждом изменении постинг-листа.
+    void Invalidate(size_t key);
+
+    size_t GetMemoryUsage() const;
+
+private:
+    mutable std::mutex mutex_;
+    std::unordered_map<size_t, std::shared_ptr<const DocumentBitmap>> bitmaps_;
+};
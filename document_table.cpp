@@ -0,0 +1,192 @@
+#include "document_table.h"
+#include "index_snapshot.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+using namespace std;
+
+DocumentIdMap::DocumentIdMap(const vector<Entry>& entries) : size_(entries.size()) {
+    // Листы заполняются наполовину, чтобы вставки не сразу приводили к разбиению.
+    for (size_t begin = 0; begin < entries.size(); begin += MAX_LEAF_SIZE / 2) {
+        const size_t end = min(begin + MAX_LEAF_SIZE / 2, entries.size());
+        leaves_.push_back(make_shared<Leaf>(entries.begin() + begin, entries.begin() + end));
+    }
+}
+
+void DocumentIdMap::Insert(int document_id, DocumentOrdinal ordinal) {
+
+    ++size_;
+
+    if (leaves_.empty()) {
+        leaves_.push_back(make_shared<Leaf>(1, Entry{document_id, ordinal}));
+        return;
+    }
+
+    const size_t leaf_index = FindLeaf(document_id);
+    Leaf& leaf = GetOwnedLeaf(leaf_index);
+    const auto it = lower_bound(leaf.begin(), leaf.end(), Entry{document_id, 0});
+    leaf.insert(it, {document_id, ordinal});
+
+    if (leaf.size() > MAX_LEAF_SIZE) {
+        const auto middle = leaf.begin() + leaf.size() / 2;
+        auto upper = make_shared<Leaf>(middle, leaf.end());
+        leaf.erase(middle, leaf.end());
+        leaves_.insert(leaves_.begin() + leaf_index + 1, move(upper));
+    }
+}
+
+bool DocumentIdMap::Erase(int document_id) {
+
+    if (!Find(document_id)) {
+        return false;
+    }
+
+    const size_t leaf_index = FindLeaf(document_id);
+    Leaf& leaf = GetOwnedLeaf(leaf_index);
+    leaf.erase(lower_bound(leaf.begin(), leaf.end(), Entry{document_id, 0}));
+    --size_;
+
+    if (leaf.empty()) {
+        leaves_.erase(leaves_.begin() + leaf_index);
+    }
+
+    return true;
+}
+
+optional<DocumentOrdinal> DocumentIdMap::Find(int document_id) const {
+
+    if (leaves_.empty()) {
+        return nullopt;
+    }
+
+    const Leaf& leaf = *leaves_[FindLeaf(document_id)];
+    const auto it = lower_bound(leaf.begin(), leaf.end(), Entry{document_id, 0});
+
+    if (it != leaf.end() && it->first == document_id) {
+        return it->second;
+    }
+
+    return nullopt;
+}
+
+size_t DocumentIdMap::size() const {
+    return size_;
+}
+
+DocumentIdMap::Iterator DocumentIdMap::begin() const {
+    return {&leaves_, 0, 0};
+}
+
+DocumentIdMap::Iterator DocumentIdMap::end() const {
+    return {&leaves_, leaves_.size(), 0};
+}
+
+size_t DocumentIdMap::FindLeaf(int document_id) const {
+    const auto it = upper_bound(leaves_.begin(), leaves_.end(), document_id,
+                                [](int id, const shared_ptr<Leaf>& leaf) {
+                                    return id < leaf->front().first;
+                                });
+    return it == leaves_.begin() ? 0 : it - leaves_.begin() - 1;
+}
+
+DocumentIdMap::Leaf& DocumentIdMap::GetOwnedLeaf(size_t leaf) {
+
+    if (leaves_[leaf].use_count() > 1) {
+        leaves_[leaf] = make_shared<Leaf>(*leaves_[leaf]);
+    }
+
+    return *leaves_[leaf];
+}
+
+DocumentOrdinal DocumentTable::Add(int document_id, int rating, DocumentStatus status) {
+    const auto ordinal = static_cast<DocumentOrdinal>(ids_.size());
+
+    ordinals_.Insert(document_id, ordinal);
+    ids_.push_back(document_id);
+    ratings_.push_back(rating);
+    statuses_.push_back(status);
+
+    if (removed_.size() * 64 <= ordinal) {
+        removed_.push_back(0);
+    }
+
+    return ordinal;
+}
+
+void DocumentTable::Remove(int document_id) {
+    const auto ordinal = ordinals_.Find(document_id);
+
+    if (!ordinal) {
+        return;
+    }
+
+    removed_[*ordinal / 64] |= uint64_t{1} << (*ordinal % 64);
+    ordinals_.Erase(document_id);
+}
+
+optional<DocumentOrdinal> DocumentTable::FindOrdinal(int document_id) const {
+    return ordinals_.Find(document_id);
+}
+
+bool DocumentTable::Contains(int document_id) const {
+    return ordinals_.Find(document_id).has_value();
+}
+
+const vector<uint64_t>& DocumentTable::GetRemovedMask() const {
+    return removed_;
+}
+
+size_t DocumentTable::GetOrdinalCount() const {
+    return ids_.size();
+}
+
+size_t DocumentTable::size() const {
+    return ordinals_.size();
+}
+
+DocumentIdMap::Iterator DocumentTable::begin() const {
+    return ordinals_.begin();
+}
+
+DocumentIdMap::Iterator DocumentTable::end() const {
+    return ordinals_.end();
+}
+
+void DocumentTable::Save(SnapshotWriter& writer) const {
+    writer.WriteArray(ids_.data(), ids_.size());
+    writer.WriteArray(ratings_.data(), ratings_.size());
+    writer.WriteArray(statuses_.data(), statuses_.size());
+    writer.WriteArray(removed_.data(), removed_.size());
+}
+
+DocumentTable DocumentTable::Load(SnapshotReader& reader) {
+    DocumentTable documents;
+    const auto [ids, id_count] = reader.ReadArray<int>();
+    const auto [ratings, rating_count] = reader.ReadArray<int>();
+    const auto [statuses, status_count] = reader.ReadArray<DocumentStatus>();
+    const auto [removed, removed_size] = reader.ReadArray<uint64_t>();
+
+    if (rating_count != id_count || status_count != id_count || removed_size != (id_count + 63) / 64
+        || any_of(statuses, statuses + status_count, [](DocumentStatus status) {
+            return static_cast<size_t>(status) >= DOCUMENT_STATUS_COUNT;
+        })) {
+        throw runtime_error("Snapshot document table is inconsistent"s);
+    }
+
+    documents.ids_.assign(ids, ids + id_count);
+    documents.ratings_.assign(ratings, ratings + rating_count);
+    documents.statuses_.assign(statuses, statuses + status_count);
+    documents.removed_.assign(removed, removed + removed_size);
+
+    vector<DocumentIdMap::Entry> entries;
+    for (size_t ordinal = 0; ordinal < id_count; ++ordinal) {
+        if (!documents.IsRemoved(ordinal)) {
+            entries.emplace_back(ids[ordinal], static_cast<DocumentOrdinal>(ordinal));
+        }
+    }
+    sort(entries.begin(), entries.end());
+    documents.ordinals_ = DocumentIdMap(entries);
+
+    return documents;
+}
@@ -0,0 +1,157 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <memory>
+#include <optional>
+#include <utility>
+#include <vector>
+
+#include "document.h"
+
+class SnapshotReader;
+class SnapshotWriter;
+
+// Отображение id документа в номер, упорядоченное по id. Записи лежат в отсортированных листах ограниченного
+// размера; копия отображения делит листы с оригиналом, а изменяемый лист копируется, только если он общий.
+class DocumentIdMap {
+public:
+    using Entry = std::pair<int, DocumentOrdinal>;
+    using Leaf = std::vector<Entry>;
+
+    // Обходит id по возрастанию.
+    class Iterator {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = int;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const int*;
+        using reference = const int&;
+
+        Iterator() = default;
+
+        Iterator(const std::vector<std::shared_ptr<Leaf>>* leaves, size_t leaf, size_t position)
+            : leaves_(leaves), leaf_(leaf), position_(position) {
+        }
+
+        reference operator*() const {
+            return (*(*leaves_)[leaf_])[position_].first;
+        }
+
+        pointer operator->() const {
+            return &**this;
+        }
+
+        Iterator& operator++() {
+            if (++position_ == (*leaves_)[leaf_]->size()) {
+                ++leaf_;
+                position_ = 0;
+            }
+            return *this;
+        }
+
+        Iterator operator++(int) {
+            Iterator old = *this;
+            ++*this;
+            return old;
+        }
+
+        bool operator==(const Iterator& other) const {
+            return leaf_ == other.leaf_ && position_ == other.position_;
+        }
+
+        bool operator!=(const Iterator& other) const {
+            return !(*this == other);
+        }
+
+    private:
+        const std::vector<std::shared_ptr<Leaf>>* leaves_ = nullptr;
+        size_t leaf_ = 0;
+        size_t position_ = 0;
+    };
+
+    DocumentIdMap() = default;
+
+    // Записи должны идти по возрастанию id.
+    explicit DocumentIdMap(const std::vector<Entry>& entries);
+
+    // id не должен уже присутствовать.
+    void Insert(int document_id, DocumentOrdinal ordinal);
+
+    bool Erase(int document_id);
+
+    std::optional<DocumentOrdinal> Find(int document_id) const;
+
+    size_t size() const;
+
+    Iterator begin() const;
+
+    Iterator end() const;
+
+private:
+    static const size_t MAX_LEAF_SIZE = 512;
+
+    // Непустые листы по возрастанию id.
+    std::vector<std::shared_ptr<Leaf>> leaves_;
+    size_t size_ = 0;
+
+    // Лист, в котором лежит или должен лежать id.
+    size_t FindLeaf(int document_id) const;
+
+    Leaf& GetOwnedLeaf(size_t leaf);
+};
+
+// Таблица атрибутов документов: внешние id отображаются в плотные порядковые номера,
+// рейтинг и статус хранятся по столбцам, индексируемым этими номерами.
+// Номера удалённых документов повторно не выдаются и отмечаются в битовой маске.
+// Копирование дешёвое: отображение id делит листы с оригиналом, остальное - плоские массивы.
+class DocumentTable {
+public:
+    DocumentOrdinal Add(int document_id, int rating, DocumentStatus status);
+
+    void Remove(int document_id);
+
+    std::optional<DocumentOrdinal> FindOrdinal(int document_id) const;
+
+    bool Contains(int document_id) const;
+
+    bool IsRemoved(DocumentOrdinal ordinal) const {
+        return (removed_[ordinal / 64] >> (ordinal % 64)) & 1;
+    }
+
+    // Бит ordinal установлен у удалённых документов.
+    const std::vector<uint64_t>& GetRemovedMask() const;
+
+    int GetId(DocumentOrdinal ordinal) const {
+        return ids_[ordinal];
+    }
+
+    int GetRating(DocumentOrdinal ordinal) const {
+        return ratings_[ordinal];
+    }
+
+    DocumentStatus GetStatus(DocumentOrdinal ordinal) const {
+        return statuses_[ordinal];
+    }
+
+    // Количество выданных номеров, включая номера удалённых документов.
+    size_t GetOrdinalCount() const;
+
+    size_t size() const;
+
+    DocumentIdMap::Iterator begin() const;
+
+    DocumentIdMap::Iterator end() const;
+
+    void Save(SnapshotWriter& writer) const;
+
+    static DocumentTable Load(SnapshotReader& reader);
+
+private:
+    DocumentIdMap ordinals_;
+    std::vector<int> ids_;
+    std::vector<int> ratings_;
+    std::vector<DocumentStatus> statuses_;
+    std::vector<uint64_t> removed_;
+};
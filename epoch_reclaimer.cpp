@@ -0,0 +1,97 @@
+#include "epoch_reclaimer.h"
+
+#include <algorithm>
+#include <functional>
+#include <thread>
+
+using namespace std;
+
+EpochReclaimer::ReadGuard::ReadGuard(const EpochReclaimer& reclaimer)
+    : slot_(&reclaimer.AcquireSlot()) {
+}
+
+EpochReclaimer::ReadGuard::ReadGuard(ReadGuard&& other) noexcept
+    : slot_(exchange(other.slot_, nullptr)) {
+}
+
+EpochReclaimer::ReadGuard& EpochReclaimer::ReadGuard::operator=(ReadGuard&& other) noexcept {
+
+    if (this != &other) {
+        Release();
+        slot_ = exchange(other.slot_, nullptr);
+    }
+
+    return *this;
+}
+
+EpochReclaimer::ReadGuard::~ReadGuard() {
+    Release();
+}
+
+void EpochReclaimer::ReadGuard::Release() {
+
+    if (slot_) {
+        slot_->store(IDLE, memory_order_release);
+        slot_ = nullptr;
+    }
+}
+
+EpochReclaimer::EpochReclaimer(size_t slot_count)
+    : slot_count_(max<size_t>(slot_count, 1)), slots_(make_unique<Slot[]>(slot_count_)) {
+}
+
+EpochReclaimer::ReadGuard EpochReclaimer::Pin() const {
+    return ReadGuard(*this);
+}
+
+void EpochReclaimer::Retire(shared_ptr<const void> object) {
+    // Объект, убранный до сдвига эпохи, мог достаться только читателям с эпохой не больше retire_epoch.
+    const uint64_t retire_epoch = epoch_.fetch_add(1);
+    lock_guard lock(retired_mutex_);
+    retired_.emplace_back(retire_epoch, move(object));
+}
+
+size_t EpochReclaimer::Reclaim() {
+    uint64_t min_epoch = IDLE;
+
+    for (size_t i = 0; i < slot_count_; ++i) {
+        min_epoch = min(min_epoch, slots_[i].epoch.load());
+    }
+
+    vector<shared_ptr<const void>> reclaimed;
+    {
+        lock_guard lock(retired_mutex_);
+        const auto it = partition(retired_.begin(), retired_.end(), [min_epoch](const auto& retired) {
+            return retired.first >= min_epoch;
+        });
+        for (auto reclaimed_it = it; reclaimed_it != retired_.end(); ++reclaimed_it) {
+            reclaimed.push_back(move(reclaimed_it->second));
+        }
+        retired_.erase(it, retired_.end());
+    }
+
+    // Деструкторы объектов выполняются вне блокировки.
+    return reclaimed.size();
+}
+
+size_t EpochReclaimer::GetRetiredCount() const {
+    lock_guard lock(retired_mutex_);
+    return retired_.size();
+}
+
+atomic<uint64_t>& EpochReclaimer::AcquireSlot() const {
+    size_t index = hash<thread::id>{}(this_thread::get_id()) % slot_count_;
+
+    while (true) {
+        for (size_t attempt = 0; attempt < slot_count_; ++attempt) {
+            atomic<uint64_t>& slot = slots_[index].epoch;
+            uint64_t expected = IDLE;
+            // Эпоха объявляется до того, как читатель загрузит указатель на общий объект (seq_cst).
+            if (slot.load(memory_order_relaxed) == IDLE && slot.compare_exchange_strong(expected, epoch_.load())) {
+                return slot;
+            }
+            index = (index + 1) % slot_count_;
+        }
+        this_thread::yield();
+    }
+}
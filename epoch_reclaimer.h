@@ -0,0 +1,63 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+// Отложенное освобождение объектов, которые читают другие потоки без блокировок (epoch-based reclamation).
+// Читатель на время чтения объявляет в своём слоте текущую эпоху. Писатель, убрав объект из общего доступа,
+// передаёт его в Retire, и объект освобождается, когда закончат все читатели, объявившие эпоху не позже этого.
+class EpochReclaimer {
+public:
+    // Эпоха читателя объявлена, пока жив объект; объекты, доступные в момент объявления, не освобождаются.
+    class ReadGuard {
+    public:
+        ReadGuard() = default;
+
+        explicit ReadGuard(const EpochReclaimer& reclaimer);
+
+        ReadGuard(ReadGuard&& other) noexcept;
+
+        ReadGuard& operator=(ReadGuard&& other) noexcept;
+
+        ~ReadGuard();
+
+    private:
+        std::atomic<uint64_t>* slot_ = nullptr;
+
+        void Release();
+    };
+
+    // Одновременно читать могут не более slot_count потоков, остальные ждут освобождения слота.
+    explicit EpochReclaimer(size_t slot_count = 64);
+
+    ReadGuard Pin() const;
+
+    // Объект уже недоступен новым читателям.
+    void Retire(std::shared_ptr<const void> object);
+
+    // Освобождает объекты, которые уже никто не читает. Возвращает их количество.
+    size_t Reclaim();
+
+    size_t GetRetiredCount() const;
+
+private:
+    static const uint64_t IDLE = UINT64_MAX;
+
+    // Слот на отдельной кэш-линии, чтобы читатели разных потоков не мешали друг другу.
+    struct alignas(64) Slot {
+        std::atomic<uint64_t> epoch{IDLE};
+    };
+
+    std::atomic<uint64_t> epoch_{0};
+    size_t slot_count_;
+    std::unique_ptr<Slot[]> slots_;
+    mutable std::mutex retired_mutex_;
+    std::vector<std::pair<uint64_t, std::shared_ptr<const void>>> retired_;
+
+    std::atomic<uint64_t>& AcquireSlot() const;
+};
@@ -0,0 +1,188 @@
+#include "forward_index.h"
+#include "index_snapshot.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+using namespace std;
+
+optional<double> DocumentTerms::Find(TermId term) const {
+    const TermId* it = lower_bound(terms, terms + size, term);
+
+    if (it == terms + size || *it != term) {
+        return nullopt;
+    }
+
+    return term_freqs[it - terms];
+}
+
+DocumentTerms ForwardIndex::Get(DocumentOrdinal ordinal) const {
+    const Block& block = *blocks_[ordinal / BLOCK_SIZE];
+    const size_t position = ordinal % BLOCK_SIZE;
+    const uint32_t begin = block.offsets[position];
+
+    return {block.terms.data() + begin, block.term_freqs.data() + begin, block.offsets[position + 1] - begin};
+}
+
+void ForwardIndex::Erase(const vector<DocumentOrdinal>& ordinals) {
+
+    for (auto it = ordinals.begin(); it != ordinals.end();) {
+        const size_t block_index = *it / BLOCK_SIZE;
+        const Block& block = *blocks_[block_index];
+        const auto first_ordinal = static_cast<DocumentOrdinal>(block_index * BLOCK_SIZE);
+        vector<uint32_t> offsets = {0};
+        vector<TermId> terms;
+        vector<double> term_freqs;
+
+        for (size_t position = 0; position + 1 < block.offsets.size(); ++position) {
+            if (it != ordinals.end() && *it == first_ordinal + position) {
+                while (it != ordinals.end() && *it == first_ordinal + position) {
+                    ++it;
+                }
+            } else {
+                terms.insert(terms.end(), block.terms.begin() + block.offsets[position],
+                             block.terms.begin() + block.offsets[position + 1]);
+                term_freqs.insert(term_freqs.end(), block.term_freqs.begin() + block.offsets[position],
+                                  block.term_freqs.begin() + block.offsets[position + 1]);
+            }
+            offsets.push_back(static_cast<uint32_t>(terms.size()));
+        }
+
+        auto erased = make_shared<Block>();
+        erased->offsets = move(offsets);
+        erased->terms = move(terms);
+        erased->term_freqs = move(term_freqs);
+        blocks_[block_index] = move(erased);
+    }
+}
+
+size_t ForwardIndex::GetDocumentCount() const {
+    return document_count_;
+}
+
+size_t ForwardIndex::GetMemoryUsage() const {
+    size_t memory_usage = blocks_.capacity() * sizeof(shared_ptr<Block>);
+
+    for (const auto& block: blocks_) {
+        memory_usage += sizeof(Block) + block->offsets.GetMemoryUsage() + block->terms.GetMemoryUsage()
+                        + block->term_freqs.GetMemoryUsage();
+    }
+
+    return memory_usage;
+}
+
+void ForwardIndex::Save(SnapshotWriter& writer) const {
+    writer.Write(static_cast<uint64_t>(document_count_));
+
+    for (const auto& block: blocks_) {
+        writer.WriteArray(block->offsets.data(), block->offsets.size());
+        writer.WriteArray(block->terms.data(), block->terms.size());
+        writer.WriteArray(block->term_freqs.data(), block->term_freqs.size());
+    }
+}
+
+ForwardIndex ForwardIndex::Load(SnapshotReader& reader, size_t term_count) {
+    ForwardIndex index;
+    index.document_count_ = reader.Read<uint64_t>();
+
+    for (size_t first_ordinal = 0; first_ordinal < index.document_count_; first_ordinal += BLOCK_SIZE) {
+        auto block = make_shared<Block>();
+        block->offsets = reader.ReadMappedArray<uint32_t>();
+        block->terms = reader.ReadMappedArray<TermId>();
+        block->term_freqs = reader.ReadMappedArray<double>();
+        const MappedArray<uint32_t>& offsets = block->offsets;
+        const MappedArray<TermId>& terms = block->terms;
+
+        bool is_consistent = offsets.size() == min(BLOCK_SIZE, index.document_count_ - first_ordinal) + 1
+                             && offsets[0] == 0 && offsets.back() == terms.size()
+                             && terms.size() == block->term_freqs.size();
+
+        for (size_t position = 0; is_consistent && position + 1 < offsets.size(); ++position) {
+            is_consistent = offsets[position] <= offsets[position + 1]
+                            && adjacent_find(terms.begin() + offsets[position], terms.begin() + offsets[position + 1],
+                                             greater_equal<TermId>()) == terms.begin() + offsets[position + 1];
+        }
+
+        if (!is_consistent || any_of(terms.begin(), terms.end(), [term_count](TermId term) {
+            return term >= term_count;
+        })) {
+            throw runtime_error("Snapshot forward index is inconsistent"s);
+        }
+
+        index.blocks_.push_back(move(block));
+    }
+
+    return index;
+}
+
+ForwardIndex::Block& ForwardIndex::GetLastBlock() {
+
+    if (document_count_ % BLOCK_SIZE == 0) {
+        auto block = make_shared<Block>();
+        block->offsets = vector<uint32_t>{0};
+        blocks_.push_back(move(block));
+    } else if (blocks_.back().use_count() > 1) {
+        blocks_.back() = make_shared<Block>(*blocks_.back());
+    }
+
+    return *blocks_.back();
+}
+
+void ForwardIndex::SealLastBlock() {
+
+    if (document_count_ % BLOCK_SIZE == 0) {
+        Block& block = *blocks_.back();
+        block.offsets.ShrinkToFit();
+        block.terms.ShrinkToFit();
+        block.term_freqs.ShrinkToFit();
+    }
+}
+
+WordFrequencies::WordFrequencies(const TermDictionary& dictionary, DocumentTerms terms)
+        : dictionary_(&dictionary), terms_(terms) {
+}
+
+WordFrequencies::Iterator WordFrequencies::begin() const {
+    return {dictionary_, terms_.terms, terms_.term_freqs};
+}
+
+WordFrequencies::Iterator WordFrequencies::end() const {
+    return {dictionary_, terms_.terms + terms_.size, terms_.term_freqs + terms_.size};
+}
+
+size_t WordFrequencies::size() const {
+    return terms_.size;
+}
+
+bool WordFrequencies::empty() const {
+    return terms_.size == 0;
+}
+
+size_t WordFrequencies::count(string_view word) const {
+    return Find(word) ? 1 : 0;
+}
+
+optional<double> WordFrequencies::Find(string_view word) const {
+
+    if (empty()) {
+        return nullopt;
+    }
+
+    const optional<TermId> term = dictionary_->Find(word);
+
+    return term ? terms_.Find(*term) : nullopt;
+}
+
+const DocumentTerms& WordFrequencies::GetTerms() const {
+    return terms_;
+}
+
+bool WordFrequencies::operator==(const WordFrequencies& other) const {
+    return size() == other.size() && all_of(begin(), end(), [&other](const auto& word_freq) {
+        return other.Find(word_freq.first) == word_freq.second;
+    });
+}
+
+bool WordFrequencies::operator!=(const WordFrequencies& other) const {
+    return !(*this == other);
+}
@@ -0,0 +1,157 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <memory>
+#include <optional>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "document.h"
+#include "mapped_array.h"
+#include "term_dictionary.h"
+
+class SnapshotReader;
+class SnapshotWriter;
+
+// Слова одного документа: id термов по возрастанию и их частоты, лежащие подряд в памяти прямого индекса.
+struct DocumentTerms {
+    const TermId* terms = nullptr;
+    const double* term_freqs = nullptr;
+    size_t size = 0;
+
+    // Частота терма в документе или nullopt, если терма в нём нет.
+    std::optional<double> Find(TermId term) const;
+};
+
+// Прямой индекс: слова каждого документа по номеру документа. Документы хранятся блоками по BLOCK_SIZE
+// номеров, в блоке - три непрерывных массива: границы документов, id термов и частоты. Заполненные блоки
+// не меняются и делятся между копиями индекса, последний копируется при изменении, если он общий.
+// Массивы загруженного индекса ссылаются на память снимка.
+class ForwardIndex {
+public:
+    static constexpr size_t BLOCK_SIZE = 4096;
+
+    // Дописывает слова документа со следующим номером: пары (id терма, частота) по возрастанию id.
+    template<typename TermFreqs>
+    void Add(const TermFreqs& term_freqs);
+
+    // Результат действителен до следующего изменения индекса.
+    DocumentTerms Get(DocumentOrdinal ordinal) const;
+
+    // Стирает слова документов с номерами ordinals, упорядоченными по возрастанию. Затронутые блоки
+    // пересобираются заново, так что копии индекса их прежнего содержимого не теряют.
+    void Erase(const std::vector<DocumentOrdinal>& ordinals);
+
+    size_t GetDocumentCount() const;
+
+    size_t GetMemoryUsage() const;
+
+    void Save(SnapshotWriter& writer) const;
+
+    // Проверяет, что id термов меньше term_count и упорядочены внутри документа.
+    static ForwardIndex Load(SnapshotReader& reader, size_t term_count);
+
+private:
+    struct Block {
+        // Слова i-го документа блока - позиции [offsets[i], offsets[i + 1]) массивов terms и term_freqs.
+        MappedArray<uint32_t> offsets;
+        MappedArray<TermId> terms;
+        MappedArray<double> term_freqs;
+    };
+
+    std::vector<std::shared_ptr<Block>> blocks_;
+    size_t document_count_ = 0;
+
+    Block& GetLastBlock();
+
+    void SealLastBlock();
+};
+
+template<typename TermFreqs>
+void ForwardIndex::Add(const TermFreqs& term_freqs) {
+    Block& block = GetLastBlock();
+    std::vector<TermId>& terms = block.terms.GetMutable();
+    std::vector<double>& freqs = block.term_freqs.GetMutable();
+
+    for (const auto& [term, term_freq]: term_freqs) {
+        terms.push_back(term);
+        freqs.push_back(term_freq);
+    }
+
+    block.offsets.GetMutable().push_back(static_cast<uint32_t>(terms.size()));
+    ++document_count_;
+    SealLastBlock();
+}
+
+// Частоты слов документа - представление прямого индекса без копирования. Пары (слово, частота) обходятся
+// по возрастанию id терма, то есть в порядке первого появления слов в индексе, а не по алфавиту.
+// Действительно до следующего изменения сервера.
+class WordFrequencies {
+public:
+    class Iterator {
+    public:
+        using iterator_category = std::input_iterator_tag;
+        using value_type = std::pair<std::string_view, double>;
+        using difference_type = std::ptrdiff_t;
+        using pointer = void;
+        using reference = value_type;
+
+        Iterator(const TermDictionary* dictionary, const TermId* term, const double* term_freq)
+            : dictionary_(dictionary), term_(term), term_freq_(term_freq) {
+        }
+
+        value_type operator*() const {
+            return {dictionary_->GetTerm(*term_), *term_freq_};
+        }
+
+        Iterator& operator++() {
+            ++term_;
+            ++term_freq_;
+            return *this;
+        }
+
+        bool operator==(const Iterator& other) const {
+            return term_ == other.term_;
+        }
+
+        bool operator!=(const Iterator& other) const {
+            return term_ != other.term_;
+        }
+
+    private:
+        const TermDictionary* dictionary_;
+        const TermId* term_;
+        const double* term_freq_;
+    };
+
+    WordFrequencies() = default;
+
+    WordFrequencies(const TermDictionary& dictionary, DocumentTerms terms);
+
+    Iterator begin() const;
+
+    Iterator end() const;
+
+    size_t size() const;
+
+    bool empty() const;
+
+    // Как у std::map: 1, если слово есть в документе, иначе 0.
+    size_t count(std::string_view word) const;
+
+    std::optional<double> Find(std::string_view word) const;
+
+    const DocumentTerms& GetTerms() const;
+
+    // Сравнивает наборы пар (слово, частота): у одинаковых документов разных серверов id термов могут различаться.
+    bool operator==(const WordFrequencies& other) const;
+
+    bool operator!=(const WordFrequencies& other) const;
+
+private:
+    const TermDictionary* dictionary_ = nullptr;
+    DocumentTerms terms_;
+};
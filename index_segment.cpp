@@ -0,0 +1,198 @@
+#include "index_segment.h"
+#include "index_snapshot.h"
+#include <functional>
+#include <limits>
+#include <stdexcept>
+
+using namespace std;
+
+namespace {
+
+bool IsRemoved(const vector<uint64_t>& removed_mask, DocumentOrdinal ordinal) {
+    return (removed_mask[ordinal / 64] >> (ordinal % 64)) & 1;
+}
+
+} // namespace
+
+IndexSegment::IndexSegment(DocumentOrdinal first_ordinal, PostingFormat format)
+        : first_ordinal_(first_ordinal), last_ordinal_(first_ordinal), format_(format) {
+}
+
+IndexSegment IndexSegment::Merge(const vector<const IndexSegment*>& segments, const vector<uint64_t>& removed_mask) {
+    IndexSegment merged(segments.front()->first_ordinal_, segments.front()->format_);
+    merged.last_ordinal_ = segments.back()->last_ordinal_;
+    merged.is_sealed_ = true;
+    vector<size_t> indices;
+
+    for (const IndexSegment* segment: segments) {
+        for (size_t position = 0; position < segment->postings_.size(); ++position) {
+            if (!segment->postings_[position].empty()) {
+                indices.push_back(segment->GetIndex(position));
+            }
+        }
+    }
+
+    sort(indices.begin(), indices.end());
+    indices.erase(unique(indices.begin(), indices.end()), indices.end());
+    merged.indices_.reserve(indices.size());
+    merged.postings_.reserve(indices.size());
+
+    // Диапазоны сегментов идут по возрастанию, поэтому постинги листа дописываются в конец без слияния.
+    for (const size_t index: indices) {
+        PostingList postings(merged.format_);
+        for (const IndexSegment* segment: segments) {
+            if (const PostingList* part = segment->FindPostings(index)) {
+                for (PostingCursor cursor(*part, 0, numeric_limits<DocumentOrdinal>::max()); !cursor.IsEnd();
+                     cursor.Next()) {
+                    if (!IsRemoved(removed_mask, cursor.GetOrdinal())) {
+                        postings.Add(cursor.GetOrdinal(), cursor.GetTermFreq());
+                    }
+                }
+            }
+        }
+        if (!postings.empty()) {
+            postings.ShrinkToFit();
+            merged.indices_.push_back(index);
+            merged.postings_.push_back(move(postings));
+        }
+    }
+
+    return merged;
+}
+
+DocumentOrdinal IndexSegment::GetFirstOrdinal() const {
+    return first_ordinal_;
+}
+
+DocumentOrdinal IndexSegment::GetLastOrdinal() const {
+    return last_ordinal_;
+}
+
+bool IndexSegment::IsSealed() const {
+    return is_sealed_;
+}
+
+PostingList& IndexSegment::GetPostings(size_t index) {
+    Reserve(index + 1);
+    return postings_[index];
+}
+
+void IndexSegment::Reserve(size_t list_count) {
+
+    if (postings_.size() < list_count) {
+        postings_.resize(list_count, PostingList(format_));
+    }
+}
+
+const PostingList* IndexSegment::FindPostings(size_t index) const {
+
+    if (!is_sealed_) {
+        return index < postings_.size() ? &postings_[index] : nullptr;
+    }
+
+    const auto it = lower_bound(indices_.begin(), indices_.end(), index);
+
+    return it != indices_.end() && *it == index ? &postings_[it - indices_.begin()] : nullptr;
+}
+
+PostingList* IndexSegment::FindPostings(size_t index) {
+    return const_cast<PostingList*>(as_const(*this).FindPostings(index));
+}
+
+IndexSegment IndexSegment::Seal(DocumentOrdinal last_ordinal, const vector<uint64_t>& removed_mask) const {
+    IndexSegment sealed = Merge({this}, removed_mask);
+    sealed.last_ordinal_ = last_ordinal;
+    return sealed;
+}
+
+void IndexSegment::SetFormat(PostingFormat format) {
+    format_ = format;
+
+    for (PostingList& postings: postings_) {
+        postings.SetFormat(format_);
+    }
+}
+
+DocumentBitmapCache& IndexSegment::GetBitmaps() const {
+    return bitmaps_;
+}
+
+size_t IndexSegment::GetPostingCount() const {
+    size_t posting_count = 0;
+
+    for (const PostingList& postings: postings_) {
+        posting_count += postings.size();
+    }
+
+    return posting_count;
+}
+
+size_t IndexSegment::GetMemoryUsage() const {
+    size_t memory_usage = indices_.capacity() * sizeof(size_t) + postings_.capacity() * sizeof(PostingList);
+
+    for (const PostingList& postings: postings_) {
+        memory_usage += postings.GetMemoryUsage();
+    }
+
+    return memory_usage;
+}
+
+void IndexSegment::Save(SnapshotWriter& writer) const {
+    writer.Write(first_ordinal_);
+    writer.Write(last_ordinal_);
+    writer.Write(format_);
+    writer.WriteArray(indices_.data(), indices_.size());
+
+    for (const PostingList& postings: postings_) {
+        postings.Save(writer);
+    }
+}
+
+IndexSegment IndexSegment::Load(SnapshotReader& reader, size_t list_count) {
+    IndexSegment segment;
+    segment.first_ordinal_ = reader.Read<DocumentOrdinal>();
+    segment.last_ordinal_ = reader.Read<DocumentOrdinal>();
+    segment.format_ = reader.Read<PostingFormat>();
+    segment.is_sealed_ = true;
+    const auto [indices, index_count] = reader.ReadArray<size_t>();
+
+    if (segment.first_ordinal_ > segment.last_ordinal_
+        || (segment.format_ != PostingFormat::PLAIN && segment.format_ != PostingFormat::COMPRESSED)
+        || adjacent_find(indices, indices + index_count, greater_equal<size_t>()) != indices + index_count
+        || (index_count > 0 && indices[index_count - 1] >= list_count)) {
+        throw runtime_error("Snapshot segment is inconsistent"s);
+    }
+
+    segment.indices_.assign(indices, indices + index_count);
+    segment.postings_.reserve(index_count);
+
+    for (size_t position = 0; position < index_count; ++position) {
+        segment.postings_.push_back(PostingList::Load(reader, segment.first_ordinal_, segment.last_ordinal_));
+    }
+
+    return segment;
+}
+
+size_t IndexSegment::GetIndex(size_t position) const {
+    return is_sealed_ ? indices_[position] : position;
+}
+
+void IndexSegment::EraseRemovedPostings(size_t position, const vector<uint64_t>& removed_mask) {
+    PostingList& postings = postings_[position];
+    bool has_removed = false;
+
+    for (PostingCursor cursor(postings, 0, numeric_limits<DocumentOrdinal>::max()); !cursor.IsEnd(); cursor.Next()) {
+        if (IsRemoved(removed_mask, cursor.GetOrdinal())) {
+            postings.Remove(cursor.GetOrdinal());
+            has_removed = true;
+        }
+    }
+
+    if (has_removed) {
+        postings.Merge();
+        if (is_sealed_) {
+            postings.ShrinkToFit();
+        }
+        bitmaps_.Invalidate(GetIndex(position));
+    }
+}
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <execution>
+#include <vector>
+
+#include "document.h"
+#include "document_bitmap.h"
+#include "posting_list.h"
+
+class SnapshotReader;
+class SnapshotWriter;
+
+// Часть обратного индекса с постингами документов из диапазона номеров [first_ordinal, last_ordinal).
+// Номер постинг-листа тот же, что у владельца индекса. Изменяемый сегмент хранит листы плотным массивом,
+// индексируемым номером листа, и принимает постинги новых документов. Запечатанный сегмент хранит только
+// непустые листы по возрастанию номера, без буферов и запаса памяти, и больше не пополняется.
+// Удалённые документы отмечаются в маске владельца (бит с номером документа), постинги же вычищаются
+// при запечатывании, слиянии и вызове EraseRemoved.
+class IndexSegment {
+public:
+    IndexSegment() = default;
+
+    IndexSegment(DocumentOrdinal first_ordinal, PostingFormat format);
+
+    // Сливает сегменты со смежными диапазонами номеров, идущие по возрастанию номеров, в один запечатанный
+    // сегмент без постингов удалённых документов. Исходные сегменты не меняются. Изменяемый сегмент может быть
+    // только последним, и его диапазон должен быть уже закрыт.
+    static IndexSegment Merge(const std::vector<const IndexSegment*>& segments,
+                              const std::vector<uint64_t>& removed_mask);
+
+    DocumentOrdinal GetFirstOrdinal() const;
+
+    // Только для запечатанного сегмента.
+    DocumentOrdinal GetLastOrdinal() const;
+
+    bool IsSealed() const;
+
+    // Постинг-лист изменяемого сегмента; листы создаются по мере надобности.
+    PostingList& GetPostings(size_t index);
+
+    // Готовит листы [0, list_count) изменяемого сегмента, чтобы их можно было пополнять параллельно.
+    void Reserve(size_t list_count);
+
+    // Лист с номером index или nullptr, если в сегменте его нет.
+    const PostingList* FindPostings(size_t index) const;
+
+    PostingList* FindPostings(size_t index);
+
+    // Запечатанная копия изменяемого сегмента на диапазоне [first_ordinal, last_ordinal).
+    IndexSegment Seal(DocumentOrdinal last_ordinal, const std::vector<uint64_t>& removed_mask) const;
+
+    // Удаляет из листов постинги удалённых документов.
+    template<typename ExecutionPolicy>
+    void EraseRemoved(ExecutionPolicy&& policy, const std::vector<uint64_t>& removed_mask);
+
+    void SetFormat(PostingFormat format);
+
+    // Битовые карты длинных листов сегмента, ключ - номер листа.
+    DocumentBitmapCache& GetBitmaps() const;
+
+    size_t GetPostingCount() const;
+
+    size_t GetMemoryUsage() const;
+
+    // Только для запечатанного сегмента.
+    void Save(SnapshotWriter& writer) const;
+
+    // Запечатанный сегмент, чьи постинги ссылаются на память снимка. Номера листов должны быть меньше list_count.
+    static IndexSegment Load(SnapshotReader& reader, size_t list_count);
+
+private:
+    DocumentOrdinal first_ordinal_ = 0;
+    DocumentOrdinal last_ordinal_ = 0;
+    PostingFormat format_ = PostingFormat::PLAIN;
+    bool is_sealed_ = false;
+    // У запечатанного сегмента - номера листов postings_ по возрастанию, у изменяемого пуст.
+    std::vector<size_t> indices_;
+    std::vector<PostingList> postings_;
+    mutable DocumentBitmapCache bitmaps_;
+
+    size_t GetIndex(size_t position) const;
+
+    void EraseRemovedPostings(size_t position, const std::vector<uint64_t>& removed_mask);
+};
+
+template<typename ExecutionPolicy>
+void IndexSegment::EraseRemoved(ExecutionPolicy&& policy, const std::vector<uint64_t>& removed_mask) {
+    std::for_each(policy, postings_.begin(), postings_.end(), [this, &removed_mask](PostingList& postings) {
+        EraseRemovedPostings(&postings - postings_.data(), removed_mask);
+    });
+}
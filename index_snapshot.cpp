@@ -0,0 +1,222 @@
+#include "index_snapshot.h"
+
+#include <cstdio>
+#include <filesystem>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace std;
+
+namespace {
+
+const char SNAPSHOT_MAGIC[8] = {'S', 'S', 'R', 'V', 'S', 'N', 'A', 'P'};
+// Записывается в порядке байтов машины и выдаёт снимок с другим порядком.
+const uint32_t SNAPSHOT_BYTE_ORDER = 0x01020304;
+const size_t SNAPSHOT_ALIGNMENT = 8;
+
+struct SnapshotHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t byte_order;
+    uint64_t payload_size;
+    uint64_t checksum;
+};
+
+static_assert(sizeof(SnapshotHeader) % SNAPSHOT_ALIGNMENT == 0);
+
+bool SyncPath(const string& path) {
+    const int fd = open(path.c_str(), O_RDONLY);
+
+    if (fd < 0) {
+        return false;
+    }
+
+    const bool is_synced = fsync(fd) == 0;
+    close(fd);
+    return is_synced;
+}
+
+} // namespace
+
+void SnapshotChecksum::Update(const void* data, size_t size) {
+    const auto* bytes = static_cast<const uint8_t*>(data);
+    total_size_ += size;
+
+    while (size > 0 && pending_size_ > 0) {
+        pending_ |= uint64_t{*bytes++} << (8 * pending_size_);
+        --size;
+        if (++pending_size_ == 8) {
+            Mix(pending_);
+            pending_ = 0;
+            pending_size_ = 0;
+        }
+    }
+
+    for (; size >= 8; bytes += 8, size -= 8) {
+        uint64_t word;
+        memcpy(&word, bytes, 8);
+        Mix(word);
+    }
+
+    for (; size > 0; --size) {
+        pending_ |= uint64_t{*bytes++} << (8 * pending_size_++);
+    }
+}
+
+uint64_t SnapshotChecksum::Get() const {
+    SnapshotChecksum last = *this;
+    last.Mix(pending_ ^ total_size_);
+    return last.hash_;
+}
+
+void SnapshotChecksum::Mix(uint64_t word) {
+    hash_ = (hash_ ^ word) * 0xFF51AFD7ED558CCDull;
+    hash_ ^= hash_ >> 32;
+}
+
+SnapshotWriter::SnapshotWriter(const string& path)
+    : path_(path), temporary_path_(path + ".tmp"s), out_(temporary_path_, ios::binary | ios::trunc) {
+
+    if (!out_) {
+        throw runtime_error("Cannot create snapshot "s + temporary_path_);
+    }
+
+    // Заголовок с контрольной суммой записывается в Finish.
+    const SnapshotHeader header{};
+    out_.write(reinterpret_cast<const char*>(&header), sizeof(header));
+}
+
+void SnapshotWriter::WriteString(string_view str) {
+    WriteArray(str.data(), str.size());
+}
+
+void SnapshotWriter::Finish() {
+    SnapshotHeader header{};
+    memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic));
+    header.version = SNAPSHOT_VERSION;
+    header.byte_order = SNAPSHOT_BYTE_ORDER;
+    header.payload_size = size_;
+    header.checksum = checksum_.Get();
+    out_.seekp(0);
+    out_.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    out_.close();
+
+    // Снимок должен оказаться на диске раньше, чем заменит прежний, а замена - раньше, чем Finish вернёт управление.
+    const string directory = filesystem::path(path_).parent_path().string();
+
+    if (!out_ || !SyncPath(temporary_path_) || rename(temporary_path_.c_str(), path_.c_str()) != 0
+        || !SyncPath(directory.empty() ? "."s : directory)) {
+        throw runtime_error("Cannot write snapshot "s + path_);
+    }
+}
+
+void SnapshotWriter::WriteBytes(const void* data, size_t size) {
+    out_.write(static_cast<const char*>(data), size);
+    checksum_.Update(data, size);
+    size_ += size;
+}
+
+void SnapshotWriter::Align() {
+    static const uint8_t padding[SNAPSHOT_ALIGNMENT] = {};
+    // Данные начинаются сразу за заголовком, размер которого кратен выравниванию.
+    WriteBytes(padding, (SNAPSHOT_ALIGNMENT - size_ % SNAPSHOT_ALIGNMENT) % SNAPSHOT_ALIGNMENT);
+}
+
+SnapshotReader::SnapshotReader(const uint8_t* data, size_t size, SnapshotVerification verification) {
+    SnapshotHeader header;
+
+    if (size < sizeof(header)) {
+        throw runtime_error("Snapshot is truncated"s);
+    }
+
+    memcpy(&header, data, sizeof(header));
+
+    if (memcmp(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic)) != 0 || header.byte_order != SNAPSHOT_BYTE_ORDER) {
+        throw runtime_error("Not a snapshot of this platform"s);
+    }
+    if (header.version != SNAPSHOT_VERSION) {
+        throw runtime_error("Unsupported snapshot version "s + to_string(header.version));
+    }
+    if (header.payload_size != size - sizeof(header)) {
+        throw runtime_error("Snapshot is truncated"s);
+    }
+
+    data_ = data + sizeof(header);
+    size_ = header.payload_size;
+
+    if (verification == SnapshotVerification::CHECKSUM) {
+        SnapshotChecksum checksum;
+        checksum.Update(data_, size_);
+
+        if (checksum.Get() != header.checksum) {
+            throw runtime_error("Snapshot checksum mismatch"s);
+        }
+    }
+}
+
+string_view SnapshotReader::ReadString() {
+    const auto [data, size] = ReadArray<char>();
+    return {data, size};
+}
+
+const uint8_t* SnapshotReader::Take(size_t size) {
+
+    if (size > size_ - position_) {
+        throw runtime_error("Snapshot is truncated"s);
+    }
+
+    const uint8_t* data = data_ + position_;
+    position_ += size;
+    return data;
+}
+
+size_t SnapshotReader::GetArrayBytes(uint64_t size, size_t element_size) const {
+
+    if (size > (size_ - position_) / element_size) {
+        throw runtime_error("Snapshot is truncated"s);
+    }
+
+    return size * element_size;
+}
+
+void SnapshotReader::Align() {
+    Take((SNAPSHOT_ALIGNMENT - position_ % SNAPSHOT_ALIGNMENT) % SNAPSHOT_ALIGNMENT);
+}
+
+MappedFile::MappedFile(const string& path) {
+    const int fd = open(path.c_str(), O_RDONLY);
+
+    if (fd < 0) {
+        throw runtime_error("Cannot open "s + path);
+    }
+
+    struct stat file_stat{};
+
+    if (fstat(fd, &file_stat) == 0 && file_stat.st_size > 0) {
+        size_ = file_stat.st_size;
+        data_ = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+    }
+
+    close(fd);
+
+    if (data_ == nullptr || data_ == MAP_FAILED) {
+        data_ = nullptr;
+        throw runtime_error("Cannot map "s + path);
+    }
+}
+
+MappedFile::~MappedFile() {
+    munmap(data_, size_);
+}
+
+const uint8_t* MappedFile::data() const {
+    return static_cast<const uint8_t*>(data_);
+}
+
+size_t MappedFile::size() const {
+    return size_;
+}
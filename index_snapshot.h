@@ -0,0 +1,139 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+
+#include "mapped_array.h"
+
+// Снимок индекса - двоичный файл в порядке байтов машины: заголовок с версией формата и контрольной суммой,
+// затем данные. Массивы выровнены по 8 байт от начала файла, чтобы читать их прямо из отображения в память.
+static const uint32_t SNAPSHOT_VERSION = 4;
+
+// Проверка снимка при открытии. STRUCTURE проверяет заголовок, а границы и согласованность данных проверяются
+// при разборе, так что страницы отображения читаются лишь по мере надобности. CHECKSUM дополнительно сверяет
+// контрольную сумму и ради этого один раз читает весь файл.
+enum class SnapshotVerification {
+    STRUCTURE,
+    CHECKSUM,
+};
+
+// Контрольная сумма потока байтов; результат не зависит от того, какими частями поток передан.
+class SnapshotChecksum {
+public:
+    void Update(const void* data, size_t size);
+
+    uint64_t Get() const;
+
+private:
+    uint64_t hash_ = 0x9E3779B97F4A7C15ull;
+    uint64_t pending_ = 0;
+    size_t pending_size_ = 0;
+    uint64_t total_size_ = 0;
+
+    void Mix(uint64_t word);
+};
+
+// Пишет снимок во временный файл и по Finish заменяет им файл path, так что прежний снимок
+// остаётся целым до конца записи.
+class SnapshotWriter {
+public:
+    explicit SnapshotWriter(const std::string& path);
+
+    template<typename T>
+    void Write(const T& value) {
+        static_assert(std::is_trivially_copyable_v<T>);
+        WriteBytes(&value, sizeof(T));
+    }
+
+    template<typename T>
+    void WriteArray(const T* data, size_t size) {
+        static_assert(std::is_trivially_copyable_v<T>);
+        Write(static_cast<uint64_t>(size));
+        Align();
+        WriteBytes(data, size * sizeof(T));
+    }
+
+    void WriteString(std::string_view str);
+
+    void Finish();
+
+private:
+    std::string path_;
+    std::string temporary_path_;
+    std::ofstream out_;
+    SnapshotChecksum checksum_;
+    uint64_t size_ = 0;
+
+    void WriteBytes(const void* data, size_t size);
+
+    void Align();
+};
+
+// Читает данные снимка из памяти с проверкой границ. Массивы и строки не копируются: результат ссылается
+// на память снимка.
+class SnapshotReader {
+public:
+    // Проверяет заголовок снимка data, а при verification == CHECKSUM и контрольную сумму.
+    SnapshotReader(const uint8_t* data, size_t size, SnapshotVerification verification);
+
+    template<typename T>
+    T Read() {
+        static_assert(std::is_trivially_copyable_v<T>);
+        T value;
+        std::memcpy(&value, Take(sizeof(T)), sizeof(T));
+        return value;
+    }
+
+    template<typename T>
+    std::pair<const T*, size_t> ReadArray() {
+        static_assert(std::is_trivially_copyable_v<T>);
+        const auto size = Read<uint64_t>();
+        Align();
+        return {reinterpret_cast<const T*>(Take(GetArrayBytes(size, sizeof(T)))), size};
+    }
+
+    template<typename T>
+    MappedArray<T> ReadMappedArray() {
+        const auto [data, size] = ReadArray<T>();
+        return {data, size};
+    }
+
+    std::string_view ReadString();
+
+private:
+    const uint8_t* data_;
+    size_t size_;
+    size_t position_ = 0;
+
+    const uint8_t* Take(size_t size);
+
+    size_t GetArrayBytes(uint64_t size, size_t element_size) const;
+
+    void Align();
+};
+
+// Файл, отображённый в память только для чтения.
+class MappedFile {
+public:
+    explicit MappedFile(const std::string& path);
+
+    MappedFile(const MappedFile&) = delete;
+
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    ~MappedFile();
+
+    const uint8_t* data() const;
+
+    size_t size() const;
+
+private:
+    void* data_ = nullptr;
+    size_t size_ = 0;
+};
@@ -1,54 +1,46 @@
 #include "search_server.h"
+#include "concurrent_search_server.h"
+#include "write_ahead_log.h"
 #include "process_queries.h"
 #include "log_duration.h"
+#include "stop_word_filter.h"
+#include "random_text.h"
 
+#include <array>
 #include <execution>
+#include <filesystem>
+#include <fstream>
 #include <iostream>
 #include <random>
+#include <set>
 #include <string>
+#include <thread>
 #include <vector>
 
 using namespace std;
 
-string GenerateWord(mt19937& generator, int max_length) {
-    const int length = uniform_int_distribution(1, max_length)(generator);
-    string word;
-    word.reserve(length);
-    for (int i = 0; i < length; ++i) {
-        word.push_back(uniform_int_distribution<int>('a', 'z')(generator));
+// Слова по закону Ципфа: вероятность слова обратно пропорциональна его номеру в словаре.
+// Частые слова получают низкий IDF и слабые верхние оценки, как в настоящих текстах.
+vector<string> GenerateZipfQueries(mt19937& generator, const vector<string>& dictionary, int query_count,
+                                   int min_word_count, int max_word_count) {
+    vector<double> weights(dictionary.size());
+    for (size_t i = 0; i < weights.size(); ++i) {
+        weights[i] = 1.0 / (i + 1);
     }
-    return word;
-}
-
-vector<string> GenerateDictionary(mt19937& generator, int word_count, int max_length) {
-    vector<string> words;
-    words.reserve(word_count);
-    for (int i = 0; i < word_count; ++i) {
-        words.push_back(GenerateWord(generator, max_length));
-    }
-    words.erase(unique(words.begin(), words.end()), words.end());
-    return words;
-}
-
-string GenerateQuery(mt19937& generator, const vector<string>& dictionary, int word_count, double minus_prob = 0) {
-    string query;
-    for (int i = 0; i < word_count; ++i) {
-        if (!query.empty()) {
-            query.push_back(' ');
-        }
-        if (uniform_real_distribution<>(0, 1)(generator) < minus_prob) {
-            query.push_back('-');
-        }
-        query += dictionary[uniform_int_distribution<int>(0, dictionary.size() - 1)(generator)];
-    }
-    return query;
-}
+    discrete_distribution<size_t> word_distribution(weights.begin(), weights.end());
 
-vector<string> GenerateQueries(mt19937& generator, const vector<string>& dictionary, int query_count, int max_word_count) {
     vector<string> queries;
     queries.reserve(query_count);
     for (int i = 0; i < query_count; ++i) {
-        queries.push_back(GenerateQuery(generator, dictionary, max_word_count));
+        const int word_count = uniform_int_distribution(min_word_count, max_word_count)(generator);
+        string query;
+        for (int j = 0; j < word_count; ++j) {
+            if (!query.empty()) {
+                query.push_back(' ');
+            }
+            query += dictionary[word_distribution(generator)];
+        }
+        queries.push_back(move(query));
     }
     return queries;
 }
@@ -67,6 +59,283 @@ void Test(string_view mark, const SearchServer& search_server, const vector<stri
 
 #define TEST(policy) Test(#policy, search_server, queries, execution::policy)
 
+void ReportPostingMemory(string_view mark, const SearchServer& search_server) {
+    cout << mark << ": "sv << search_server.GetPostingMemoryUsage() * 1.0 / search_server.GetPostingCount()
+         << " bytes per posting"sv << endl;
+}
+
+void ReportSegments(string_view mark, const SearchServer& search_server) {
+    const SegmentStats stats = search_server.GetSegmentStats();
+    cout << mark << ": "sv << stats.segment_count << " segments, "sv
+         << stats.seal_count << " seals in "sv << chrono::duration_cast<chrono::milliseconds>(stats.seal_duration).count()
+         << " ms, "sv << stats.merge_count << " merges in "sv
+         << chrono::duration_cast<chrono::milliseconds>(stats.merge_duration).count() << " ms"sv << endl;
+}
+
+// Полный перебор против отсечения MaxScore по максимумам блоков на корпусе со словами по закону Ципфа
+// и документами разной длины.
+void BenchmarkZipfCorpus(mt19937& generator) {
+    const auto dictionary = GenerateDictionary(generator, 10'000, 10);
+    const auto documents = GenerateZipfQueries(generator, dictionary, 150'000, 10, 200);
+
+    SearchServer search_server;
+    for (size_t i = 0; i < documents.size(); ++i) {
+        search_server.AddDocument(i, documents[i], DocumentStatus::ACTUAL, {1, 2, 3});
+    }
+    ReportSegments("zipf"sv, search_server);
+
+    const auto queries = GenerateZipfQueries(generator, dictionary, 200, 2, 8);
+
+    search_server.SetQueryEvaluation(QueryEvaluation::EXHAUSTIVE);
+    Test("zipf seq exhaustive"sv, search_server, queries, execution::seq);
+    Test("zipf par exhaustive"sv, search_server, queries, execution::par);
+
+    // Те же слова, но все обязательные: оценивается только пересечение постинг-листов.
+    vector<string> required_queries;
+    for (const string& query: queries) {
+        string required_query = "+"s + query;
+        for (size_t position = required_query.find(' '); position != string::npos;
+             position = required_query.find(' ', position + 2)) {
+            required_query.insert(position + 1, "+"s);
+        }
+        required_queries.push_back(move(required_query));
+    }
+    Test("zipf seq required"sv, search_server, required_queries, execution::seq);
+    Test("zipf par required"sv, search_server, required_queries, execution::par);
+
+    // К каждому запросу добавлено минус-слово из самых частых: исключение идёт по битовым картам.
+    vector<string> minus_queries;
+    for (size_t i = 0; i < queries.size(); ++i) {
+        minus_queries.push_back(queries[i] + " -"s + dictionary[i % 10]);
+    }
+    Test("zipf seq minus"sv, search_server, minus_queries, execution::seq);
+    Test("zipf par minus"sv, search_server, minus_queries, execution::par);
+
+    search_server.SetQueryEvaluation(QueryEvaluation::MAX_SCORE);
+    Test("zipf seq max_score"sv, search_server, queries, execution::seq);
+    Test("zipf par max_score"sv, search_server, queries, execution::par);
+
+    ReportPostingMemory("zipf plain"sv, search_server);
+    search_server.SetPostingFormat(PostingFormat::COMPRESSED);
+    ReportPostingMemory("zipf compressed"sv, search_server);
+    Test("zipf seq max_score compressed"sv, search_server, queries, execution::seq);
+}
+
+// Корпус, где актуальна лишь часть документов: поиск по статусу обходит только свой раздел постингов,
+// а тот же фильтр в виде лямбды проверяется на постингах всех статусов.
+void BenchmarkStatusPartitions(mt19937& generator) {
+    const auto dictionary = GenerateDictionary(generator, 1000, 10);
+    const auto documents = GenerateQueries(generator, dictionary, 150'000, 70);
+
+    SearchServer search_server;
+    for (size_t i = 0; i < documents.size(); ++i) {
+        const auto status = static_cast<DocumentStatus>(uniform_int_distribution(0, 3)(generator));
+        search_server.AddDocument(i, documents[i], status, {1, 2, 3});
+    }
+
+    const auto queries = GenerateQueries(generator, dictionary, 50, 70);
+    Test("status partition"sv, search_server, queries, execution::seq);
+
+    LOG_DURATION("status lambda"sv);
+    double total_relevance = 0;
+    for (const string_view query : queries) {
+        const auto found_documents = search_server.FindTopDocuments(query, [](int, DocumentStatus status, int) {
+            return status == DocumentStatus::ACTUAL;
+        });
+        for (const auto& document : found_documents) {
+            total_relevance += document.relevance;
+        }
+    }
+    cout << total_relevance << endl;
+}
+
+// Запросы из нескольких потоков на снимках индекса, пока писатель добавляет документы.
+// Каждый читатель выполняет одинаковое число запросов, так что при масштабировании время почти не растёт.
+void BenchmarkConcurrentReads(mt19937& generator) {
+    const auto dictionary = GenerateDictionary(generator, 1000, 10);
+    const auto documents = GenerateQueries(generator, dictionary, 60'000, 70);
+
+    SearchServer search_server;
+    vector<DocumentData> batch;
+    for (size_t i = 0; i < 50'000; ++i) {
+        batch.push_back({static_cast<int>(i), documents[i], DocumentStatus::ACTUAL, {1, 2, 3}});
+    }
+    search_server.AddDocuments(execution::par, batch);
+
+    ConcurrentSearchServer concurrent_server(move(search_server), 64);
+    const auto queries = GenerateQueries(generator, dictionary, 20, 10);
+    size_t next_document = batch.size();
+
+    for (const size_t reader_count : {size_t{1}, max<size_t>(thread::hardware_concurrency(), 2)}) {
+        const size_t publish_count = concurrent_server.GetPublishCount();
+        const size_t first_document = next_document;
+        atomic<size_t> active_readers = reader_count;
+        {
+            LOG_DURATION("concurrent "s + to_string(reader_count) + " readers"s);
+            vector<thread> readers;
+            for (size_t reader = 0; reader < reader_count; ++reader) {
+                readers.emplace_back([&concurrent_server, &queries, &active_readers] {
+                    for (int round = 0; round < 5; ++round) {
+                        for (const string_view query : queries) {
+                            concurrent_server.GetSnapshot()->FindTopDocuments(query);
+                        }
+                    }
+                    --active_readers;
+                });
+            }
+            while (active_readers > 0 && next_document < documents.size()) {
+                concurrent_server.AddDocument(next_document, documents[next_document], DocumentStatus::ACTUAL, {1});
+                ++next_document;
+            }
+            for (auto& reader : readers) {
+                reader.join();
+            }
+        }
+        cout << reader_count * 5 * queries.size() << " queries, "sv << next_document - first_document
+             << " documents added, "sv << concurrent_server.GetPublishCount() - publish_count
+             << " publications"sv << endl;
+    }
+}
+
+// Резидентная память процесса по /proc/self/statm (Linux).
+size_t GetResidentMemory() {
+    ifstream statm("/proc/self/statm"s);
+    size_t total_pages = 0;
+    size_t resident_pages = 0;
+    statm >> total_pages >> resident_pages;
+    return resident_pages * 4096;
+}
+
+// Запуск со снимка вместо разбора текстов: время загрузки и прирост резидентной памяти после загрузки
+// и после запросов, которые дочитывают нужные страницы снимка.
+void BenchmarkSnapshot(const SearchServer& search_server, const vector<string>& queries) {
+    const string path = (filesystem::temp_directory_path() / "search_server.snapshot"s).string();
+    {
+        LOG_DURATION("snapshot save"sv);
+        search_server.SaveSnapshot(path);
+    }
+    cout << "snapshot: "sv << filesystem::file_size(path) / (1024 * 1024) << " MB"sv << endl;
+    cout << "forward index: "sv << search_server.GetForwardIndexMemoryUsage() / (1024 * 1024) << " MB"sv << endl;
+
+    const size_t initial_memory = GetResidentMemory();
+    SearchServer loaded_server;
+    {
+        LOG_DURATION("snapshot load"sv);
+        loaded_server = SearchServer::LoadSnapshot(path);
+    }
+    cout << "snapshot load resident: +"sv << (GetResidentMemory() - initial_memory) / (1024 * 1024) << " MB"sv << endl;
+    Test("snapshot seq"sv, loaded_server, queries, execution::seq);
+    cout << "snapshot queries resident: +"sv << (GetResidentMemory() - initial_memory) / (1024 * 1024) << " MB"sv
+         << endl;
+    filesystem::remove(path);
+}
+
+// Изменения с журналом из нескольких потоков: групповая фиксация объединяет записи разных писателей в одну
+// синхронизацию с диском. Затем журнал применяется к пустому серверу, как при восстановлении.
+void BenchmarkWriteAheadLog(mt19937& generator) {
+    using Clock = LogDuration::Clock;
+    const auto dictionary = GenerateDictionary(generator, 1000, 10);
+    const auto documents = GenerateQueries(generator, dictionary, 20'000, 70);
+    const string log_path = (filesystem::temp_directory_path() / "search_server.wal"s).string();
+    filesystem::remove(log_path);
+
+    const size_t writer_count = max<size_t>(thread::hardware_concurrency(), 4);
+    {
+        auto log = make_unique<WriteAheadLog>(log_path);
+        const WriteAheadLog& log_stats = *log;
+        ConcurrentSearchServer concurrent_server(SearchServer(), 1024, move(log));
+        const auto start_time = Clock::now();
+        vector<thread> writers;
+        for (size_t writer = 0; writer < writer_count; ++writer) {
+            writers.emplace_back([&concurrent_server, &documents, writer, writer_count] {
+                for (size_t i = writer; i < documents.size(); i += writer_count) {
+                    concurrent_server.AddDocument(i, documents[i], DocumentStatus::ACTUAL, {1, 2, 3});
+                }
+            });
+        }
+        for (auto& writer : writers) {
+            writer.join();
+        }
+        const chrono::duration<double> duration = Clock::now() - start_time;
+        cout << "log writes: "sv << writer_count << " writers, "sv
+             << static_cast<size_t>(documents.size() / duration.count()) << " documents/s, "sv
+             << log_stats.GetSyncCount() << " syncs"sv << endl;
+    }
+
+    SearchServer search_server;
+    const auto start_time = Clock::now();
+    const size_t replayed_count = ReplayLog(log_path, search_server);
+    const chrono::duration<double> duration = Clock::now() - start_time;
+    cout << "log replay: "sv << static_cast<size_t>(replayed_count / duration.count()) << " documents/s"sv << endl;
+    filesystem::remove(log_path);
+}
+
+// Поиск стоп-слов: дерево строк против минимального совершенного хеша, построенного при запуске
+// и при компиляции. Среди слов примерно каждое четвёртое - стоп-слово.
+void BenchmarkStopWords(mt19937& generator) {
+    static constexpr array STOP_WORD_LIST{
+            "a"sv, "an"sv, "and"sv, "are"sv, "as"sv, "at"sv, "be"sv, "but"sv, "by"sv, "for"sv, "if"sv, "in"sv,
+            "into"sv, "is"sv, "it"sv, "no"sv, "not"sv, "of"sv, "on"sv, "or"sv, "such"sv, "that"sv, "the"sv,
+            "their"sv, "then"sv, "there"sv, "these"sv, "they"sv, "this"sv, "to"sv, "was"sv, "will"sv, "with"sv};
+    static constexpr StaticStopWordFilter STOP_WORDS(STOP_WORD_LIST);
+    const vector<string> stop_word_list(STOP_WORD_LIST.begin(), STOP_WORD_LIST.end());
+    const set<string, less<>> stop_word_set(stop_word_list.begin(), stop_word_list.end());
+    const StopWordFilter filter(stop_word_list);
+    const StopWordFilter static_filter(STOP_WORDS);
+
+    const auto dictionary = GenerateDictionary(generator, 3000, 8);
+    vector<string> words;
+    for (int i = 0; i < 2'000'000; ++i) {
+        const vector<string>& source = i % 4 ? dictionary : stop_word_list;
+        words.push_back(source[uniform_int_distribution<size_t>(0, source.size() - 1)(generator)]);
+    }
+
+    const auto count_stop_words = [&words](string_view mark, const auto& is_stop_word) {
+        LOG_DURATION(mark);
+        size_t stop_word_count = 0;
+        for (const string& word: words) {
+            stop_word_count += is_stop_word(word);
+        }
+        cout << mark << ": "sv << stop_word_count << " stop words"sv << endl;
+    };
+    count_stop_words("stop words set"sv, [&stop_word_set](string_view word) {
+        return stop_word_set.count(word) > 0;
+    });
+    count_stop_words("stop words perfect hash"sv, [&filter](string_view word) {
+        return filter.Contains(word);
+    });
+    count_stop_words("stop words constexpr"sv, [&static_filter](string_view word) {
+        return static_filter.Contains(word);
+    });
+}
+
+// Кэш результатов на потоке запросов с перекосом: популярные запросы повторяются по закону Ципфа.
+void BenchmarkResultCache(mt19937& generator, SearchServer& search_server, const vector<string>& dictionary) {
+    vector<string> distinct_queries;
+    for (int i = 0; i < 2000; ++i) {
+        distinct_queries.push_back(GenerateQuery(generator, dictionary, 4, 0.2));
+    }
+    const vector<string> queries = GenerateZipfQueries(generator, distinct_queries, 5000, 1, 1);
+
+    const auto process_queries = [&search_server, &queries](string_view mark) {
+        LOG_DURATION(mark);
+        size_t document_count = 0;
+        for (const auto& documents: ProcessQueries(search_server, queries)) {
+            document_count += documents.size();
+        }
+        cout << mark << ": "sv << document_count << " documents"sv << endl;
+    };
+    process_queries("uncached queries"sv);
+    search_server.SetResultCacheCapacity(256);
+    process_queries("cached queries"sv);
+
+    const ResultCacheStats stats = search_server.GetResultCacheStats();
+    cout << "result cache: hit rate "sv << stats.GetHitRate() << ", "sv << stats.evictions << " evictions, "sv
+         << stats.rejections << " rejections, "sv << stats.entry_count << " entries in "sv << stats.memory_usage
+         << " bytes"sv << endl;
+    search_server.SetResultCacheCapacity(0);
+}
+
 int main() {
     mt19937 generator;
 
@@ -74,12 +343,44 @@ int main() {
     const auto documents = GenerateQueries(generator, dictionary, 150'000, 70);
 
     SearchServer search_server(dictionary[0]);
-    for (size_t i = 0; i < documents.size(); ++i) {
-        search_server.AddDocument(i, documents[i], DocumentStatus::ACTUAL, {1, 2, 3});
+    {
+        // Пакетная загрузка: документы разбираются параллельно, постинг-листы пополняются один раз.
+        LOG_DURATION("load"sv);
+        vector<DocumentData> batch;
+        batch.reserve(documents.size());
+        for (size_t i = 0; i < documents.size(); ++i) {
+            batch.push_back({static_cast<int>(i), documents[i], DocumentStatus::ACTUAL, {1, 2, 3}});
+        }
+        search_server.AddDocuments(execution::par, batch);
     }
 
     const auto queries = GenerateQueries(generator, dictionary, 50, 70);
+    BenchmarkResultCache(generator, search_server, dictionary);
 
     TEST(seq);
     TEST(par);
+
+    // Отсечение MaxScore на тех же запросах: релевантности совпадают с полным перебором.
+    search_server.SetQueryEvaluation(QueryEvaluation::MAX_SCORE);
+    Test("seq max_score"sv, search_server, queries, execution::seq);
+    Test("par max_score"sv, search_server, queries, execution::par);
+
+    // Сжатые постинги: те же результаты при меньшем объёме памяти.
+    ReportPostingMemory("plain"sv, search_server);
+    search_server.SetPostingFormat(PostingFormat::COMPRESSED);
+    ReportPostingMemory("compressed"sv, search_server);
+    search_server.SetQueryEvaluation(QueryEvaluation::EXHAUSTIVE);
+    Test("seq compressed"sv, search_server, queries, execution::seq);
+    Test("par compressed"sv, search_server, queries, execution::par);
+
+    // Сохранённые IDF: на неизменном индексе совпадают с точными, но не вычисляются в каждом запросе.
+    search_server.SetRelevanceMode(RelevanceMode::CACHED_IDF);
+    Test("seq cached idf"sv, search_server, queries, execution::seq);
+    BenchmarkSnapshot(search_server, queries);
+
+    BenchmarkZipfCorpus(generator);
+    BenchmarkStatusPartitions(generator);
+    BenchmarkConcurrentReads(generator);
+    BenchmarkWriteAheadLog(generator);
+    BenchmarkStopWords(generator);
 }
\ No newline at end of file
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+// Массив индекса: собственный вектор или участок чужой памяти, например отображённого в память снимка
+// индекса. Участок только читается и перед первым изменением копируется в собственный вектор.
+template<typename T>
+class MappedArray {
+public:
+    MappedArray() = default;
+
+    // Память участка должна пережить массив и все его копии.
+    MappedArray(const T* data, size_t size)
+        : view_(size > 0 ? data : nullptr), view_size_(size > 0 ? size : 0) {
+    }
+
+    MappedArray& operator=(std::vector<T>&& values) {
+        values_ = std::move(values);
+        view_ = nullptr;
+        view_size_ = 0;
+        return *this;
+    }
+
+    const T* data() const {
+        return view_ ? view_ : values_.data();
+    }
+
+    size_t size() const {
+        return view_ ? view_size_ : values_.size();
+    }
+
+    bool empty() const {
+        return size() == 0;
+    }
+
+    const T* begin() const {
+        return data();
+    }
+
+    const T* end() const {
+        return data() + size();
+    }
+
+    const T& operator[](size_t i) const {
+        return data()[i];
+    }
+
+    const T& back() const {
+        return data()[size() - 1];
+    }
+
+    std::vector<T>& GetMutable() {
+        if (view_) {
+            values_.assign(view_, view_ + view_size_);
+            view_ = nullptr;
+            view_size_ = 0;
+        }
+        return values_;
+    }
+
+    void clear() {
+        *this = std::vector<T>();
+    }
+
+    void ShrinkToFit() {
+        values_.shrink_to_fit();
+    }
+
+    // Участок чужой памяти учитывается по размеру.
+    size_t GetMemoryUsage() const {
+        return (view_ ? view_size_ : values_.capacity()) * sizeof(T);
+    }
+
+    bool operator==(const MappedArray& other) const {
+        return std::equal(begin(), end(), other.begin(), other.end());
+    }
+
+    bool operator==(const std::vector<T>& other) const {
+        return std::equal(begin(), end(), other.begin(), other.end());
+    }
+
+private:
+    std::vector<T> values_;
+    const T* view_ = nullptr;
+    size_t view_size_ = 0;
+};
@@ -0,0 +1,149 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <numeric>
+#include <vector>
+
+#include "document.h"
+#include "posting_list.h"
+#include "score_accumulator.h"
+#include "top_documents.h"
+
+// Постинг-лист слова запроса вместе с его IDF.
+struct WeightedPostings {
+    const PostingList* postings;
+    double inverse_document_freq;
+};
+
+// Запас на погрешность округления: суммы верхних оценок и вкладов складываются в разном порядке.
+static const double MAX_SCORE_ROUNDING_MARGIN = 1e-9;
+
+// Ширина окна номеров документов, внутри которого разбиение слов на обязательные и необязательные неизменно.
+static const DocumentOrdinal MAX_SCORE_WINDOW_SIZE = 4096;
+
+// Вычисление запроса с отсечением MaxScore по окнам номеров документов.
+// Для каждого окна верхняя оценка вклада слова берётся по максимумам частоты в блоках постингов, попавших
+// в окно (block max tf * idf). Окно, где сумма оценок не дотягивает до порога входа в топ, пропускается целиком.
+// Иначе слова с наименьшими оценками, чья сумма не дотягивает до порога, становятся необязательными:
+// документы, встречающиеся только в них, не рассматриваются. Обязательные слова окна суммируются
+// в аккумулятор (индекс - ordinal - first), а необязательные списки проверяются для каждого документа окна
+// лишь пока он ещё может войти в топ.
+// Релевантность складывается в порядке слов запроса, поэтому совпадает с полным перебором до бита.
+// Исключённые в аккумуляторе документы не рассматриваются.
+// document_filter(ordinal) решает, допущен ли документ; make_document(ordinal, relevance) строит результат.
+template<typename DocumentFilter, typename DocumentFactory>
+void FindTopDocumentsMaxScore(const std::vector<WeightedPostings>& terms, DocumentOrdinal first, DocumentOrdinal last,
+                              DocumentFilter&& document_filter, DocumentFactory&& make_document,
+                              ScoreAccumulator& accumulator, TopDocuments& top_documents) {
+    const size_t term_count = terms.size();
+
+    if (term_count == 0) {
+        return;
+    }
+
+    std::vector<PostingCursor> cursors;
+    std::vector<PostingCursor> lookup_cursors;
+    cursors.reserve(term_count);
+    lookup_cursors.reserve(term_count);
+
+    for (const auto& [postings, inverse_document_freq]: terms) {
+        cursors.emplace_back(*postings, first, last);
+        lookup_cursors.emplace_back(*postings, first, last);
+    }
+
+    // order - слова по возрастанию оценки в окне, cumulative_bounds[k] - суммарная оценка слов order[0..k],
+    // ranks[term] - позиция слова в order.
+    std::vector<double> upper_bounds(term_count);
+    std::vector<size_t> order(term_count);
+    std::vector<double> cumulative_bounds(term_count);
+    std::vector<size_t> ranks(term_count);
+    double threshold = top_documents.GetEntryThreshold() - MAX_SCORE_ROUNDING_MARGIN;
+
+    for (DocumentOrdinal window_begin = first; window_begin < last;) {
+        const DocumentOrdinal window_end = window_begin + std::min(last - window_begin, MAX_SCORE_WINDOW_SIZE);
+        double bound_sum = 0.0;
+
+        for (size_t term = 0; term < term_count; ++term) {
+            cursors[term].Seek(window_begin);
+            upper_bounds[term] = cursors[term].GetBlockMaxTermFreq(window_end) * terms[term].inverse_document_freq;
+            bound_sum += upper_bounds[term];
+        }
+
+        if (bound_sum <= threshold) {
+            window_begin = window_end;
+            continue;
+        }
+
+        std::iota(order.begin(), order.end(), 0);
+        std::sort(order.begin(), order.end(), [&upper_bounds](size_t lhs, size_t rhs) {
+            return upper_bounds[lhs] < upper_bounds[rhs];
+        });
+        bound_sum = 0.0;
+
+        for (size_t k = 0; k < term_count; ++k) {
+            bound_sum += upper_bounds[order[k]];
+            cumulative_bounds[k] = bound_sum;
+            ranks[order[k]] = k;
+        }
+
+        size_t essential_begin = 0;
+
+        while (essential_begin < term_count && cumulative_bounds[essential_begin] <= threshold) {
+            ++essential_begin;
+        }
+
+        for (size_t term = 0; term < term_count; ++term) {
+            if (ranks[term] < essential_begin) {
+                continue;
+            }
+            PostingCursor& cursor = cursors[term];
+            for (; !cursor.IsEnd() && cursor.GetOrdinal() < window_end; cursor.Next()) {
+                accumulator.Add(cursor.GetOrdinal() - first, cursor.GetTermFreq() * terms[term].inverse_document_freq);
+            }
+        }
+
+        for (DocumentOrdinal ordinal = window_begin; ordinal < window_end; ++ordinal) {
+            if (!accumulator.IsTouched(ordinal - first) || !document_filter(ordinal)) {
+                continue;
+            }
+
+            double score = accumulator.GetScore(ordinal - first);
+            bool is_candidate = true;
+            bool has_non_essential = false;
+
+            for (size_t k = essential_begin; k-- > 0;) {
+                if (score + cumulative_bounds[k] <= threshold) {
+                    is_candidate = false;
+                    break;
+                }
+                PostingCursor& cursor = cursors[order[k]];
+                cursor.Seek(ordinal);
+                if (!cursor.IsEnd() && cursor.GetOrdinal() == ordinal) {
+                    score += cursor.GetTermFreq() * terms[order[k]].inverse_document_freq;
+                    has_non_essential = true;
+                }
+            }
+
+            if (!is_candidate) {
+                continue;
+            }
+
+            if (has_non_essential) {
+                score = 0.0;
+                for (size_t term = 0; term < term_count; ++term) {
+                    PostingCursor& cursor = lookup_cursors[term];
+                    cursor.Seek(ordinal);
+                    if (!cursor.IsEnd() && cursor.GetOrdinal() == ordinal) {
+                        score += cursor.GetTermFreq() * terms[term].inverse_document_freq;
+                    }
+                }
+            }
+
+            top_documents.Push(make_document(ordinal, score));
+            threshold = top_documents.GetEntryThreshold() - MAX_SCORE_ROUNDING_MARGIN;
+        }
+
+        window_begin = window_end;
+    }
+}
@@ -0,0 +1,361 @@
+#include "posting_codec.h"
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstring>
+#include <utility>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#include <immintrin.h>
+#define POSTING_CODEC_SSSE3
+#endif
+
+using namespace std;
+
+static size_t GetEncodedLength(uint32_t value) {
+    return value < (1u << 8) ? 1 : value < (1u << 16) ? 2 : value < (1u << 24) ? 3 : 4;
+}
+
+void EncodeOrdinals(const DocumentOrdinal* ordinals, size_t count, DocumentOrdinal previous,
+                    vector<uint8_t>& out) {
+    const size_t control_begin = out.size();
+    out.resize(control_begin + (count + 3) / 4, 0);
+
+    for (size_t i = 0; i < count; ++i) {
+        const uint32_t delta = ordinals[i] - previous;
+        const size_t length = GetEncodedLength(delta);
+        out[control_begin + i / 4] |= static_cast<uint8_t>((length - 1) << (2 * (i % 4)));
+        for (size_t byte = 0; byte < length; ++byte) {
+            out.push_back(static_cast<uint8_t>(delta >> (8 * byte)));
+        }
+        previous = ordinals[i];
+    }
+}
+
+static const uint8_t* DecodeOrdinalsScalar(const uint8_t* in, size_t count, DocumentOrdinal previous,
+                                           DocumentOrdinal* ordinals) {
+    const uint8_t* control = in;
+    const uint8_t* data = in + (count + 3) / 4;
+
+    for (size_t i = 0; i < count; ++i) {
+        const size_t length = ((control[i / 4] >> (2 * (i % 4))) & 3) + 1;
+        uint32_t delta = 0;
+        for (size_t byte = 0; byte < length; ++byte) {
+            delta |= static_cast<uint32_t>(data[byte]) << (8 * byte);
+        }
+        data += length;
+        previous += delta;
+        ordinals[i] = previous;
+    }
+
+    return data;
+}
+
+#ifdef POSTING_CODEC_SSSE3
+
+namespace {
+
+// Для каждого байта управления: маска pshufb, раскладывающая четыре значения по 32-битным ячейкам,
+// и суммарная длина этих значений.
+struct ShuffleTable {
+    ShuffleTable() {
+        for (size_t control = 0; control < 256; ++control) {
+            uint8_t offset = 0;
+            for (size_t value = 0; value < 4; ++value) {
+                const size_t length = ((control >> (2 * value)) & 3) + 1;
+                for (size_t byte = 0; byte < 4; ++byte) {
+                    masks[control][4 * value + byte] = byte < length ? offset++ : 0x80;
+                }
+            }
+            lengths[control] = offset;
+        }
+    }
+
+    array<array<uint8_t, 16>, 256> masks;
+    array<uint8_t, 256> lengths;
+};
+
+const ShuffleTable SHUFFLE_TABLE;
+
+}
+
+__attribute__((target("ssse3")))
+static const uint8_t* DecodeOrdinalsSsse3(const uint8_t* in, size_t count, DocumentOrdinal previous,
+                                          DocumentOrdinal* ordinals) {
+    const uint8_t* control = in;
+    const uint8_t* data = in + (count + 3) / 4;
+    __m128i carry = _mm_set1_epi32(static_cast<int>(previous));
+    const size_t group_count = count / 4;
+
+    for (size_t group = 0; group < group_count; ++group) {
+        const uint8_t control_byte = control[group];
+        const auto* mask = reinterpret_cast<const __m128i*>(SHUFFLE_TABLE.masks[control_byte].data());
+        __m128i values = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(data)),
+                                          _mm_loadu_si128(mask));
+        values = _mm_add_epi32(values, _mm_slli_si128(values, 4));
+        values = _mm_add_epi32(values, _mm_slli_si128(values, 8));
+        values = _mm_add_epi32(values, carry);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(ordinals + 4 * group), values);
+        carry = _mm_shuffle_epi32(values, 0xFF);
+        data += SHUFFLE_TABLE.lengths[control_byte];
+    }
+
+    const size_t decoded = 4 * group_count;
+
+    if (decoded == count) {
+        return data;
+    }
+
+    // Последние меньше четырёх значений декодируются скалярно.
+    previous = decoded == 0 ? previous : ordinals[decoded - 1];
+    const uint8_t tail_control = control[group_count];
+
+    for (size_t i = decoded; i < count; ++i) {
+        const size_t length = ((tail_control >> (2 * (i - decoded))) & 3) + 1;
+        uint32_t delta = 0;
+        for (size_t byte = 0; byte < length; ++byte) {
+            delta |= static_cast<uint32_t>(data[byte]) << (8 * byte);
+        }
+        data += length;
+        previous += delta;
+        ordinals[i] = previous;
+    }
+
+    return data;
+}
+
+#endif
+
+const uint8_t* DecodeOrdinals(const uint8_t* in, size_t count, DocumentOrdinal previous, DocumentOrdinal* ordinals) {
+#ifdef POSTING_CODEC_SSSE3
+    static const bool has_ssse3 = __builtin_cpu_supports("ssse3");
+    if (has_ssse3) {
+        return DecodeOrdinalsSsse3(in, count, previous, ordinals);
+    }
+#endif
+    return DecodeOrdinalsScalar(in, count, previous, ordinals);
+}
+
+static size_t GetCodeWidth(size_t palette_size) {
+    size_t width = 0;
+    while ((size_t{1} << width) < palette_size) {
+        ++width;
+    }
+    return width;
+}
+
+namespace {
+
+// Блок частот начинается с размера таблицы; вместо нуля за ним следует байт другого способа кодирования.
+enum TermFreqEncoding : uint8_t {
+    RAW_TERM_FREQS,
+    RATIONAL_TERM_FREQS,
+};
+
+// Дробь count / length: частота слова, встреченного count раз в документе из length слов.
+const uint32_t MAX_RATIONAL_COUNT = 64;
+const uint32_t MAX_RATIONAL_LENGTH = 1 << 16;
+const size_t MAX_COUNT_WIDTH = 6;
+const size_t MAX_LENGTH_WIDTH = 16;
+
+// Сервер считает частоту сложением count раз величины 1 / length; при том же порядке сложений
+// результат совпадает до бита.
+double ComputeRationalTermFreq(uint32_t count, uint32_t length) {
+    const double inv_length = 1.0 / length;
+    double term_freq = 0.0;
+    for (uint32_t i = 0; i < count; ++i) {
+        term_freq += inv_length;
+    }
+    return term_freq;
+}
+
+// Обратные величины длин коротких документов: деление при декодировании дороже выборки из таблицы.
+struct InverseLengthTable {
+    InverseLengthTable() {
+        for (size_t length = 1; length < values.size(); ++length) {
+            values[length] = 1.0 / static_cast<uint32_t>(length);
+        }
+    }
+
+    array<double, 1024> values{};
+};
+
+const InverseLengthTable INV_LENGTHS;
+
+bool FindRationalTermFreq(double term_freq, uint32_t& count, uint32_t& length) {
+
+    for (count = 1; count <= MAX_RATIONAL_COUNT; ++count) {
+        const double candidate = round(count / term_freq);
+        if (candidate >= 1.0 && candidate <= MAX_RATIONAL_LENGTH) {
+            length = static_cast<uint32_t>(candidate);
+            if (ComputeRationalTermFreq(count, length) == term_freq) {
+                return true;
+            }
+        }
+    }
+
+    return false;
+}
+
+// Дописывает к out младшие width бит value, начиная с бита position.
+void PutBits(vector<uint8_t>& out, size_t begin, size_t position, uint32_t value, size_t width) {
+    for (size_t bit = 0; bit < width; ++bit, ++position) {
+        if ((value >> bit) & 1) {
+            out[begin + position / 8] |= static_cast<uint8_t>(1 << (position % 8));
+        }
+    }
+}
+
+uint32_t GetBits(const uint8_t* in, size_t position, size_t width) {
+    const uint8_t* bytes = in + position / 8;
+    const uint32_t window = bytes[0] | static_cast<uint32_t>(bytes[1]) << 8 | static_cast<uint32_t>(bytes[2]) << 16
+                            | static_cast<uint32_t>(bytes[3]) << 24;
+    return (window >> (position % 8)) & ((1u << width) - 1);
+}
+
+// Пишет частоты дробями, если все они так представимы и займут меньше max_size байт.
+bool EncodeRationalTermFreqs(const double* term_freqs, size_t count, size_t max_size, vector<uint8_t>& out) {
+    vector<pair<uint32_t, uint32_t>> fractions(count);
+    uint32_t max_count = 0;
+    uint32_t max_length = 0;
+
+    for (size_t i = 0; i < count; ++i) {
+        auto& [term_count, length] = fractions[i];
+        if (!FindRationalTermFreq(term_freqs[i], term_count, length)) {
+            return false;
+        }
+        max_count = max(max_count, term_count - 1);
+        max_length = max(max_length, length - 1);
+    }
+
+    const size_t count_width = GetCodeWidth(size_t{max_count} + 1);
+    const size_t length_width = GetCodeWidth(size_t{max_length} + 1);
+    const size_t width = count_width + length_width;
+
+    if (4 + (count * width + 7) / 8 >= max_size) {
+        return false;
+    }
+
+    out.push_back(0);
+    out.push_back(RATIONAL_TERM_FREQS);
+    out.push_back(static_cast<uint8_t>(count_width));
+    out.push_back(static_cast<uint8_t>(length_width));
+    const size_t codes_begin = out.size();
+    out.resize(codes_begin + (count * width + 7) / 8, 0);
+
+    for (size_t i = 0; i < count; ++i) {
+        PutBits(out, codes_begin, i * width, fractions[i].first - 1, count_width);
+        PutBits(out, codes_begin, i * width + count_width, fractions[i].second - 1, length_width);
+    }
+
+    return true;
+}
+
+} // namespace
+
+void EncodeTermFreqs(const double* term_freqs, size_t count, vector<uint8_t>& out) {
+    vector<double> palette(term_freqs, term_freqs + count);
+    sort(palette.begin(), palette.end());
+    palette.erase(unique(palette.begin(), palette.end()), palette.end());
+    const size_t width = GetCodeWidth(palette.size());
+    const size_t raw_size = 2 + count * sizeof(double);
+    const size_t palette_encoded_size = palette.empty() || palette.size() > 255 ? raw_size
+                                        : 1 + palette.size() * sizeof(double) + (count * width + 7) / 8;
+
+    // Из таблицы, дробей и самих частот выбирается самая короткая запись.
+    if (EncodeRationalTermFreqs(term_freqs, count, min(palette_encoded_size, raw_size), out)) {
+        return;
+    }
+    if (palette_encoded_size >= raw_size) {
+        out.push_back(0);
+        out.push_back(RAW_TERM_FREQS);
+        out.resize(out.size() + count * sizeof(double));
+        memcpy(out.data() + out.size() - count * sizeof(double), term_freqs, count * sizeof(double));
+        return;
+    }
+
+    out.push_back(static_cast<uint8_t>(palette.size()));
+    const size_t palette_begin = out.size();
+    out.resize(palette_begin + palette.size() * sizeof(double));
+    memcpy(out.data() + palette_begin, palette.data(), palette.size() * sizeof(double));
+
+    const size_t codes_begin = out.size();
+    out.resize(codes_begin + (count * width + 7) / 8, 0);
+
+    for (size_t i = 0; i < count; ++i) {
+        const size_t code = lower_bound(palette.begin(), palette.end(), term_freqs[i]) - palette.begin();
+        PutBits(out, codes_begin, i * width, static_cast<uint32_t>(code), width);
+    }
+}
+
+const uint8_t* DecodeTermFreqs(const uint8_t* in, size_t count, double* term_freqs) {
+    const size_t palette_size = *in++;
+
+    if (palette_size == 0 && *in == RATIONAL_TERM_FREQS) {
+        const size_t count_width = min<size_t>(in[1], MAX_COUNT_WIDTH);
+        const size_t length_width = min<size_t>(in[2], MAX_LENGTH_WIDTH);
+        const size_t width = count_width + length_width;
+        in += 3;
+        for (size_t i = 0; i < count; ++i) {
+            const uint32_t fraction = GetBits(in, i * width, width);
+            const uint32_t term_count = (fraction & ((1u << count_width) - 1)) + 1;
+            const uint32_t length = (fraction >> count_width) + 1;
+            const double inv_length = length < INV_LENGTHS.values.size() ? INV_LENGTHS.values[length] : 1.0 / length;
+            double term_freq = inv_length;
+            for (uint32_t added = 1; added < term_count; ++added) {
+                term_freq += inv_length;
+            }
+            term_freqs[i] = term_freq;
+        }
+        return in + (count * width + 7) / 8;
+    }
+
+    if (palette_size == 0) {
+        memcpy(term_freqs, in + 1, count * sizeof(double));
+        return in + 1 + count * sizeof(double);
+    }
+
+    double palette[256];
+    memcpy(palette, in, palette_size * sizeof(double));
+    in += palette_size * sizeof(double);
+
+    const size_t width = GetCodeWidth(palette_size);
+
+    for (size_t i = 0; i < count; ++i) {
+        term_freqs[i] = palette[GetBits(in, i * width, width)];
+    }
+
+    return in + (count * width + 7) / 8;
+}
+
+size_t GetEncodedOrdinalsSize(const uint8_t* in, size_t count) {
+    size_t size = (count + 3) / 4;
+
+    for (size_t i = 0; i < count; ++i) {
+        size += ((in[i / 4] >> (2 * (i % 4))) & 3) + 1;
+    }
+
+    return size;
+}
+
+size_t GetEncodedTermFreqsSize(const uint8_t* in, size_t count) {
+    const size_t palette_size = in[0];
+
+    if (palette_size == 0 && in[1] == RATIONAL_TERM_FREQS) {
+        const size_t width = min<size_t>(in[2], MAX_COUNT_WIDTH) + min<size_t>(in[3], MAX_LENGTH_WIDTH);
+        return 4 + (count * width + 7) / 8;
+    }
+    if (palette_size == 0) {
+        return 2 + count * sizeof(double);
+    }
+
+    return 1 + palette_size * sizeof(double) + (count * GetCodeWidth(palette_size) + 7) / 8;
+}
+
+size_t GetMaxEncodedOrdinalsSize(size_t count) {
+    return (count + 3) / 4 + count * sizeof(DocumentOrdinal);
+}
+
+size_t GetMaxEncodedTermFreqsSize(size_t count) {
+    return 2 + max(255 * sizeof(double) + count, count * sizeof(double));
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "document.h"
+
+// Декодеры читают до POSTING_CODEC_PADDING байт за концом закодированных данных,
+// поэтому за последним блоком в буфере должен оставаться такой запас.
+static const size_t POSTING_CODEC_PADDING = 16;
+
+// Дописывает в out разности соседних номеров документов (первая - от previous) в формате StreamVByte:
+// на каждые четыре значения байт управления с длинами 1-4 байта, затем сами значения.
+void EncodeOrdinals(const DocumentOrdinal* ordinals, size_t count, DocumentOrdinal previous,
+                    std::vector<uint8_t>& out);
+
+// Восстанавливает count номеров документов. На x86-64 с SSSE3 декодирует по четыре значения за шаг.
+// Возвращает указатель на байт, следующий за закодированными данными.
+const uint8_t* DecodeOrdinals(const uint8_t* in, size_t count, DocumentOrdinal previous, DocumentOrdinal* ordinals);
+
+// Частоты слова кодируются без потерь самой короткой из записей: таблица различных значений блока (не больше 255)
+// и номера в ней, упакованные по минимальному числу бит; упакованные пары (число вхождений, число слов документа),
+// из которых частота вычисляется так же, как при индексации; сами частоты.
+void EncodeTermFreqs(const double* term_freqs, size_t count, std::vector<uint8_t>& out);
+
+const uint8_t* DecodeTermFreqs(const uint8_t* in, size_t count, double* term_freqs);
+
+// Длина закодированных данных count значений в буфере in, не считая запаса для декодера.
+size_t GetEncodedOrdinalsSize(const uint8_t* in, size_t count);
+
+size_t GetEncodedTermFreqsSize(const uint8_t* in, size_t count);
+
+// Наибольшая длина, которую могут занять закодированные данные count значений.
+size_t GetMaxEncodedOrdinalsSize(size_t count);
+
+size_t GetMaxEncodedTermFreqsSize(size_t count);
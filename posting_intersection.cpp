@@ -0,0 +1,131 @@
+#include "posting_intersection.h"
+#include <algorithm>
+#include <numeric>
+
+#if defined(__x86_64__)
+#include <emmintrin.h>
+#endif
+
+using namespace std;
+
+size_t IntersectOrdinals(const DocumentOrdinal* lhs, size_t lhs_size, const DocumentOrdinal* rhs, size_t rhs_size,
+                         DocumentOrdinal* out) {
+    size_t i = 0;
+    size_t j = 0;
+    size_t count = 0;
+
+#if defined(__x86_64__)
+    // Каждый номер блока lhs сравнивается со всеми четырьмя номерами блока rhs через циклические сдвиги.
+    while (i + 4 <= lhs_size && j + 4 <= rhs_size) {
+        const __m128i lhs_block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(lhs + i));
+        const __m128i rhs_block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(rhs + j));
+        const __m128i matches = _mm_or_si128(
+                _mm_or_si128(_mm_cmpeq_epi32(lhs_block, rhs_block),
+                             _mm_cmpeq_epi32(lhs_block, _mm_shuffle_epi32(rhs_block, _MM_SHUFFLE(0, 3, 2, 1)))),
+                _mm_or_si128(_mm_cmpeq_epi32(lhs_block, _mm_shuffle_epi32(rhs_block, _MM_SHUFFLE(1, 0, 3, 2))),
+                             _mm_cmpeq_epi32(lhs_block, _mm_shuffle_epi32(rhs_block, _MM_SHUFFLE(2, 1, 0, 3)))));
+        const int mask = _mm_movemask_ps(_mm_castsi128_ps(matches));
+
+        for (size_t k = 0; k < 4; ++k) {
+            if ((mask >> k) & 1) {
+                out[count++] = lhs[i + k];
+            }
+        }
+
+        const DocumentOrdinal lhs_max = lhs[i + 3];
+        const DocumentOrdinal rhs_max = rhs[j + 3];
+        if (lhs_max <= rhs_max) {
+            i += 4;
+        }
+        if (rhs_max <= lhs_max) {
+            j += 4;
+        }
+    }
+#endif
+
+    while (i < lhs_size && j < rhs_size) {
+        if (lhs[i] < rhs[j]) {
+            ++i;
+        } else if (rhs[j] < lhs[i]) {
+            ++j;
+        } else {
+            out[count++] = lhs[i];
+            ++i;
+            ++j;
+        }
+    }
+
+    return count;
+}
+
+vector<DocumentOrdinal> IntersectPostings(vector<const PostingList*> postings, DocumentOrdinal first,
+                                          DocumentOrdinal last) {
+    vector<DocumentOrdinal> result;
+
+    if (postings.empty()) {
+        return result;
+    }
+
+    vector<size_t> range_sizes;
+    range_sizes.reserve(postings.size());
+    for (const PostingList* posting_list: postings) {
+        const auto [range_begin, range_end] = posting_list->FindRange(first, last);
+        range_sizes.push_back(range_end - range_begin);
+    }
+
+    vector<size_t> order(postings.size());
+    iota(order.begin(), order.end(), 0);
+    sort(order.begin(), order.end(), [&range_sizes](size_t lhs, size_t rhs) {
+        return range_sizes[lhs] < range_sizes[rhs];
+    });
+
+    for (PostingCursor cursor(*postings[order[0]], first, last); !cursor.IsEnd(); cursor.Next()) {
+        result.push_back(cursor.GetOrdinal());
+    }
+
+    vector<DocumentOrdinal> decoded;
+    vector<DocumentOrdinal> intersection;
+
+    for (size_t k = 1; k < order.size() && !result.empty(); ++k) {
+        const PostingList& posting_list = *postings[order[k]];
+
+        if (range_sizes[order[k]] > GALLOPING_INTERSECTION_RATIO * result.size()) {
+            PostingCursor cursor(posting_list, first, last);
+            size_t count = 0;
+            for (const DocumentOrdinal ordinal: result) {
+                cursor.Seek(ordinal);
+                if (cursor.IsEnd()) {
+                    break;
+                }
+                if (cursor.GetOrdinal() == ordinal) {
+                    result[count++] = ordinal;
+                }
+            }
+            result.resize(count);
+            continue;
+        }
+
+        // Несжатый список пересекается прямо в памяти, сжатый предварительно декодируется.
+        const DocumentOrdinal* ordinals;
+        size_t ordinal_count;
+        if (posting_list.GetOrdinals().size() == posting_list.size()) {
+            const auto [range_begin, range_end] = posting_list.FindRange(first, last);
+            ordinals = posting_list.GetOrdinals().data() + range_begin;
+            ordinal_count = range_end - range_begin;
+        } else {
+            decoded.clear();
+            for (PostingCursor cursor(posting_list, first, last); !cursor.IsEnd(); cursor.Next()) {
+                decoded.push_back(cursor.GetOrdinal());
+            }
+            ordinals = decoded.data();
+            ordinal_count = decoded.size();
+        }
+
+        intersection.resize(result.size());
+        intersection.resize(IntersectOrdinals(result.data(), result.size(), ordinals, ordinal_count,
+                                              intersection.data()));
+        swap(result, intersection);
+    }
+
+    return result;
+}
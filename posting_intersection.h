@@ -0,0 +1,20 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+#include "document.h"
+#include "posting_list.h"
+
+// Во сколько раз список должен быть длиннее текущего пересечения, чтобы выгоднее было искать в нём
+// каждый номер галопирующим поиском, а не сливать списки целиком.
+static const size_t GALLOPING_INTERSECTION_RATIO = 16;
+
+// Пересекает отсортированные массивы номеров документов, записывая общие номера в out по возрастанию.
+// На x86-64 сравнивает блоки по четыре номера каждого массива за шаг SSE2. Возвращает число общих номеров.
+size_t IntersectOrdinals(const DocumentOrdinal* lhs, size_t lhs_size, const DocumentOrdinal* rhs, size_t rhs_size,
+                         DocumentOrdinal* out);
+
+// Номера документов из [first, last), входящие во все списки. Списки пересекаются начиная с самого короткого.
+std::vector<DocumentOrdinal> IntersectPostings(std::vector<const PostingList*> postings, DocumentOrdinal first,
+                                               DocumentOrdinal last);
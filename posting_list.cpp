@@ -0,0 +1,444 @@
+#include "posting_list.h"
+#include "posting_codec.h"
+#include "index_snapshot.h"
+#include <algorithm>
+#include <functional>
+#include <stdexcept>
+#include <tuple>
+
+using namespace std;
+
+PostingList::PostingList(PostingFormat format) : format_(format) {
+}
+
+void PostingList::SetFormat(PostingFormat format) {
+
+    if (format_ == format) {
+        return;
+    }
+
+    format_ = format;
+
+    if (format_ == PostingFormat::COMPRESSED) {
+        SealFullBlocks();
+    } else {
+        UnsealBlocks();
+    }
+}
+
+void PostingList::Add(DocumentOrdinal ordinal, double term_freq) {
+
+    if (!HasPending() && (empty() || GetBlockLastOrdinal((size() - 1) / BLOCK_SIZE) < ordinal)) {
+        vector<double>& block_max_term_freqs = block_max_term_freqs_.GetMutable();
+        if (size() % BLOCK_SIZE == 0) {
+            block_max_term_freqs.push_back(term_freq);
+        } else {
+            block_max_term_freqs.back() = max(block_max_term_freqs.back(), term_freq);
+        }
+        ordinals_.GetMutable().push_back(ordinal);
+        term_freqs_.GetMutable().push_back(term_freq);
+        max_term_freq_ = max(max_term_freq_, term_freq);
+        if (format_ == PostingFormat::COMPRESSED && ordinals_.size() == BLOCK_SIZE) {
+            SealFullBlocks();
+        }
+        return;
+    }
+
+    pending_additions_.emplace_back(ordinal, term_freq);
+}
+
+void PostingList::Remove(DocumentOrdinal ordinal) {
+    pending_removals_.push_back(ordinal);
+}
+
+void PostingList::Merge() {
+
+    if (!HasPending()) {
+        return;
+    }
+
+    UnsealBlocks();
+    sort(pending_removals_.begin(), pending_removals_.end());
+    sort(pending_additions_.begin(), pending_additions_.end());
+
+    vector<DocumentOrdinal> merged_ordinals;
+    vector<double> merged_freqs;
+    merged_ordinals.reserve(ordinals_.size() + pending_additions_.size());
+    merged_freqs.reserve(ordinals_.size() + pending_additions_.size());
+
+    auto removal_it = pending_removals_.begin();
+    auto addition_it = pending_additions_.begin();
+
+    for (size_t i = 0; i < ordinals_.size(); ++i) {
+        const DocumentOrdinal ordinal = ordinals_[i];
+        while (addition_it != pending_additions_.end() && addition_it->first < ordinal) {
+            merged_ordinals.push_back(addition_it->first);
+            merged_freqs.push_back(addition_it->second);
+            ++addition_it;
+        }
+        while (removal_it != pending_removals_.end() && *removal_it < ordinal) {
+            ++removal_it;
+        }
+        if (removal_it != pending_removals_.end() && *removal_it == ordinal) {
+            continue;
+        }
+        merged_ordinals.push_back(ordinal);
+        merged_freqs.push_back(term_freqs_[i]);
+    }
+
+    for (; addition_it != pending_additions_.end(); ++addition_it) {
+        merged_ordinals.push_back(addition_it->first);
+        merged_freqs.push_back(addition_it->second);
+    }
+
+    vector<double> block_max_term_freqs;
+    max_term_freq_ = 0.0;
+
+    for (size_t block_begin = 0; block_begin < merged_freqs.size(); block_begin += BLOCK_SIZE) {
+        const size_t block_end = min(block_begin + BLOCK_SIZE, merged_freqs.size());
+        block_max_term_freqs.push_back(
+                *max_element(merged_freqs.begin() + block_begin, merged_freqs.begin() + block_end));
+        max_term_freq_ = max(max_term_freq_, block_max_term_freqs.back());
+    }
+
+    ordinals_ = move(merged_ordinals);
+    term_freqs_ = move(merged_freqs);
+    block_max_term_freqs_ = move(block_max_term_freqs);
+
+    pending_additions_.clear();
+    pending_removals_.clear();
+
+    if (format_ == PostingFormat::COMPRESSED) {
+        SealFullBlocks();
+    }
+}
+
+bool PostingList::HasPending() const {
+    return !pending_additions_.empty() || !pending_removals_.empty();
+}
+
+void PostingList::ShrinkToFit() {
+    ordinals_.ShrinkToFit();
+    term_freqs_.ShrinkToFit();
+    block_max_term_freqs_.ShrinkToFit();
+    sealed_blocks_.ShrinkToFit();
+    block_offsets_.ShrinkToFit();
+    block_last_ordinals_.ShrinkToFit();
+    pending_additions_.shrink_to_fit();
+    pending_removals_.shrink_to_fit();
+}
+
+size_t PostingList::size() const {
+    return GetSealedSize() + ordinals_.size();
+}
+
+bool PostingList::empty() const {
+    return size() == 0;
+}
+
+const MappedArray<DocumentOrdinal>& PostingList::GetOrdinals() const {
+    return ordinals_;
+}
+
+const MappedArray<double>& PostingList::GetTermFreqs() const {
+    return term_freqs_;
+}
+
+double PostingList::GetMaxTermFreq() const {
+    return max_term_freq_;
+}
+
+const MappedArray<double>& PostingList::GetBlockMaxTermFreqs() const {
+    return block_max_term_freqs_;
+}
+
+pair<size_t, size_t> PostingList::FindRange(DocumentOrdinal first, DocumentOrdinal last) const {
+    return {LowerBound(first), LowerBound(last)};
+}
+
+size_t PostingList::GetMemoryUsage() const {
+    return ordinals_.GetMemoryUsage() + term_freqs_.GetMemoryUsage() + block_max_term_freqs_.GetMemoryUsage()
+           + sealed_blocks_.GetMemoryUsage() + block_offsets_.GetMemoryUsage()
+           + block_last_ordinals_.GetMemoryUsage()
+           + pending_additions_.capacity() * sizeof(pair<DocumentOrdinal, double>)
+           + pending_removals_.capacity() * sizeof(DocumentOrdinal);
+}
+
+void PostingList::Save(SnapshotWriter& writer) const {
+    writer.Write(format_);
+    writer.Write(max_term_freq_);
+    writer.WriteArray(ordinals_.data(), ordinals_.size());
+    writer.WriteArray(term_freqs_.data(), term_freqs_.size());
+    writer.WriteArray(block_max_term_freqs_.data(), block_max_term_freqs_.size());
+    writer.WriteArray(sealed_blocks_.data(), sealed_blocks_.size());
+    writer.WriteArray(block_offsets_.data(), block_offsets_.size());
+    writer.WriteArray(block_last_ordinals_.data(), block_last_ordinals_.size());
+}
+
+PostingList PostingList::Load(SnapshotReader& reader, DocumentOrdinal first_ordinal, DocumentOrdinal last_ordinal) {
+    const auto format = reader.Read<PostingFormat>();
+
+    if (format != PostingFormat::PLAIN && format != PostingFormat::COMPRESSED) {
+        throw runtime_error("Snapshot posting list is inconsistent"s);
+    }
+
+    PostingList postings(format);
+    postings.max_term_freq_ = reader.Read<double>();
+    postings.ordinals_ = reader.ReadMappedArray<DocumentOrdinal>();
+    postings.term_freqs_ = reader.ReadMappedArray<double>();
+    postings.block_max_term_freqs_ = reader.ReadMappedArray<double>();
+    postings.sealed_blocks_ = reader.ReadMappedArray<uint8_t>();
+    postings.block_offsets_ = reader.ReadMappedArray<uint32_t>();
+    postings.block_last_ordinals_ = reader.ReadMappedArray<DocumentOrdinal>();
+
+    if (!postings.IsConsistent(first_ordinal, last_ordinal)) {
+        throw runtime_error("Snapshot posting list is inconsistent"s);
+    }
+
+    return postings;
+}
+
+bool PostingList::IsConsistent(DocumentOrdinal first_ordinal, DocumentOrdinal last_ordinal) const {
+    const size_t block_count = GetSealedBlockCount();
+    const auto is_in_range = [first_ordinal, last_ordinal](DocumentOrdinal ordinal) {
+        return first_ordinal <= ordinal && ordinal < last_ordinal;
+    };
+
+    if (term_freqs_.size() != ordinals_.size() || block_offsets_.size() != block_count
+        || block_max_term_freqs_.size() != (size() + BLOCK_SIZE - 1) / BLOCK_SIZE
+        || (format_ == PostingFormat::PLAIN && block_count > 0)
+        || !all_of(ordinals_.begin(), ordinals_.end(), is_in_range)
+        || !all_of(block_last_ordinals_.begin(), block_last_ordinals_.end(), is_in_range)
+        || adjacent_find(ordinals_.begin(), ordinals_.end(), greater_equal<DocumentOrdinal>()) != ordinals_.end()
+        || adjacent_find(block_last_ordinals_.begin(), block_last_ordinals_.end(), greater_equal<DocumentOrdinal>())
+           != block_last_ordinals_.end()
+        || (block_count > 0 && !ordinals_.empty() && block_last_ordinals_.back() >= ordinals_[0])) {
+        return false;
+    }
+
+    if (block_count == 0) {
+        return sealed_blocks_.empty();
+    }
+    if (sealed_blocks_.size() < POSTING_CODEC_PADDING || block_offsets_[0] != 0) {
+        return false;
+    }
+
+    // Содержимое блоков не читается, чтобы не затрагивать страницы снимка. Блок, начинающийся дальше
+    // наибольшей длины блока от конца данных, прочитать за пределами буфера нельзя; у последних блоков
+    // длина сверяется точно.
+    const size_t data_size = sealed_blocks_.size() - POSTING_CODEC_PADDING;
+    const size_t max_block_size = GetMaxEncodedOrdinalsSize(BLOCK_SIZE) + GetMaxEncodedTermFreqsSize(BLOCK_SIZE);
+
+    for (size_t block = 0; block < block_count; ++block) {
+        const size_t begin = block_offsets_[block];
+        const size_t end = block + 1 < block_count ? block_offsets_[block + 1] : data_size;
+        if (begin >= end || end > data_size) {
+            return false;
+        }
+        if (begin + max_block_size > data_size) {
+            const uint8_t* data = sealed_blocks_.data() + begin;
+            const size_t ordinals_size = GetEncodedOrdinalsSize(data, BLOCK_SIZE);
+            if (begin + ordinals_size >= end
+                || begin + ordinals_size + GetEncodedTermFreqsSize(data + ordinals_size, BLOCK_SIZE) != end) {
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+size_t PostingList::GetSealedBlockCount() const {
+    return block_last_ordinals_.size();
+}
+
+size_t PostingList::GetSealedSize() const {
+    return GetSealedBlockCount() * BLOCK_SIZE;
+}
+
+DocumentOrdinal PostingList::GetBlockLastOrdinal(size_t block) const {
+
+    if (block < GetSealedBlockCount()) {
+        return block_last_ordinals_[block];
+    }
+
+    return ordinals_[min((block + 1) * BLOCK_SIZE, size()) - 1 - GetSealedSize()];
+}
+
+void PostingList::DecodeBlock(size_t block, DocumentOrdinal* ordinals, double* term_freqs) const {
+    const DocumentOrdinal previous = block == 0 ? 0 : block_last_ordinals_[block - 1];
+    const uint8_t* in = DecodeOrdinals(sealed_blocks_.data() + block_offsets_[block], BLOCK_SIZE, previous, ordinals);
+    DecodeTermFreqs(in, BLOCK_SIZE, term_freqs);
+
+    // Блоки снимка не проверяются при загрузке: номера повреждённого блока не должны выйти за его границы.
+    if ((block > 0 && ordinals[0] <= previous) || ordinals[BLOCK_SIZE - 1] != block_last_ordinals_[block]
+        || adjacent_find(ordinals, ordinals + BLOCK_SIZE, greater_equal<DocumentOrdinal>()) != ordinals + BLOCK_SIZE) {
+        throw runtime_error("Posting block is corrupted"s);
+    }
+}
+
+void PostingList::SealFullBlocks() {
+    const size_t full_block_count = ordinals_.size() / BLOCK_SIZE;
+
+    if (full_block_count == 0) {
+        return;
+    }
+
+    vector<DocumentOrdinal>& ordinals = ordinals_.GetMutable();
+    vector<double>& term_freqs = term_freqs_.GetMutable();
+    vector<uint8_t>& sealed_blocks = sealed_blocks_.GetMutable();
+    vector<uint32_t>& block_offsets = block_offsets_.GetMutable();
+    vector<DocumentOrdinal>& block_last_ordinals = block_last_ordinals_.GetMutable();
+
+    if (!sealed_blocks.empty()) {
+        sealed_blocks.resize(sealed_blocks.size() - POSTING_CODEC_PADDING);
+    }
+
+    for (size_t block = 0; block < full_block_count; ++block) {
+        const size_t block_begin = block * BLOCK_SIZE;
+        const DocumentOrdinal previous = block_last_ordinals.empty() ? 0 : block_last_ordinals.back();
+        block_offsets.push_back(static_cast<uint32_t>(sealed_blocks.size()));
+        EncodeOrdinals(ordinals.data() + block_begin, BLOCK_SIZE, previous, sealed_blocks);
+        EncodeTermFreqs(term_freqs.data() + block_begin, BLOCK_SIZE, sealed_blocks);
+        block_last_ordinals.push_back(ordinals[block_begin + BLOCK_SIZE - 1]);
+    }
+
+    sealed_blocks.resize(sealed_blocks.size() + POSTING_CODEC_PADDING, 0);
+    ordinals.erase(ordinals.begin(), ordinals.begin() + full_block_count * BLOCK_SIZE);
+    term_freqs.erase(term_freqs.begin(), term_freqs.begin() + full_block_count * BLOCK_SIZE);
+
+    // После перевода всего списка в сжатый формат массивы хвоста не должны удерживать прежнюю память.
+    if (ordinals.capacity() > 2 * BLOCK_SIZE) {
+        ordinals.shrink_to_fit();
+        term_freqs.shrink_to_fit();
+        sealed_blocks.shrink_to_fit();
+    }
+}
+
+void PostingList::UnsealBlocks() {
+    const size_t sealed_size = GetSealedSize();
+
+    if (sealed_size == 0) {
+        return;
+    }
+
+    vector<DocumentOrdinal> ordinals(sealed_size + ordinals_.size());
+    vector<double> term_freqs(ordinals.size());
+
+    for (size_t block = 0; block < GetSealedBlockCount(); ++block) {
+        DecodeBlock(block, ordinals.data() + block * BLOCK_SIZE, term_freqs.data() + block * BLOCK_SIZE);
+    }
+
+    copy(ordinals_.begin(), ordinals_.end(), ordinals.begin() + sealed_size);
+    copy(term_freqs_.begin(), term_freqs_.end(), term_freqs.begin() + sealed_size);
+    ordinals_ = move(ordinals);
+    term_freqs_ = move(term_freqs);
+    sealed_blocks_.clear();
+    block_offsets_.clear();
+    block_last_ordinals_.clear();
+}
+
+size_t PostingList::LowerBound(DocumentOrdinal ordinal) const {
+    const size_t block = lower_bound(block_last_ordinals_.begin(), block_last_ordinals_.end(), ordinal)
+                         - block_last_ordinals_.begin();
+
+    if (block < GetSealedBlockCount()) {
+        DocumentOrdinal ordinals[BLOCK_SIZE];
+        const DocumentOrdinal previous = block == 0 ? 0 : block_last_ordinals_[block - 1];
+        DecodeOrdinals(sealed_blocks_.data() + block_offsets_[block], BLOCK_SIZE, previous, ordinals);
+        return block * BLOCK_SIZE + (lower_bound(ordinals, ordinals + BLOCK_SIZE, ordinal) - ordinals);
+    }
+
+    return GetSealedSize() + (lower_bound(ordinals_.begin(), ordinals_.end(), ordinal) - ordinals_.begin());
+}
+
+PostingCursor::PostingCursor(const PostingList& postings, DocumentOrdinal first, DocumentOrdinal last)
+        : postings_(&postings) {
+    tie(position_, end_) = postings.FindRange(first, last);
+    block_begin_ = block_end_ = position_;
+
+    if (position_ != end_) {
+        LoadBlock(position_ / PostingList::BLOCK_SIZE);
+    }
+}
+
+double PostingCursor::GetBlockMaxTermFreq(DocumentOrdinal last) const {
+
+    if (IsEnd() || GetOrdinal() >= last) {
+        return 0.0;
+    }
+
+    const MappedArray<double>& block_max_term_freqs = postings_->GetBlockMaxTermFreqs();
+    const size_t last_block = (end_ - 1) / PostingList::BLOCK_SIZE;
+    double max_term_freq = 0.0;
+
+    // Блоки после block начинаются с номера не меньше последнего номера block плюс один.
+    for (size_t block = position_ / PostingList::BLOCK_SIZE;; ++block) {
+        max_term_freq = max(max_term_freq, block_max_term_freqs[block]);
+        if (block == last_block || postings_->GetBlockLastOrdinal(block) + 1 >= last) {
+            break;
+        }
+    }
+
+    return max_term_freq;
+}
+
+void PostingCursor::LoadBlock(size_t block) {
+    const size_t sealed_block_count = postings_->GetSealedBlockCount();
+
+    if (block < sealed_block_count) {
+        if (!decoded_block_) {
+            decoded_block_ = make_unique<DecodedBlock>();
+        }
+        postings_->DecodeBlock(block, decoded_block_->ordinals, decoded_block_->term_freqs);
+        ordinals_ = decoded_block_->ordinals;
+        term_freqs_ = decoded_block_->term_freqs;
+        block_begin_ = block * PostingList::BLOCK_SIZE;
+        block_end_ = min(block_begin_ + PostingList::BLOCK_SIZE, end_);
+        return;
+    }
+
+    ordinals_ = postings_->ordinals_.data();
+    term_freqs_ = postings_->term_freqs_.data();
+    block_begin_ = postings_->GetSealedSize();
+    block_end_ = end_;
+}
+
+void PostingCursor::SeekForward(DocumentOrdinal target) {
+
+    if (ordinals_[block_end_ - 1 - block_begin_] < target) {
+        if (block_end_ == end_) {
+            position_ = end_;
+            return;
+        }
+        const MappedArray<DocumentOrdinal>& block_last_ordinals = postings_->block_last_ordinals_;
+        const size_t next_block = position_ / PostingList::BLOCK_SIZE + 1;
+        const size_t block = next_block >= block_last_ordinals.size()
+                             ? block_last_ordinals.size()
+                             : lower_bound(block_last_ordinals.begin() + next_block, block_last_ordinals.end(),
+                                           target) - block_last_ordinals.begin();
+        position_ = min(block * PostingList::BLOCK_SIZE, end_);
+        if (position_ == end_) {
+            return;
+        }
+        LoadBlock(block);
+    }
+
+    const DocumentOrdinal* ordinals = ordinals_;
+    const size_t block_size = block_end_ - block_begin_;
+    size_t low = position_ - block_begin_;
+
+    if (ordinals[low] >= target) {
+        return;
+    }
+
+    size_t step = 1;
+
+    while (low + step < block_size && ordinals[low + step] < target) {
+        low += step;
+        step *= 2;
+    }
+
+    const size_t high = min(low + step, block_size);
+    position_ = block_begin_ + (lower_bound(ordinals + low + 1, ordinals + high, target) - ordinals);
+}
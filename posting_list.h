@@ -0,0 +1,168 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "document.h"
+#include "mapped_array.h"
+
+class SnapshotReader;
+class SnapshotWriter;
+
+// Формат хранения постингов. В сжатом формате полные блоки запечатываются: номера документов кодируются
+// дельтами StreamVByte, частоты - без потерь таблицей значений блока или дробями с упакованными числителями
+// и знаменателями.
+enum class PostingFormat {
+    PLAIN,
+    COMPRESSED,
+};
+
+// Постинг-лист слова: отсортированные по номеру документа непрерывные массивы (структура массивов).
+// Изменения копятся в буферах и вливаются в основные массивы одним проходом в Merge().
+// Постинги разбиты на блоки по BLOCK_SIZE, для каждого блока хранится наибольшая частота слова.
+class PostingList {
+public:
+    static const size_t BLOCK_SIZE = 128;
+
+    PostingList() = default;
+
+    explicit PostingList(PostingFormat format);
+
+    // Переводит список в другой формат; содержимое и порядок постингов не меняются.
+    void SetFormat(PostingFormat format);
+
+    void Add(DocumentOrdinal ordinal, double term_freq);
+
+    void Remove(DocumentOrdinal ordinal);
+
+    // Сначала применяются удаления, затем добавления.
+    void Merge();
+
+    bool HasPending() const;
+
+    // Освобождает запас памяти массивов; вызывается для списков, которые больше не пополняются.
+    void ShrinkToFit();
+
+    size_t size() const;
+
+    bool empty() const;
+
+    // Несжатые постинги: в формате PLAIN - весь список, в сжатом - хвост после запечатанных блоков.
+    const MappedArray<DocumentOrdinal>& GetOrdinals() const;
+
+    const MappedArray<double>& GetTermFreqs() const;
+
+    // Наибольшая частота слова среди документов списка - основа верхней оценки вклада слова.
+    double GetMaxTermFreq() const;
+
+    // Наибольшая частота слова в каждом блоке постингов [i * BLOCK_SIZE, (i + 1) * BLOCK_SIZE).
+    const MappedArray<double>& GetBlockMaxTermFreqs() const;
+
+    // Полуинтервал позиций постингов, чьи номера документов лежат в [first, last).
+    std::pair<size_t, size_t> FindRange(DocumentOrdinal first, DocumentOrdinal last) const;
+
+    // Память, занятая постингами, включая буферы изменений.
+    size_t GetMemoryUsage() const;
+
+    // Буферы изменений должны быть пусты.
+    void Save(SnapshotWriter& writer) const;
+
+    // Массивы загруженного списка ссылаются на память снимка. Номера документов должны лежать
+    // в [first_ordinal, last_ordinal), а размеры массивов - соответствовать друг другу.
+    static PostingList Load(SnapshotReader& reader, DocumentOrdinal first_ordinal, DocumentOrdinal last_ordinal);
+
+private:
+    friend class PostingCursor;
+
+    PostingFormat format_ = PostingFormat::PLAIN;
+    MappedArray<DocumentOrdinal> ordinals_;
+    MappedArray<double> term_freqs_;
+    double max_term_freq_ = 0.0;
+    MappedArray<double> block_max_term_freqs_;
+    // Запечатанные блоки: block_offsets_[i] - начало блока i в sealed_blocks_, за последним блоком - запас
+    // POSTING_CODEC_PADDING байт для декодера.
+    MappedArray<uint8_t> sealed_blocks_;
+    MappedArray<uint32_t> block_offsets_;
+    MappedArray<DocumentOrdinal> block_last_ordinals_;
+    std::vector<std::pair<DocumentOrdinal, double>> pending_additions_;
+    std::vector<DocumentOrdinal> pending_removals_;
+
+    size_t GetSealedBlockCount() const;
+
+    bool IsConsistent(DocumentOrdinal first_ordinal, DocumentOrdinal last_ordinal) const;
+
+    size_t GetSealedSize() const;
+
+    DocumentOrdinal GetBlockLastOrdinal(size_t block) const;
+
+    // Запечатанный блок всегда содержит ровно BLOCK_SIZE постингов.
+    void DecodeBlock(size_t block, DocumentOrdinal* ordinals, double* term_freqs) const;
+
+    // Запечатывает полные блоки из начала несжатых постингов.
+    void SealFullBlocks();
+
+    // Возвращает запечатанные блоки в несжатые массивы.
+    void UnsealBlocks();
+
+    size_t LowerBound(DocumentOrdinal ordinal) const;
+};
+
+// Курсор по части постинг-листа с номерами документов из [first, last).
+// Запечатанные блоки декодируются по одному по мере продвижения.
+class PostingCursor {
+public:
+    PostingCursor(const PostingList& postings, DocumentOrdinal first, DocumentOrdinal last);
+
+    bool IsEnd() const {
+        return position_ == end_;
+    }
+
+    DocumentOrdinal GetOrdinal() const {
+        return ordinals_[position_ - block_begin_];
+    }
+
+    double GetTermFreq() const {
+        return term_freqs_[position_ - block_begin_];
+    }
+
+    void Next() {
+        if (++position_ == block_end_ && position_ != end_) {
+            LoadBlock(position_ / PostingList::BLOCK_SIZE);
+        }
+    }
+
+    // Переходит к первому постингу с номером не меньше target (галопирующий поиск вперёд).
+    void Seek(DocumentOrdinal target) {
+        if (!IsEnd() && GetOrdinal() < target) {
+            SeekForward(target);
+        }
+    }
+
+    // Верхняя оценка частоты слова среди оставшихся постингов курсора с номерами меньше last.
+    // Считается по максимумам блоков, поэтому стоит O(затронутых блоков).
+    double GetBlockMaxTermFreq(DocumentOrdinal last) const;
+
+private:
+    struct DecodedBlock {
+        DocumentOrdinal ordinals[PostingList::BLOCK_SIZE];
+        double term_freqs[PostingList::BLOCK_SIZE];
+    };
+
+    const PostingList* postings_;
+    const DocumentOrdinal* ordinals_ = nullptr;
+    const double* term_freqs_ = nullptr;
+    size_t position_;
+    size_t end_;
+    // Позиции [block_begin_, block_end_) доступны через ordinals_ и term_freqs_.
+    size_t block_begin_;
+    size_t block_end_;
+    std::unique_ptr<DecodedBlock> decoded_block_;
+
+    void LoadBlock(size_t block);
+
+    void SeekForward(DocumentOrdinal target);
+};
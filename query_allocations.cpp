@@ -0,0 +1,76 @@
+#include "search_server.h"
+#include "random_text.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <execution>
+#include <iostream>
+#include <new>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// Число выделений памяти в куче во всей программе - для замера выделений на запрос. Глобальный operator new
+// заменён только в этой программе, поисковый сервер выделяет память штатно.
+atomic<size_t> allocation_count{0};
+
+void* operator new(size_t size) {
+    ++allocation_count;
+    if (void* data = malloc(size > 0 ? size : 1)) {
+        return data;
+    }
+    throw bad_alloc();
+}
+
+void operator delete(void* data) noexcept {
+    free(data);
+}
+
+void operator delete(void* data, size_t) noexcept {
+    free(data);
+}
+
+// Выделения памяти в куче на типичный запрос из нескольких слов, с минус-словами и повторами.
+void BenchmarkQueryAllocations(mt19937& generator, const SearchServer& search_server,
+                               const vector<string>& dictionary) {
+    vector<string> queries;
+    for (int i = 0; i < 1000; ++i) {
+        queries.push_back(GenerateQuery(generator, dictionary, 6, 0.2));
+    }
+
+    const auto measure = [&queries](string_view mark, const auto& process_query) {
+        const size_t initial_count = allocation_count;
+        for (const string& query: queries) {
+            process_query(query);
+        }
+        cout << mark << ": "sv << (allocation_count - initial_count) * 1.0 / queries.size()
+             << " allocations per query"sv << endl;
+    };
+    measure("find seq"sv, [&search_server](const string& query) {
+        search_server.FindTopDocuments(query);
+    });
+    measure("find par"sv, [&search_server](const string& query) {
+        search_server.FindTopDocuments(execution::par, query);
+    });
+    measure("match seq"sv, [&search_server](const string& query) {
+        search_server.MatchDocument(query, 0);
+    });
+    measure("match par"sv, [&search_server](const string& query) {
+        search_server.MatchDocument(execution::par, query, 0);
+    });
+}
+
+int main() {
+    mt19937 generator;
+    const auto dictionary = GenerateDictionary(generator, 1000, 10);
+    const auto documents = GenerateQueries(generator, dictionary, 20'000, 70);
+
+    SearchServer search_server(dictionary[0]);
+    for (size_t i = 0; i < documents.size(); ++i) {
+        search_server.AddDocument(static_cast<int>(i), documents[i], DocumentStatus::ACTUAL, {1, 2, 3});
+    }
+
+    BenchmarkQueryAllocations(generator, search_server, dictionary);
+}
@@ -0,0 +1,261 @@
+#include "query_result_cache.h"
+
+#include <algorithm>
+#include <array>
+#include <list>
+#include <mutex>
+#include <unordered_map>
+
+using namespace std;
+
+namespace {
+
+uint64_t HashKey(const QueryResultCache::Key& key) {
+    uint64_t hash = 0xCBF29CE484222325ull ^ key.size();
+    for (const uint32_t value: key) {
+        hash = (hash ^ value) * 0x9E3779B97F4A7C15ull;
+        hash ^= hash >> 29;
+    }
+    return hash;
+}
+
+struct KeyHasher {
+    size_t operator()(const QueryResultCache::Key& key) const {
+        return static_cast<size_t>(HashKey(key));
+    }
+};
+
+struct KeyEqual {
+    bool operator()(const QueryResultCache::Key& lhs, const QueryResultCache::Key& rhs) const {
+        return equal(lhs.begin(), lhs.end(), rhs.begin(), rhs.end());
+    }
+};
+
+// Оценка частот ключей: скетч count-min из ROW_COUNT строк счётчиков до 15. Когда число учтённых обращений
+// достигает sample_size, все счётчики делятся пополам.
+class FrequencySketch {
+public:
+    explicit FrequencySketch(size_t capacity) {
+        while (width_ < capacity * 4) {
+            width_ *= 2;
+        }
+        counters_.assign(width_ * ROW_COUNT, 0);
+        sample_size_ = width_ * 10;
+    }
+
+    void Increment(uint64_t hash) {
+        for (size_t row = 0; row < ROW_COUNT; ++row) {
+            uint8_t& counter = counters_[row * width_ + GetColumn(hash, row)];
+            counter += counter < MAX_COUNT ? 1 : 0;
+        }
+        if (++sample_count_ == sample_size_) {
+            for (uint8_t& counter: counters_) {
+                counter /= 2;
+            }
+            sample_count_ /= 2;
+        }
+    }
+
+    size_t Estimate(uint64_t hash) const {
+        uint8_t frequency = MAX_COUNT;
+        for (size_t row = 0; row < ROW_COUNT; ++row) {
+            frequency = min(frequency, counters_[row * width_ + GetColumn(hash, row)]);
+        }
+        return frequency;
+    }
+
+    size_t GetMemoryUsage() const {
+        return counters_.size();
+    }
+
+private:
+    static const size_t ROW_COUNT = 4;
+    static const uint8_t MAX_COUNT = 15;
+    static constexpr array<uint64_t, ROW_COUNT> SEEDS = {0xC3A5C85C97CB3127ull, 0xB492B66FBE98F273ull,
+                                                         0x9AE16A3B2F90404Full, 0xCBF29CE484222325ull};
+
+    size_t width_ = 64; // Степень двойки.
+    vector<uint8_t> counters_;
+    size_t sample_size_ = 0;
+    size_t sample_count_ = 0;
+
+    size_t GetColumn(uint64_t hash, size_t row) const {
+        return static_cast<size_t>((hash * SEEDS[row]) >> 32) & (width_ - 1);
+    }
+};
+
+} // namespace
+
+struct QueryResultCache::Shard {
+    struct Entry {
+        Key key;
+        uint64_t hash;
+        uint64_t generation;
+        vector<Document> documents;
+    };
+
+    using Entries = list<Entry>;
+
+    mutex entries_mutex;
+    size_t capacity;
+    Entries entries; // От недавно использованных к давно использованным.
+    unordered_map<Key, Entries::iterator, KeyHasher, KeyEqual> index;
+    FrequencySketch sketch;
+    ResultCacheStats stats;
+
+    explicit Shard(size_t shard_capacity) : capacity(shard_capacity), sketch(shard_capacity) {
+    }
+
+    static size_t GetEntryMemoryUsage(const Entry& entry) {
+        // Ключ хранится и в записи, и в индексе; узлы списка и индекса - по два указателя сверх данных.
+        const size_t key_memory_usage = entry.key.IsInline() ? 0 : entry.key.size() * sizeof(uint32_t);
+        return sizeof(Entry) + 2 * sizeof(void*) + sizeof(pair<const Key, Entries::iterator>) + 2 * sizeof(void*)
+               + 2 * key_memory_usage + entry.documents.capacity() * sizeof(Document);
+    }
+
+    void Erase(Entries::iterator entry) {
+        stats.memory_usage -= GetEntryMemoryUsage(*entry);
+        index.erase(entry->key);
+        entries.erase(entry);
+    }
+};
+
+double ResultCacheStats::GetHitRate() const {
+    return hits + misses == 0 ? 0.0 : static_cast<double>(hits) / static_cast<double>(hits + misses);
+}
+
+QueryResultCache::QueryResultCache() = default;
+
+QueryResultCache::QueryResultCache(size_t capacity, size_t shard_count)
+    : capacity_(capacity), shard_count_(max<size_t>(shard_count, 1)) {
+    // Шардов не больше, чем записей, и ёмкости шардов в сумме дают ровно capacity.
+    const size_t used_shard_count = min(shard_count_, capacity_);
+    for (size_t i = 0; i < used_shard_count; ++i) {
+        shards_.push_back(make_unique<Shard>(capacity_ / used_shard_count + (i < capacity_ % used_shard_count)));
+    }
+}
+
+QueryResultCache::QueryResultCache(const QueryResultCache& other)
+    : QueryResultCache(other.capacity_, other.shard_count_) {
+}
+
+QueryResultCache& QueryResultCache::operator=(const QueryResultCache& other) {
+    if (this != &other) {
+        *this = QueryResultCache(other.capacity_, other.shard_count_);
+    }
+    return *this;
+}
+
+QueryResultCache::QueryResultCache(QueryResultCache&& other) noexcept = default;
+
+QueryResultCache& QueryResultCache::operator=(QueryResultCache&& other) noexcept = default;
+
+QueryResultCache::~QueryResultCache() = default;
+
+bool QueryResultCache::IsEnabled() const {
+    return !shards_.empty();
+}
+
+size_t QueryResultCache::GetCapacity() const {
+    return capacity_;
+}
+
+optional<vector<Document>> QueryResultCache::Find(const Key& key, uint64_t generation) {
+    if (!IsEnabled()) {
+        return nullopt;
+    }
+
+    const uint64_t hash = HashKey(key);
+    Shard& shard = GetShard(hash);
+    lock_guard lock(shard.entries_mutex);
+    shard.sketch.Increment(hash);
+    const auto it = shard.index.find(key);
+
+    if (it == shard.index.end()) {
+        ++shard.stats.misses;
+        return nullopt;
+    }
+    if (it->second->generation != generation) {
+        ++shard.stats.misses;
+        ++shard.stats.invalidations;
+        shard.Erase(it->second);
+        return nullopt;
+    }
+
+    ++shard.stats.hits;
+    shard.entries.splice(shard.entries.begin(), shard.entries, it->second);
+
+    return it->second->documents;
+}
+
+void QueryResultCache::Insert(const Key& key, uint64_t generation, const vector<Document>& documents) {
+    if (!IsEnabled()) {
+        return;
+    }
+
+    const uint64_t hash = HashKey(key);
+    Shard& shard = GetShard(hash);
+    lock_guard lock(shard.entries_mutex);
+    const auto it = shard.index.find(key);
+
+    // Тот же запрос мог быть вычислен параллельно: остаётся результат последнего поколения.
+    if (it != shard.index.end()) {
+        Shard::Entry& entry = *it->second;
+        if (entry.generation <= generation) {
+            shard.stats.memory_usage -= Shard::GetEntryMemoryUsage(entry);
+            entry.generation = generation;
+            entry.documents = documents;
+            shard.stats.memory_usage += Shard::GetEntryMemoryUsage(entry);
+        }
+        shard.entries.splice(shard.entries.begin(), shard.entries, it->second);
+        return;
+    }
+
+    if (shard.entries.size() == shard.capacity) {
+        const auto victim = prev(shard.entries.end());
+        // Новая запись, которую спрашивали не чаще вытесняемой, не попадает в кэш: так однократные запросы
+        // не вымывают популярные.
+        if (shard.sketch.Estimate(hash) <= shard.sketch.Estimate(victim->hash)) {
+            ++shard.stats.rejections;
+            return;
+        }
+        ++shard.stats.evictions;
+        shard.Erase(victim);
+    }
+
+    shard.entries.push_front({key, hash, generation, documents});
+    shard.index.emplace(key, shard.entries.begin());
+    shard.stats.memory_usage += Shard::GetEntryMemoryUsage(shard.entries.front());
+}
+
+void QueryResultCache::Clear() {
+    for (const auto& shard: shards_) {
+        lock_guard lock(shard->entries_mutex);
+        shard->index.clear();
+        shard->entries.clear();
+        shard->stats.memory_usage = 0;
+    }
+}
+
+ResultCacheStats QueryResultCache::GetStats() const {
+    ResultCacheStats stats;
+
+    for (const auto& shard: shards_) {
+        lock_guard lock(shard->entries_mutex);
+        stats.hits += shard->stats.hits;
+        stats.misses += shard->stats.misses;
+        stats.evictions += shard->stats.evictions;
+        stats.rejections += shard->stats.rejections;
+        stats.invalidations += shard->stats.invalidations;
+        stats.entry_count += shard->entries.size();
+        stats.memory_usage += sizeof(Shard) + shard->stats.memory_usage + shard->sketch.GetMemoryUsage()
+                              + shard->index.bucket_count() * sizeof(void*);
+    }
+
+    return stats;
+}
+
+QueryResultCache::Shard& QueryResultCache::GetShard(uint64_t hash) {
+    // Шард выбирают старшие биты хеша, чтобы ключи одного шарда не собирались в немногих корзинах его индекса.
+    return *shards_[(hash >> 40) % shards_.size()];
+}
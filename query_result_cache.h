@@ -0,0 +1,78 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <vector>
+
+#include "document.h"
+#include "small_vector.h"
+
+// Статистика кэша результатов с момента его создания.
+struct ResultCacheStats {
+    size_t hits = 0;
+    size_t misses = 0;
+    // Записи, вытесненные новыми.
+    size_t evictions = 0;
+    // Новые записи, не допущенные в полный шард как более редкие, чем вытесняемая.
+    size_t rejections = 0;
+    // Записи, отброшенные, потому что индекс изменился после их вычисления.
+    size_t invalidations = 0;
+    size_t entry_count = 0;
+    size_t memory_usage = 0;
+
+    double GetHitRate() const;
+};
+
+// Кэш результатов поиска на ограниченное число записей. Записи разбиты на шарды по хешу ключа, у каждого шарда
+// свой мьютекс, поэтому кэшем пользуются параллельные запросы. Внутри шарда записи вытесняются в порядке LRU,
+// а новая запись в полный шард допускается (TinyLFU), только если её ключ запрашивали чаще, чем ключ
+// вытесняемой записи. Частоты ключей оцениваются скетчем count-min, чьи счётчики периодически делятся пополам,
+// так что старая популярность забывается. Запись помнит поколение индекса, при котором вычислена, и при другом
+// поколении отбрасывается.
+class QueryResultCache {
+public:
+    using Key = SmallVector<uint32_t, 32>;
+
+    // Выключенный кэш: ничего не хранит, поиск в нём всегда промахивается.
+    QueryResultCache();
+
+    explicit QueryResultCache(size_t capacity, size_t shard_count = DEFAULT_SHARD_COUNT);
+
+    // Кэш - производные данные, поэтому копия начинает с пустого кэша той же ёмкости.
+    QueryResultCache(const QueryResultCache& other);
+
+    QueryResultCache& operator=(const QueryResultCache& other);
+
+    QueryResultCache(QueryResultCache&& other) noexcept;
+
+    QueryResultCache& operator=(QueryResultCache&& other) noexcept;
+
+    ~QueryResultCache();
+
+    bool IsEnabled() const;
+
+    size_t GetCapacity() const;
+
+    // Результат, вычисленный при поколении индекса generation, или nullopt. Каждый поиск учитывается
+    // в частоте ключа.
+    std::optional<std::vector<Document>> Find(const Key& key, uint64_t generation);
+
+    void Insert(const Key& key, uint64_t generation, const std::vector<Document>& documents);
+
+    void Clear();
+
+    ResultCacheStats GetStats() const;
+
+private:
+    static const size_t DEFAULT_SHARD_COUNT = 16;
+
+    struct Shard;
+
+    size_t capacity_ = 0;
+    size_t shard_count_ = DEFAULT_SHARD_COUNT;
+    std::vector<std::unique_ptr<Shard>> shards_;
+
+    Shard& GetShard(uint64_t hash);
+};
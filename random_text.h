@@ -0,0 +1,18 @@
+#pragma once
+
+#include <random>
+#include <string>
+#include <vector>
+
+// Случайные слова, документы и запросы для бенчмарков.
+
+std::string GenerateWord(std::mt19937& generator, int max_length);
+
+std::vector<std::string> GenerateDictionary(std::mt19937& generator, int word_count, int max_length);
+
+// Каждое слово становится минус-словом с вероятностью minus_prob.
+std::string GenerateQuery(std::mt19937& generator, const std::vector<std::string>& dictionary, int word_count,
+                          double minus_prob = 0);
+
+std::vector<std::string> GenerateQueries(std::mt19937& generator, const std::vector<std::string>& dictionary,
+                                         int query_count, int max_word_count);
@@ -1,37 +1,51 @@
 #include "remove_duplicates.h"
-#include <set>
-#include <string>
+#include <algorithm>
 #include <iostream>
 #include <map>
+#include <utility>
+#include <vector>
 
 using namespace std;
 
-void RemoveDuplicates(SearchServer& search_server) {
-    map<int, set<string>> ids_to_words;
-    set<int> ids_to_remove;
+namespace {
 
-    for (const int id: search_server) {
-        for (const auto& [word, freq]: search_server.GetWordFrequencies(id)) {
-            ids_to_words[id].insert(string(word));
-        }
+// Наборы слов сравниваются по упорядоченным id термов в памяти прямого индекса, без копирования строк.
+struct TermsLess {
+    bool operator()(const DocumentTerms& lhs, const DocumentTerms& rhs) const {
+        return lexicographical_compare(lhs.terms, lhs.terms + lhs.size, rhs.terms, rhs.terms + rhs.size);
     }
+};
+
+} // namespace
+
+void RemoveDuplicates(SearchServer& search_server) {
+    // Набор слов -> наименьший id документа с ним.
+    map<DocumentTerms, int, TermsLess> terms_to_id;
+    // Оставляемый документ и его дубликат.
+    vector<pair<int, int>> duplicates;
 
-    for (const auto& [id, words]: ids_to_words) {
-        if (ids_to_remove.count(id)) {
+    for (const int id: search_server) {
+        const DocumentTerms terms = search_server.GetWordFrequencies(id).GetTerms();
+        if (terms.size == 0) {
             continue;
         }
-        for (const auto& [id2, words2]: ids_to_words) {
-            if (id2 == id || ids_to_remove.count(id2)) {
-                continue;
-            }
-            if (words2 == words) {
-                ids_to_remove.insert(id2);
-                cout << "Found duplicate document id "s << id2 << endl;
-            }
+        const auto [it, inserted] = terms_to_id.emplace(terms, id);
+        if (!inserted) {
+            duplicates.emplace_back(it->second, id);
         }
     }
 
-    for (const int id: ids_to_remove) {
-        search_server.RemoveDocument(id);
+    // Дубликаты сообщаются группами по оставляемому документу.
+    stable_sort(duplicates.begin(), duplicates.end(), [](const auto& lhs, const auto& rhs) {
+        return lhs.first < rhs.first;
+    });
+
+    for (const auto& [id, duplicate_id]: duplicates) {
+        cout << "Found duplicate document id "s << duplicate_id << endl;
+    }
+
+    // Удаление может перестроить прямой индекс, поэтому идёт после того, как слова документов больше не нужны.
+    for (const auto& [id, duplicate_id]: duplicates) {
+        search_server.RemoveDocument(duplicate_id);
     }
 }
@@ -0,0 +1,85 @@
+#include "score_accumulator.h"
+#include <algorithm>
+
+using namespace std;
+
+namespace {
+
+vector<unique_ptr<ScoreAccumulator>>& GetThreadPool() {
+    thread_local vector<unique_ptr<ScoreAccumulator>> pool;
+    return pool;
+}
+
+} // namespace
+
+void ScoreAccumulator::Reset(size_t ordinal_count) {
+
+    for (const DocumentOrdinal ordinal: touched_) {
+        scores_[ordinal] = 0.0;
+        states_[ordinal] = UNTOUCHED;
+    }
+
+    if (has_exclusions_) {
+        fill(excluded_.begin(), excluded_.end(), 0);
+        has_exclusions_ = false;
+    }
+
+    touched_.clear();
+
+    if (scores_.size() < ordinal_count) {
+        scores_.resize(ordinal_count, 0.0);
+        states_.resize(ordinal_count, UNTOUCHED);
+        excluded_.resize((ordinal_count + 63) / 64, 0);
+    }
+}
+
+void ScoreAccumulator::Exclude(const DocumentBitmap& bitmap, DocumentOrdinal first, DocumentOrdinal last) {
+    bitmap.MarkRange(first, last, excluded_.data());
+    has_exclusions_ = true;
+}
+
+void ScoreAccumulator::Exclude(const vector<uint64_t>& mask, DocumentOrdinal first, DocumentOrdinal last) {
+    const size_t shift = first % 64;
+
+    // Слово i аккумулятора собирается из двух соседних слов маски, начиная с бита first.
+    for (size_t word = 0; word * 64 < last - first; ++word) {
+        const size_t mask_word = first / 64 + word;
+        uint64_t bits = mask_word < mask.size() ? mask[mask_word] >> shift : 0;
+        if (shift != 0 && mask_word + 1 < mask.size()) {
+            bits |= mask[mask_word + 1] << (64 - shift);
+        }
+        if (last - first - word * 64 < 64) {
+            bits &= (uint64_t{1} << (last - first - word * 64)) - 1;
+        }
+        excluded_[word] |= bits;
+    }
+
+    has_exclusions_ = true;
+}
+
+const vector<DocumentOrdinal>& ScoreAccumulator::GetTouched() const {
+    return touched_;
+}
+
+PooledScoreAccumulator::PooledScoreAccumulator() {
+    auto& pool = GetThreadPool();
+
+    if (pool.empty()) {
+        accumulator_ = make_unique<ScoreAccumulator>();
+    } else {
+        accumulator_ = move(pool.back());
+        pool.pop_back();
+    }
+}
+
+PooledScoreAccumulator::~PooledScoreAccumulator() {
+    GetThreadPool().push_back(move(accumulator_));
+}
+
+ScoreAccumulator& PooledScoreAccumulator::operator*() const {
+    return *accumulator_;
+}
+
+ScoreAccumulator* PooledScoreAccumulator::operator->() const {
+    return accumulator_.get();
+}
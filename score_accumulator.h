@@ -0,0 +1,93 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "document.h"
+#include "document_bitmap.h"
+
+// Плотный массив релевантностей, индексируемый номером документа.
+// Список затронутых номеров позволяет сбросить состояние за O(затронутых), а не O(всех документов).
+// Исключённые документы отмечены в битовой маске, которую можно заполнять целыми словами.
+class ScoreAccumulator {
+public:
+    // Подготавливает аккумулятор для номеров [0, ordinal_count), очищая следы предыдущего запроса.
+    void Reset(size_t ordinal_count);
+
+    // Исключённый документ (минус-слово) больше не принимает очков и не попадает в выдачу.
+    void Exclude(DocumentOrdinal ordinal) {
+        excluded_[ordinal / 64] |= uint64_t{1} << (ordinal % 64);
+        has_exclusions_ = true;
+        if (states_[ordinal] == TOUCHED) {
+            scores_[ordinal] = 0.0;
+        }
+    }
+
+    // Исключает документы first + i из bitmap как номера i. Вызывается до начала подсчёта.
+    void Exclude(const DocumentBitmap& bitmap, DocumentOrdinal first, DocumentOrdinal last);
+
+    // Исключает документы first + i, чей бит в mask (индекс бита - номер документа) установлен, как номера i.
+    // Вызывается до начала подсчёта.
+    void Exclude(const std::vector<uint64_t>& mask, DocumentOrdinal first, DocumentOrdinal last);
+
+    bool IsExcluded(DocumentOrdinal ordinal) const {
+        return (excluded_[ordinal / 64] >> (ordinal % 64)) & 1;
+    }
+
+    bool IsTouched(DocumentOrdinal ordinal) const {
+        return states_[ordinal] == TOUCHED && !IsExcluded(ordinal);
+    }
+
+    void Add(DocumentOrdinal ordinal, double score) {
+        if (IsExcluded(ordinal)) {
+            return;
+        }
+        uint8_t& state = states_[ordinal];
+        if (state == UNTOUCHED) {
+            state = TOUCHED;
+            touched_.push_back(ordinal);
+        }
+        scores_[ordinal] += score;
+    }
+
+    // Номера документов, получивших очки, в порядке первого касания. Может содержать исключённые позже номера.
+    const std::vector<DocumentOrdinal>& GetTouched() const;
+
+    double GetScore(DocumentOrdinal ordinal) const {
+        return scores_[ordinal];
+    }
+
+private:
+    enum : uint8_t {
+        UNTOUCHED,
+        TOUCHED,
+    };
+
+    std::vector<double> scores_;
+    std::vector<uint8_t> states_;
+    std::vector<DocumentOrdinal> touched_;
+    std::vector<uint64_t> excluded_;
+    bool has_exclusions_ = false;
+};
+
+// Аккумулятор из пула текущего потока: повторные запросы переиспользуют уже выделенную память.
+// Вложенный запрос (например, из предиката) получает из пула отдельный экземпляр.
+class PooledScoreAccumulator {
+public:
+    PooledScoreAccumulator();
+
+    PooledScoreAccumulator(const PooledScoreAccumulator&) = delete;
+
+    PooledScoreAccumulator& operator=(const PooledScoreAccumulator&) = delete;
+
+    ~PooledScoreAccumulator();
+
+    ScoreAccumulator& operator*() const;
+
+    ScoreAccumulator* operator->() const;
+
+private:
+    std::unique_ptr<ScoreAccumulator> accumulator_;
+};
@@ -1,10 +1,29 @@
 #include "search_server.h"
+#include <limits>
 #include <numeric>
+#include <unordered_map>
+#include <unordered_set>
 
 using namespace std;
 
-SearchServer::SearchServer(string_view stop_words_text)
-        : SearchServer(SplitIntoWords(stop_words_text)) {
+SearchServer::SearchServer(string_view stop_words_text) {
+    vector<string_view> stop_words;
+
+    for (WordTokenizer tokenizer(stop_words_text); tokenizer.Next();) {
+        if (tokenizer.HasForbiddenChars()) {
+            throw invalid_argument("Forbidden characters in stop-words."s);
+        }
+        stop_words.push_back(tokenizer.GetWord());
+    }
+
+    stop_words_ = StopWordFilter(stop_words);
+}
+
+SearchServer::SearchServer(StopWordFilter stop_words) : stop_words_(move(stop_words)) {
+
+    if (!all_of(stop_words_.begin(), stop_words_.end(), IsValidWord)) {
+        throw invalid_argument("Forbidden characters in stop-words."s);
+    }
 }
 
 void SearchServer::AddDocument(int document_id, string_view document, DocumentStatus status,
@@ -12,57 +31,70 @@ void SearchServer::AddDocument(int document_id, string_view document, DocumentSt
 
     if (document_id < 0) {
         throw invalid_argument("Negative document ID."s);
-    } else if (documents_.count(document_id) > 0) {
+    } else if (documents_.Contains(document_id)) {
         throw invalid_argument("Double addition of the document."s);
     }
 
     const vector<std::string_view> words = SplitIntoWordsNoStop(document);
     const double inv_word_count = 1.0 / words.size();
+    map<TermId, double> term_freqs;
 
     for (string_view word: words) {
-        document_to_word_freqs_[document_id][string(word)] += inv_word_count;
-        word_to_document_freqs_[document_to_word_freqs_[document_id].find(word)->first][document_id] += inv_word_count;
+        term_freqs[dictionary_.Intern(word)] += inv_word_count;
     }
 
-    documents_.emplace(document_id, DocumentData{ComputeAverageRating(ratings), status});
-    document_ids_.insert(document_id);
-}
+    document_freqs_.resize(dictionary_.size(), 0);
+    const DocumentOrdinal ordinal = documents_.Add(document_id, ComputeAverageRating(ratings), status);
+    IndexSegment& segment = GetMutableSegment();
+
+    // Номера документов выдаются по возрастанию, поэтому постинг дописывается в конец списка без буфера
+    // и слияния. Удаления не трогают постинги до пакетного сжатия в CompactPostings.
+    for (const auto [term, term_freq]: term_freqs) {
+        const size_t index = GetPostingIndex(term, status);
+        PostingList& postings = segment.GetPostings(index);
+        postings.Add(ordinal, term_freq);
+        assert(!postings.HasPending());
+        segment.GetBitmaps().Invalidate(index);
+        ++document_freqs_[term];
+        UpdateInverseDocumentFreq(term);
+    }
 
-void SearchServer::RemoveDocument(int document_id) {
+    forward_index_.Add(term_freqs);
+    ++generation_;
+    UpdateInverseDocumentFreqs();
+    MaintainSegments();
+}
 
-    if (!document_ids_.count(document_id)) {
-        throw invalid_argument("Attempt to remove non-existing ID."s);
-    }
+void SearchServer::AddDocuments(const vector<DocumentData>& batch) {
+    AddDocuments(execution::seq, batch);
+}
 
-    for (const auto& [word, freqs]: document_to_word_freqs_.at(document_id)) {
-        word_to_document_freqs_.at(word).erase(document_id);
-    }
+void SearchServer::RemoveDocument(int document_id) {
+    RemoveDocument(execution::seq, document_id);
+}
 
-    document_to_word_freqs_.erase(document_id);
-    documents_.erase(document_id);
-    document_ids_.erase(document_id);
+void SearchServer::CompactPostings() {
+    CompactPostings(execution::seq);
 }
 
-vector<Document> SearchServer::FindTopDocuments(string_view raw_query, DocumentStatus status) const {
-    return FindTopDocuments(
-            raw_query,
-            [status](int document_id, DocumentStatus document_status, int rating) {
-                return document_status == status;
-            });
+vector<Document> SearchServer::FindTopDocuments(string_view raw_query, DocumentStatus status,
+                                                size_t top_count) const {
+    return FindTopDocuments(raw_query, StatusPredicate{status}, top_count);
 }
 
 vector<Document> SearchServer::FindTopDocuments(string_view raw_query) const {
     return FindTopDocuments(raw_query, DocumentStatus::ACTUAL);
 }
 
-const map<string_view, double>& SearchServer::GetWordFrequencies(int document_id) const {
+WordFrequencies SearchServer::GetWordFrequencies(int document_id) const {
+
+    const auto ordinal = documents_.FindOrdinal(document_id);
 
-    if (!document_to_word_freqs_.count(document_id)) {
-        static const map<string_view, double>& dummy = {};
-        return dummy;
+    if (!ordinal) {
+        return {};
     }
 
-    return (map<std::string_view, double>&) document_to_word_freqs_.at(document_id);
+    return {dictionary_, forward_index_.Get(*ordinal)};
 }
 
 
@@ -73,60 +105,263 @@ int SearchServer::GetDocumentCount() const {
 tuple<vector<string_view>, DocumentStatus>
 SearchServer::MatchDocument(string_view raw_query, int document_id) const {
 
-    if (!document_ids_.count(document_id)) {
+    const auto ordinal = documents_.FindOrdinal(document_id);
+
+    if (!ordinal) {
         throw out_of_range("Document ID is out of range."s);
     }
 
     const Query query = ParseQuery(raw_query);
+    const DocumentTerms terms = forward_index_.Get(*ordinal);
     vector<string_view> matched_words;
 
-    if (any_of(query.minus_words.begin(), query.minus_words.end(),
-               [this, document_id](std::string_view word) {
-                   return document_to_word_freqs_.at(document_id).count(word);
-               })) {
-        return tuple{matched_words, documents_.at(document_id).status};
+    if (query.matches_nothing
+        || any_of(query.minus_terms.begin(), query.minus_terms.end(),
+                  [this, ordinal = *ordinal](TermId term) {
+                      return HasTerm(ordinal, term);
+                  })
+        || !all_of(query.required_terms.begin(), query.required_terms.end(),
+                   [&terms](TermId term) {
+                       return terms.Find(term).has_value();
+                   })) {
+        return tuple{matched_words, documents_.GetStatus(*ordinal)};
     }
 
-    for (const string_view word: query.plus_words) {
-        if (word_to_document_freqs_.count(word) == 0) {
-            continue;
+    for (const TermId term: query.plus_terms) {
+        if (terms.Find(term)) {
+            matched_words.push_back(dictionary_.GetTerm(term));
+        }
+    }
+
+    sort(matched_words.begin(), matched_words.end());
+
+    return tuple{matched_words, documents_.GetStatus(*ordinal)};
+}
+
+DocumentIdMap::Iterator SearchServer::begin() const {
+    return documents_.begin();
+}
+
+DocumentIdMap::Iterator SearchServer::end() const {
+    return documents_.end();
+}
+
+void SearchServer::SetQueryEvaluation(QueryEvaluation query_evaluation) {
+    query_evaluation_ = query_evaluation;
+    result_cache_.Clear();
+}
+
+void SearchServer::SetRelevanceMode(RelevanceMode relevance_mode) {
+    relevance_mode_ = relevance_mode;
+    result_cache_.Clear();
+
+    if (relevance_mode_ == RelevanceMode::CACHED_IDF) {
+        RefreshInverseDocumentFreqs();
+    }
+}
+
+void SearchServer::RefreshInverseDocumentFreqs() {
+    result_cache_.Clear();
+    cached_document_count_ = documents_.size();
+    inverse_document_freqs_.assign(dictionary_.size(), 0.0);
+    cached_document_freqs_.assign(dictionary_.size(), 0);
+
+    for (TermId term = 0; term < dictionary_.size(); ++term) {
+        cached_document_freqs_[term] = GetDocumentFreq(term);
+        if (cached_document_freqs_[term] > 0) {
+            inverse_document_freqs_[term] = log(cached_document_count_ * 1.0 / cached_document_freqs_[term]);
         }
-        if (document_to_word_freqs_.at(document_id).count(word)) {
-            matched_words.push_back(word);
+    }
+}
+
+void SearchServer::SetPostingFormat(PostingFormat posting_format) {
+    posting_format_ = posting_format;
+
+    for (auto& segment: segments_) {
+        if (segment.use_count() > 1) {
+            segment = make_shared<IndexSegment>(*segment);
         }
+        segment->SetFormat(posting_format_);
+    }
+}
+
+void SearchServer::SetSegmentPolicy(const SegmentPolicy& segment_policy) {
+    segment_policy_ = segment_policy;
+    MaintainSegments();
+}
+
+SegmentStats SearchServer::GetSegmentStats() const {
+    SegmentStats segment_stats = segment_stats_;
+    segment_stats.segment_count = segments_.size();
+    return segment_stats;
+}
+
+uint64_t SearchServer::GetGeneration() const {
+    return generation_;
+}
+
+void SearchServer::SetResultCacheCapacity(size_t capacity) {
+    result_cache_ = QueryResultCache(capacity);
+}
+
+ResultCacheStats SearchServer::GetResultCacheStats() const {
+    return result_cache_.GetStats();
+}
+
+size_t SearchServer::GetPostingCount() const {
+    size_t posting_count = 0;
+
+    for (const auto& segment: segments_) {
+        posting_count += segment->GetPostingCount();
     }
 
-    return tuple{matched_words, documents_.at(document_id).status};
+    return posting_count;
 }
 
-set<int>::const_iterator SearchServer::begin() const {
-    return document_ids_.begin();
+size_t SearchServer::GetPostingMemoryUsage() const {
+    size_t memory_usage = 0;
+
+    for (const auto& segment: segments_) {
+        memory_usage += segment->GetMemoryUsage();
+    }
+
+    return memory_usage;
+}
+
+size_t SearchServer::GetForwardIndexMemoryUsage() const {
+    return forward_index_.GetMemoryUsage();
+}
+
+void SearchServer::SaveSnapshot(const string& path) const {
+    SnapshotWriter writer(path);
+    writer.Write(static_cast<uint64_t>(stop_words_.size()));
+
+    for (const string_view stop_word: stop_words_) {
+        writer.WriteString(stop_word);
+    }
+
+    writer.Write(query_evaluation_);
+    writer.Write(posting_format_);
+    writer.Write(relevance_mode_);
+    writer.Write(segment_policy_);
+    dictionary_.Save(writer);
+    writer.WriteArray(document_freqs_.data(), document_freqs_.size());
+    writer.WriteArray(inverse_document_freqs_.data(), inverse_document_freqs_.size());
+    writer.WriteArray(cached_document_freqs_.data(), cached_document_freqs_.size());
+    writer.Write(cached_document_count_);
+    documents_.Save(writer);
+    writer.WriteArray(removed_ordinals_.data(), removed_ordinals_.size());
+    writer.Write(generation_);
+
+    forward_index_.Save(writer);
+
+    const IndexSegment& mutable_segment = *segments_.back();
+    const auto last_ordinal = static_cast<DocumentOrdinal>(documents_.GetOrdinalCount());
+    const bool has_mutable_documents = mutable_segment.GetFirstOrdinal() < last_ordinal;
+    writer.Write(static_cast<uint64_t>(segments_.size() - 1 + has_mutable_documents));
+
+    for (size_t position = 0; position + 1 < segments_.size(); ++position) {
+        segments_[position]->Save(writer);
+    }
+
+    if (has_mutable_documents) {
+        mutable_segment.Seal(last_ordinal, documents_.GetRemovedMask()).Save(writer);
+    }
+
+    writer.Finish();
 }
 
-set<int>::const_iterator SearchServer::end() const {
-    return document_ids_.end();
+SearchServer SearchServer::LoadSnapshot(const string& path, SnapshotVerification verification) {
+    auto snapshot = make_shared<const MappedFile>(path);
+    SnapshotReader reader(snapshot->data(), snapshot->size(), verification);
+    SearchServer search_server;
+    search_server.snapshot_ = snapshot;
+
+    vector<string_view> stop_words;
+
+    for (auto stop_word_count = reader.Read<uint64_t>(); stop_word_count > 0; --stop_word_count) {
+        stop_words.push_back(reader.ReadString());
+    }
+
+    search_server.stop_words_ = StopWordFilter(stop_words);
+
+    search_server.query_evaluation_ = reader.Read<QueryEvaluation>();
+    search_server.posting_format_ = reader.Read<PostingFormat>();
+    search_server.relevance_mode_ = reader.Read<RelevanceMode>();
+    search_server.segment_policy_ = reader.Read<SegmentPolicy>();
+    search_server.dictionary_ = TermDictionary::Load(reader);
+    const size_t term_count = search_server.dictionary_.size();
+
+    const auto [document_freqs, document_freq_count] = reader.ReadArray<size_t>();
+    const auto [inverse_document_freqs, inverse_document_freq_count] = reader.ReadArray<double>();
+    const auto [cached_document_freqs, cached_document_freq_count] = reader.ReadArray<size_t>();
+    search_server.document_freqs_.assign(document_freqs, document_freqs + document_freq_count);
+    search_server.inverse_document_freqs_.assign(inverse_document_freqs,
+                                                 inverse_document_freqs + inverse_document_freq_count);
+    search_server.cached_document_freqs_.assign(cached_document_freqs,
+                                                cached_document_freqs + cached_document_freq_count);
+    search_server.cached_document_count_ = reader.Read<size_t>();
+    search_server.documents_ = DocumentTable::Load(reader);
+    const auto [removed_ordinals, removed_count] = reader.ReadArray<DocumentOrdinal>();
+    search_server.removed_ordinals_.assign(removed_ordinals, removed_ordinals + removed_count);
+    search_server.generation_ = reader.Read<uint64_t>();
+    const size_t ordinal_count = search_server.documents_.GetOrdinalCount();
+
+    if (document_freq_count != term_count || inverse_document_freq_count > term_count
+        || cached_document_freq_count > term_count
+        || any_of(removed_ordinals, removed_ordinals + removed_count, [ordinal_count](DocumentOrdinal ordinal) {
+            return ordinal >= ordinal_count;
+        })) {
+        throw runtime_error("Snapshot is inconsistent"s);
+    }
+
+    search_server.forward_index_ = ForwardIndex::Load(reader, term_count);
+
+    if (search_server.forward_index_.GetDocumentCount() != ordinal_count) {
+        throw runtime_error("Snapshot is inconsistent"s);
+    }
+
+    search_server.segments_.clear();
+
+    DocumentOrdinal segment_first_ordinal = 0;
+
+    for (auto segment_count = reader.Read<uint64_t>(); segment_count > 0; --segment_count) {
+        auto segment = make_shared<IndexSegment>(IndexSegment::Load(reader, term_count * DOCUMENT_STATUS_COUNT));
+        if (segment->GetFirstOrdinal() != segment_first_ordinal || segment->GetLastOrdinal() > ordinal_count) {
+            throw runtime_error("Snapshot is inconsistent"s);
+        }
+        segment_first_ordinal = segment->GetLastOrdinal();
+        search_server.segments_.push_back(move(segment));
+    }
+
+    if (segment_first_ordinal != ordinal_count) {
+        throw runtime_error("Snapshot is inconsistent"s);
+    }
+
+    search_server.segments_.push_back(make_shared<IndexSegment>(static_cast<DocumentOrdinal>(ordinal_count),
+                                                                search_server.posting_format_));
+
+    return search_server;
 }
 
 bool SearchServer::IsStopWord(string_view word) const {
-    return stop_words_.count(word) > 0;
+    return stop_words_.Contains(word);
 }
 
 bool SearchServer::IsValidWord(string_view word) {
     // A valid word must not contain special characters
-    return none_of(word.begin(), word.end(), [](char c) {
-        return c >= '\0' && c < ' ';
-    });
+    return !HasForbiddenChars(word);
 }
 
 vector<string_view> SearchServer::SplitIntoWordsNoStop(string_view text) const {
     vector<string_view> words;
 
-    for (string_view word: SplitIntoWordsView(text)) {
-        if (!IsValidWord(word)) {
+    for (WordTokenizer tokenizer(text); tokenizer.Next();) {
+        if (tokenizer.HasForbiddenChars()) {
             throw invalid_argument("Document contains forbidden characters."s);
         }
-        if (!IsStopWord(word)) {
-            words.push_back(word);
+        if (!IsStopWord(tokenizer.GetWord())) {
+            words.push_back(tokenizer.GetWord());
         }
     }
 
@@ -142,93 +377,392 @@ int SearchServer::ComputeAverageRating(const std::vector<int>& ratings) {
     return accumulate(ratings.begin(), ratings.end(), 0) / static_cast<int>(ratings.size());
 }
 
-SearchServer::QueryWord SearchServer::ParseQueryWord(string_view text) const {
+SearchServer::QueryWord SearchServer::ParseQueryWord(string_view text, bool has_forbidden_chars) const {
 
     if (text.empty()) {
         throw invalid_argument("Empty request."s);
     }
 
     bool is_minus = false;
+    bool is_required = false;
 
     if (text[0] == '-') {
         is_minus = true;
         text = text.substr(1);
+    } else if (text[0] == '+') {
+        is_required = true;
+        text = text.substr(1);
     }
 
     if (text.empty()) {
-        throw invalid_argument("Standalone '-' in request."s);
+        throw invalid_argument(is_minus ? "Standalone '-' in request."s : "Standalone '+' in request."s);
     }
 
-    if (text[0] == '-') {
+    if (text[0] == '-' && is_minus) {
         throw invalid_argument("'--' in request."s);
     }
 
-    if (!IsValidWord(text)) {
+    if (text[0] == '-' || text[0] == '+') {
+        throw invalid_argument("Several prefixes of a query word."s);
+    }
+
+    if (has_forbidden_chars) {
         throw invalid_argument("Forbidden characters in request."s);
     }
 
-    return QueryWord{text, is_minus, IsStopWord(text)};
+    return QueryWord{text, is_minus, is_required, IsStopWord(text)};
 }
 
-SearchServer::Query SearchServer::ParseQuery(string_view text) const {
-    Query query;
+void SearchServer::ParseBatchChunk(const vector<DocumentData>& batch, BatchChunk& chunk) const {
+    unordered_map<string_view, uint32_t> local_ids;
+    // Частоты слов текущего документа по локальному id.
+    vector<double> term_freqs;
+
+    for (size_t position = chunk.begin; position < chunk.end; ++position) {
+        auto& document_terms = chunk.document_terms.emplace_back();
+        vector<string_view> words;
+
+        try {
+            words = SplitIntoWordsNoStop(batch[position].text);
+        } catch (...) {
+            chunk.errors.emplace_back(position, current_exception());
+            continue;
+        }
 
-    for (string_view word: SplitIntoWordsView(text)) {
-        const QueryWord query_word = ParseQueryWord(word);
-        if (!query_word.is_stop) {
-            if (query_word.is_minus) {
-                query.minus_words.insert(query_word.data);
-            } else {
-                query.plus_words.insert(query_word.data);
+        // Частота копится прибавлением 1/n за каждое вхождение, как в AddDocument, - значения совпадают до бита.
+        const double inv_word_count = 1.0 / words.size();
+
+        for (const string_view word: words) {
+            const auto [it, inserted] = local_ids.emplace(word, static_cast<uint32_t>(chunk.words.size()));
+            if (inserted) {
+                chunk.words.push_back(word);
+                term_freqs.push_back(0.0);
+            }
+            if (term_freqs[it->second] == 0.0) {
+                document_terms.emplace_back(it->second, 0.0);
             }
+            term_freqs[it->second] += inv_word_count;
+        }
+
+        for (auto& [local_id, term_freq]: document_terms) {
+            term_freq = term_freqs[local_id];
+            term_freqs[local_id] = 0.0;
         }
     }
 
-    return query;
+    // Слова документов упорядочиваются по месту слова в отсортированном словаре части, а не сравнением строк.
+    vector<uint32_t> ranks(chunk.words.size());
+    iota(ranks.begin(), ranks.end(), 0);
+    sort(ranks.begin(), ranks.end(), [&chunk](uint32_t lhs, uint32_t rhs) {
+        return chunk.words[lhs] < chunk.words[rhs];
+    });
+    vector<uint32_t> word_ranks(chunk.words.size());
+    for (uint32_t rank = 0; rank < ranks.size(); ++rank) {
+        word_ranks[ranks[rank]] = rank;
+    }
+
+    chunk.postings.resize(chunk.words.size() * DOCUMENT_STATUS_COUNT);
+
+    for (size_t i = 0; i < chunk.document_terms.size(); ++i) {
+        auto& document_terms = chunk.document_terms[i];
+        sort(document_terms.begin(), document_terms.end(), [&word_ranks](const auto& lhs, const auto& rhs) {
+            return word_ranks[lhs.first] < word_ranks[rhs.first];
+        });
+        const auto status = static_cast<size_t>(batch[chunk.begin + i].status);
+        for (const auto& [local_id, term_freq]: document_terms) {
+            chunk.postings[local_id * DOCUMENT_STATUS_COUNT + status].emplace_back(chunk.begin + i, term_freq);
+        }
+    }
+}
+
+void SearchServer::CheckBatch(const vector<DocumentData>& batch, const vector<BatchChunk>& chunks) const {
+    unordered_set<int> batch_ids;
+
+    for (const BatchChunk& chunk: chunks) {
+        auto error = chunk.errors.begin();
+        for (size_t position = chunk.begin; position < chunk.end; ++position) {
+            const int document_id = batch[position].id;
+            if (document_id < 0) {
+                throw invalid_argument("Negative document ID."s);
+            } else if (documents_.Contains(document_id) || !batch_ids.insert(document_id).second) {
+                throw invalid_argument("Double addition of the document."s);
+            }
+            if (error != chunk.errors.end() && error->first == position) {
+                rethrow_exception(error->second);
+            }
+        }
+    }
+}
+
+DocumentOrdinal SearchServer::RegisterBatch(const vector<DocumentData>& batch, vector<BatchChunk>& chunks) {
+    const auto first_ordinal = static_cast<DocumentOrdinal>(documents_.GetOrdinalCount());
+
+    for (const DocumentData& document: batch) {
+        documents_.Add(document.id, ComputeAverageRating(document.ratings), document.status);
+    }
+
+    for (BatchChunk& chunk: chunks) {
+        chunk.term_ids.reserve(chunk.words.size());
+        for (const string_view word: chunk.words) {
+            chunk.term_ids.push_back(dictionary_.Intern(word));
+        }
+    }
+
+    GetMutableSegment().Reserve(dictionary_.size() * DOCUMENT_STATUS_COUNT);
+    document_freqs_.resize(dictionary_.size(), 0);
+
+    return first_ordinal;
 }
 
-SearchServer::QueryPar SearchServer::ParseQueryPar(string_view text) const {
-    QueryPar query;
+void SearchServer::FillBatchWordFreqs(const BatchChunk& chunk) {
+    vector<pair<TermId, double>> term_freqs;
 
-    for (string_view word: SplitIntoWordsView(text)) {
-        const QueryWord query_word = ParseQueryWord(word);
-        if (!query_word.is_stop) {
-            if (query_word.is_minus) {
-                query.minus_words.emplace_back(query_word.data);
-            } else {
-                query.plus_words.emplace_back(query_word.data);
+    for (const auto& document_terms: chunk.document_terms) {
+        term_freqs.clear();
+        for (const auto& [local_id, term_freq]: document_terms) {
+            term_freqs.emplace_back(chunk.term_ids[local_id], term_freq);
+        }
+        sort(term_freqs.begin(), term_freqs.end());
+        forward_index_.Add(term_freqs);
+    }
+}
+
+vector<SearchServer::BatchPostings> SearchServer::GroupBatchPostings(const vector<BatchChunk>& chunks) const {
+    vector<BatchPostings> batch_postings;
+    // Индекс постинг-листа -> позиция в batch_postings.
+    unordered_map<size_t, size_t> positions;
+
+    for (const BatchChunk& chunk: chunks) {
+        for (size_t key = 0; key < chunk.postings.size(); ++key) {
+            if (chunk.postings[key].empty()) {
+                continue;
+            }
+            const size_t index = chunk.term_ids[key / DOCUMENT_STATUS_COUNT] * DOCUMENT_STATUS_COUNT
+                                 + key % DOCUMENT_STATUS_COUNT;
+            const auto [it, inserted] = positions.emplace(index, batch_postings.size());
+            if (inserted) {
+                batch_postings.push_back({index, {}});
             }
+            batch_postings[it->second].parts.push_back(&chunk.postings[key]);
         }
     }
 
-    return query;
+    sort(batch_postings.begin(), batch_postings.end(), [](const BatchPostings& lhs, const BatchPostings& rhs) {
+        return lhs.index < rhs.index;
+    });
+
+    return batch_postings;
 }
 
-SearchServer::QueryPar SearchServer::ParseQueryParNoDuplicates(string_view text) const {
-    QueryPar query;
+SearchServer::Query SearchServer::ParseQuery(string_view text) const {
+    Query query;
 
-    for (string_view word: SplitIntoWordsView(text)) {
-        const QueryWord query_word = ParseQueryWord(word);
-        if (!query_word.is_stop) {
-            if (query_word.is_minus) {
-                query.minus_words.emplace_back(query_word.data);
-            } else {
-                query.plus_words.emplace_back(query_word.data);
+    for (WordTokenizer tokenizer(text); tokenizer.Next();) {
+        const QueryWord query_word = ParseQueryWord(tokenizer.GetWord(), tokenizer.HasForbiddenChars());
+        if (query_word.is_stop) {
+            continue;
+        }
+        const auto term = dictionary_.Find(query_word.data);
+        if (!term) {
+            query.matches_nothing = query.matches_nothing || query_word.is_required;
+            continue;
+        }
+        if (query_word.is_minus) {
+            query.minus_terms.push_back(*term);
+        } else {
+            query.plus_terms.push_back(*term);
+            if (query_word.is_required) {
+                query.required_terms.push_back(*term);
             }
         }
     }
 
-    sort(execution::par, query.plus_words.begin(), query.plus_words.end());
-    query.plus_words.erase(unique(execution::par, query.plus_words.begin(), query.plus_words.end()),
-                           query.plus_words.end());
-    sort(execution::par, query.minus_words.begin(), query.minus_words.end());
-    query.minus_words.erase(unique(execution::par, query.minus_words.begin(), query.minus_words.end()),
-                            query.minus_words.end());
+    SortUniqueTerms(query.plus_terms);
+    SortUniqueTerms(query.minus_terms);
+    SortUniqueTerms(query.required_terms);
 
     return query;
 }
 
-double SearchServer::ComputeWordInverseDocumentFreq(string_view word) const {
-    return log(GetDocumentCount() * 1.0 / word_to_document_freqs_.at(word).size());
+void SearchServer::SortUniqueTerms(QueryTerms& terms) {
+    // В запросе обычно несколько слов: std::sort на таком массиве сводится к сортировке вставками,
+    // запускать параллельные алгоритмы незачем.
+    sort(terms.begin(), terms.end());
+    terms.erase(unique(terms.begin(), terms.end()), terms.end());
+}
+
+QueryResultCache::Key SearchServer::MakeResultCacheKey(const Query& query, DocumentStatus status, size_t top_count) {
+    // Номера документов 32-битные, поэтому все top_count от 2^32 дают один результат.
+    QueryResultCache::Key key;
+    key.push_back(static_cast<uint32_t>(status));
+    key.push_back(static_cast<uint32_t>(min<size_t>(top_count, numeric_limits<uint32_t>::max())));
+
+    for (const QueryTerms* terms: {&query.plus_terms, &query.minus_terms, &query.required_terms}) {
+        key.push_back(static_cast<uint32_t>(terms->size()));
+        for (const TermId term: *terms) {
+            key.push_back(term);
+        }
+    }
+
+    return key;
+}
+
+bool SearchServer::HasTerm(DocumentOrdinal ordinal, TermId term) const {
+    const size_t index = GetPostingIndex(term, documents_.GetStatus(ordinal));
+    const IndexSegment& segment = FindSegment(ordinal);
+    const PostingList* postings = segment.FindPostings(index);
+
+    if (!postings) {
+        return false;
+    }
+
+    if (postings->size() >= MIN_BITMAP_POSTING_COUNT) {
+        return segment.GetBitmaps().Get(index, *postings)->Contains(ordinal);
+    }
+
+    return forward_index_.Get(ordinal).Find(term).has_value();
+}
+
+size_t SearchServer::GetPostingIndex(TermId term, DocumentStatus status) {
+    return term * DOCUMENT_STATUS_COUNT + static_cast<size_t>(status);
+}
+
+const IndexSegment& SearchServer::FindSegment(DocumentOrdinal ordinal) const {
+    const auto it = upper_bound(segments_.begin(), segments_.end(), ordinal,
+                                [](DocumentOrdinal ordinal, const shared_ptr<IndexSegment>& segment) {
+                                    return ordinal < segment->GetFirstOrdinal();
+                                });
+    return **prev(it);
+}
+
+IndexSegment& SearchServer::GetMutableSegment() {
+    shared_ptr<IndexSegment>& segment = segments_.back();
+
+    if (segment.use_count() > 1) {
+        segment = make_shared<IndexSegment>(*segment);
+    }
+
+    return *segment;
+}
+
+DocumentOrdinal SearchServer::GetSegmentLastOrdinal(const IndexSegment& segment) const {
+    return segment.IsSealed() ? segment.GetLastOrdinal() : static_cast<DocumentOrdinal>(documents_.GetOrdinalCount());
+}
+
+void SearchServer::MaintainSegments() {
+    using Clock = LogDuration::Clock;
+    const auto last_ordinal = static_cast<DocumentOrdinal>(documents_.GetOrdinalCount());
+    const size_t max_mutable_document_count = max<size_t>(segment_policy_.max_mutable_document_count, 1);
+
+    if (last_ordinal - segments_.back()->GetFirstOrdinal() >= max_mutable_document_count) {
+        const auto start_time = Clock::now();
+        const IndexSegment& segment = *segments_.back();
+        segments_.back() = make_shared<IndexSegment>(segment.Seal(last_ordinal, documents_.GetRemovedMask()));
+        segments_.push_back(make_shared<IndexSegment>(last_ordinal, posting_format_));
+        ++segment_stats_.seal_count;
+        segment_stats_.seal_duration += Clock::now() - start_time;
+    }
+
+    const size_t merge_factor = max<size_t>(segment_policy_.merge_factor, 2);
+
+    // Последний сегмент изменяемый, сливаются merge_factor запечатанных сегментов перед ним.
+    while (segments_.size() > merge_factor) {
+        const auto last = prev(segments_.end());
+        const auto first = last - merge_factor;
+        const size_t tier = GetSegmentTier(**first);
+        if (!all_of(first, last, [this, tier](const shared_ptr<IndexSegment>& segment) {
+            return GetSegmentTier(*segment) == tier;
+        })) {
+            break;
+        }
+        const auto start_time = Clock::now();
+        vector<const IndexSegment*> merged_segments;
+        for (auto segment = first; segment != last; ++segment) {
+            merged_segments.push_back(segment->get());
+        }
+        *first = make_shared<IndexSegment>(IndexSegment::Merge(merged_segments, documents_.GetRemovedMask()));
+        segments_.erase(next(first), last);
+        ++segment_stats_.merge_count;
+        segment_stats_.merge_duration += Clock::now() - start_time;
+    }
+}
+
+size_t SearchServer::GetSegmentTier(const IndexSegment& segment) const {
+    const size_t merge_factor = max<size_t>(segment_policy_.merge_factor, 2);
+    const size_t ordinal_count = segment.GetLastOrdinal() - segment.GetFirstOrdinal();
+    size_t tier = 0;
+
+    for (size_t tier_size = max<size_t>(segment_policy_.max_mutable_document_count, 1) * merge_factor;
+         tier_size <= ordinal_count; tier_size *= merge_factor) {
+        ++tier;
+    }
+
+    return tier;
+}
+
+void SearchServer::MarkDocumentRemoved(int document_id) {
+
+    const auto ordinal = documents_.FindOrdinal(document_id);
+
+    if (!ordinal) {
+        throw invalid_argument("Attempt to remove non-existing ID."s);
+    }
+
+    documents_.Remove(document_id);
+    removed_ordinals_.push_back(*ordinal);
+    ++generation_;
+
+    const DocumentTerms terms = forward_index_.Get(*ordinal);
+
+    for (size_t i = 0; i < terms.size; ++i) {
+        --document_freqs_[terms.terms[i]];
+        UpdateInverseDocumentFreq(terms.terms[i]);
+    }
+
+    UpdateInverseDocumentFreqs();
+}
+
+size_t SearchServer::GetDocumentFreq(TermId term) const {
+    return term < document_freqs_.size() ? document_freqs_[term] : 0;
+}
+
+double SearchServer::ComputeWordInverseDocumentFreq(TermId term) const {
+
+    if (relevance_mode_ == RelevanceMode::CACHED_IDF) {
+        return inverse_document_freqs_[term];
+    }
+
+    return log(GetDocumentCount() * 1.0 / GetDocumentFreq(term));
+}
+
+static bool IsDrifted(size_t cached, size_t actual) {
+    return abs(static_cast<double>(actual) - static_cast<double>(cached)) > IDF_REFRESH_TOLERANCE * cached;
+}
+
+void SearchServer::UpdateInverseDocumentFreq(TermId term) {
+
+    if (relevance_mode_ != RelevanceMode::CACHED_IDF) {
+        return;
+    }
+
+    if (cached_document_freqs_.size() <= term) {
+        inverse_document_freqs_.resize(term + 1, 0.0);
+        cached_document_freqs_.resize(term + 1, 0);
+    }
+
+    const size_t document_freq = GetDocumentFreq(term);
+
+    if (IsDrifted(cached_document_freqs_[term], document_freq)) {
+        cached_document_freqs_[term] = document_freq;
+        inverse_document_freqs_[term] = document_freq > 0 ? log(cached_document_count_ * 1.0 / document_freq) : 0.0;
+    }
+}
+
+void SearchServer::UpdateInverseDocumentFreqs() {
+
+    // Число документов входит в IDF каждого слова, поэтому его уход обновляет все слова сразу.
+    if (relevance_mode_ == RelevanceMode::CACHED_IDF && IsDrifted(cached_document_count_, documents_.size())) {
+        RefreshInverseDocumentFreqs();
+    }
 }
 
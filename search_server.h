@@ -12,14 +12,85 @@
 #include <execution>
 #include <type_traits>
 #include <cassert>
+#include <numeric>
+#include <thread>
+#include <exception>
+#include <utility>
+#include <chrono>
+#include <memory>
 
 #include "document.h"
 #include "string_processing.h"
 #include "log_duration.h"
-#include "concurrent_map.h"
+#include "posting_list.h"
+#include "term_dictionary.h"
+#include "document_table.h"
+#include "top_documents.h"
+#include "score_accumulator.h"
+#include "document_bitmap.h"
+#include "index_segment.h"
+#include "max_score.h"
+#include "posting_intersection.h"
+#include "index_snapshot.h"
+#include "forward_index.h"
+#include "stop_word_filter.h"
+#include "small_vector.h"
+#include "query_result_cache.h"
 
 static const int MAX_RESULT_DOCUMENT_COUNT = 5;
-static const double EPSILON = 1e-6;
+
+// Способ вычисления запроса: полный перебор постингов по словам (term-at-a-time)
+// или обход окнами документов с отсечением MaxScore. Результаты обоих способов совпадают.
+enum class QueryEvaluation {
+    EXHAUSTIVE,
+    MAX_SCORE,
+};
+
+// Точный режим вычисляет IDF слов запроса заново при каждом запросе. В режиме CACHED_IDF берётся
+// сохранённое значение, которое обновляется при изменении индекса, лишь когда число документов индекса
+// или число документов слова уходит от использованного при расчёте больше чем на IDF_REFRESH_TOLERANCE.
+enum class RelevanceMode {
+    EXACT,
+    CACHED_IDF,
+};
+
+static const double IDF_REFRESH_TOLERANCE = 0.01;
+
+// Новые документы попадают в изменяемый сегмент индекса; набрав max_mutable_document_count документов,
+// он запечатывается в неизменяемый сегмент. Как только merge_factor последних запечатанных сегментов оказываются
+// одного яруса (ярус растёт в merge_factor раз), они сливаются в один сегмент следующего яруса.
+struct SegmentPolicy {
+    size_t max_mutable_document_count = 16384;
+    size_t merge_factor = 4;
+};
+
+// Сколько раз запечатывались и сливались сегменты и сколько времени на это ушло.
+struct SegmentStats {
+    size_t segment_count = 0;
+    size_t seal_count = 0;
+    size_t merge_count = 0;
+    std::chrono::nanoseconds seal_duration{0};
+    std::chrono::nanoseconds merge_duration{0};
+};
+
+// Отбор документов по статусу. Поиск с этим предикатом обходит только постинги документов нужного статуса,
+// произвольный предикат проверяется на постингах всех статусов.
+struct StatusPredicate {
+    DocumentStatus status;
+
+    bool operator()(int /*document_id*/, DocumentStatus document_status, int /*rating*/) const {
+        return document_status == status;
+    }
+};
+
+// Документ для пакетного добавления. Текст не копируется: строка, на которую ссылается text, должна жить
+// до возврата из AddDocuments.
+struct DocumentData {
+    int id;
+    std::string_view text;
+    DocumentStatus status;
+    std::vector<int> ratings;
+};
 
 class SearchServer {
 public:
@@ -31,35 +102,62 @@ public:
 
     explicit SearchServer(std::string_view stop_words_text);
 
+    // Стоп-слова можно зашить в программу: SearchServer(StopWordFilter(STOP_WORDS)), где STOP_WORDS -
+    // constexpr-переменная, созданная MakeStaticStopWordFilter.
+    explicit SearchServer(StopWordFilter stop_words);
+
     void AddDocument(int document_id, std::string_view document, DocumentStatus status,
                      const std::vector<int>& ratings);
 
+    // Пакетное добавление: документы разбираются параллельно, каждый поток строит свой словарь и частичный
+    // обратный индекс, а затем части вливаются в индекс одним проходом по каждому постинг-листу.
+    // Проверки и исключения те же, что у AddDocument в цикле, но при ошибке пакет не добавляется целиком.
+    void AddDocuments(const std::vector<DocumentData>& batch);
+
+    template<typename ExecutionPolicy>
+    void AddDocuments(ExecutionPolicy&& policy, const std::vector<DocumentData>& batch);
+
+    // Удаление логическое: документ сразу пропадает из выдачи и из числа документов его слов, так что IDF
+    // остаются точными, а постинги лишь помечаются к удалению. Вычищает их сжатие - явное или автоматическое,
+    // когда удалённых документов накопится больше 1 / REMOVED_COMPACTION_RATIO от живых.
     void RemoveDocument(int document_id);
 
     template<class ExecutionPolicy>
     void RemoveDocument(ExecutionPolicy&& policy, int document_id);
 
+    // Физически удаляет из индекса постинги и слова удалённых документов.
+    void CompactPostings();
+
+    template<class ExecutionPolicy>
+    void CompactPostings(ExecutionPolicy&& policy);
+
+    // top_count - сколько лучших документов вернуть.
     template<typename DocumentPredicate>
     std::vector<Document>
-    FindTopDocuments(std::string_view raw_query, DocumentPredicate document_predicate) const;
+    FindTopDocuments(std::string_view raw_query, DocumentPredicate document_predicate,
+                     size_t top_count = MAX_RESULT_DOCUMENT_COUNT) const;
 
-    std::vector<Document> FindTopDocuments(std::string_view raw_query, DocumentStatus status) const;
+    std::vector<Document> FindTopDocuments(std::string_view raw_query, DocumentStatus status,
+                                           size_t top_count = MAX_RESULT_DOCUMENT_COUNT) const;
 
     std::vector<Document> FindTopDocuments(std::string_view raw_query) const;
 
     template<typename ExecutionPolicy, typename DocumentPredicate>
     std::vector<Document>
-    FindTopDocuments(ExecutionPolicy&& policy, std::string_view raw_query, DocumentPredicate document_predicate) const;
+    FindTopDocuments(ExecutionPolicy&& policy, std::string_view raw_query, DocumentPredicate document_predicate,
+                     size_t top_count = MAX_RESULT_DOCUMENT_COUNT) const;
 
     template<typename ExecutionPolicy>
     std::vector<Document>
-    FindTopDocuments(ExecutionPolicy&& policy, std::string_view raw_query, DocumentStatus status) const;
+    FindTopDocuments(ExecutionPolicy&& policy, std::string_view raw_query, DocumentStatus status,
+                     size_t top_count = MAX_RESULT_DOCUMENT_COUNT) const;
 
     template<typename ExecutionPolicy>
     std::vector<Document> FindTopDocuments(ExecutionPolicy&& policy, std::string_view raw_query) const;
 
 
-    const std::map<std::string_view, double>& GetWordFrequencies(int document_id) const;
+    // Пустое представление, если документа нет.
+    WordFrequencies GetWordFrequencies(int document_id) const;
 
     int GetDocumentCount() const;
 
@@ -70,21 +168,83 @@ public:
     std::tuple<std::vector<std::string_view>, DocumentStatus>
     MatchDocument(ExecutionPolicy&& policy, std::string_view raw_query, int document_id) const;
 
-    std::set<int>::const_iterator begin() const;
+    DocumentIdMap::Iterator begin() const;
 
-    std::set<int>::const_iterator end() const;
+    DocumentIdMap::Iterator end() const;
 
-private:
-    struct DocumentData {
-        int rating;
-        DocumentStatus status;
-    };
+    // Смена способа вычисления, режима релевантности и пересчёт IDF очищают кэш результатов.
+    void SetQueryEvaluation(QueryEvaluation query_evaluation);
+
+    // Переход в CACHED_IDF пересчитывает сохранённые IDF точно.
+    void SetRelevanceMode(RelevanceMode relevance_mode);
+
+    // Точно пересчитывает сохранённые IDF всех слов.
+    void RefreshInverseDocumentFreqs();
+
+    // Включает кэш результатов FindTopDocuments на capacity запросов, 0 выключает кэш. Кэшируются запросы
+    // с отбором по статусу; запись действительна, пока не изменилось поколение индекса. Копия сервера получает
+    // пустой кэш той же ёмкости.
+    void SetResultCacheCapacity(size_t capacity);
+
+    ResultCacheStats GetResultCacheStats() const;
+
+    // Переводит все постинг-листы, в том числе создаваемые позже, в заданный формат.
+    void SetPostingFormat(PostingFormat posting_format);
+
+    // Новая политика сразу применяется к уже накопленным сегментам.
+    void SetSegmentPolicy(const SegmentPolicy& segment_policy);
+
+    SegmentStats GetSegmentStats() const;
+
+    // Число изменений документов: растёт на единицу с каждым добавленным и удалённым документом.
+    uint64_t GetGeneration() const;
+
+    size_t GetPostingCount() const;
 
-    std::set<std::string, std::less<>> stop_words_;
-    std::map<std::string_view, std::map<int, double>> word_to_document_freqs_;
-    std::map<int, std::map<std::string, double, std::less<>>> document_to_word_freqs_;
-    std::map<int, DocumentData> documents_;
-    std::set<int> document_ids_;
+    // Память, занятая постинг-листами.
+    size_t GetPostingMemoryUsage() const;
+
+    // Память, занятая словами документов (прямым индексом).
+    size_t GetForwardIndexMemoryUsage() const;
+
+    // Записывает в снимок path стоп-слова, настройки, словарь, постинги, слова, рейтинги и статусы документов.
+    // Изменяемый сегмент сохраняется запечатанным.
+    void SaveSnapshot(const std::string& path) const;
+
+    // Сервер отвечает на запросы прямо из отображённого в память снимка: постинги и слова словаря не копируются,
+    // восстанавливаются лишь таблица документов и слова документов. Контрольная сумма сверяется только
+    // по запросу, потому что для этого нужно прочитать весь снимок.
+    static SearchServer LoadSnapshot(const std::string& path,
+                                     SnapshotVerification verification = SnapshotVerification::STRUCTURE);
+
+private:
+    StopWordFilter stop_words_;
+    // Снимок, на память которого ссылаются загруженные постинги и слова словаря.
+    std::shared_ptr<const MappedFile> snapshot_;
+    TermDictionary dictionary_;
+    // Сегменты по возрастанию номеров документов, последний - изменяемый. Постинги каждого слова разбиты
+    // по статусам документов: номер постинг-листа - id терма * DOCUMENT_STATUS_COUNT + статус.
+    // Запечатанные сегменты не меняются и делятся между копиями сервера, изменяемый копируется при изменении.
+    std::vector<std::shared_ptr<IndexSegment>> segments_ = {std::make_shared<IndexSegment>()};
+    // Индекс - id терма: число живых документов со словом во всех сегментах и статусах.
+    std::vector<size_t> document_freqs_;
+    SegmentPolicy segment_policy_;
+    SegmentStats segment_stats_;
+    // Слова документов по номеру документа.
+    ForwardIndex forward_index_;
+    DocumentTable documents_;
+    QueryEvaluation query_evaluation_ = QueryEvaluation::EXHAUSTIVE;
+    PostingFormat posting_format_ = PostingFormat::PLAIN;
+    RelevanceMode relevance_mode_ = RelevanceMode::EXACT;
+    // Для режима CACHED_IDF. Индекс - id терма; cached_document_freqs_ - число документов слова при расчёте.
+    std::vector<double> inverse_document_freqs_;
+    std::vector<size_t> cached_document_freqs_;
+    size_t cached_document_count_ = 0;
+    // Удалённые документы, чьи постинги и слова ещё не вычищены сжатием.
+    std::vector<DocumentOrdinal> removed_ordinals_;
+    uint64_t generation_ = 0;
+    // Результаты запросов по разобранному запросу, статусу и числу документов; проверяются по generation_.
+    mutable QueryResultCache result_cache_;
 
     bool IsStopWord(std::string_view word) const;
 
@@ -97,105 +257,257 @@ private:
     struct QueryWord {
         std::string_view data;
         bool is_minus;
+        bool is_required;
         bool is_stop;
     };
 
-    QueryWord ParseQueryWord(std::string_view text) const;
+    // has_forbidden_chars - есть ли в слове управляющие символы, как их нашёл WordTokenizer.
+    QueryWord ParseQueryWord(std::string_view text, bool has_forbidden_chars) const;
+
+    // Часть пакета [begin, end), разобранная одним потоком: свой словарь и частичный обратный индекс.
+    struct BatchChunk {
+        size_t begin = 0;
+        size_t end = 0;
+        std::vector<std::string_view> words; // Индекс - локальный id слова.
+        std::vector<TermId> term_ids; // Индекс - локальный id слова, заполняется при слиянии.
+        // Для каждого документа: локальные id его слов по возрастанию слова и частоты.
+        std::vector<std::vector<std::pair<uint32_t, double>>> document_terms;
+        // Индекс - локальный id * DOCUMENT_STATUS_COUNT + статус: номера документов в пакете и частоты.
+        std::vector<std::vector<std::pair<size_t, double>>> postings;
+        // Номер документа в пакете и исключение, брошенное при его разборе.
+        std::vector<std::pair<size_t, std::exception_ptr>> errors;
+    };
 
-    struct Query {
-        std::set<std::string_view> plus_words;
-        std::set<std::string_view> minus_words;
+    // Постинги пакета для одного постинг-листа индекса: части разных потоков в порядке документов.
+    struct BatchPostings {
+        size_t index;
+        std::vector<const std::vector<std::pair<size_t, double>>*> parts;
     };
 
-    struct QueryPar {
-        std::vector<std::string_view> plus_words;
-        std::vector<std::string_view> minus_words;
+    void ParseBatchChunk(const std::vector<DocumentData>& batch, BatchChunk& chunk) const;
+
+    // Бросает то же исключение, что первый ошибочный документ пакета при добавлении по одному.
+    void CheckBatch(const std::vector<DocumentData>& batch, const std::vector<BatchChunk>& chunks) const;
+
+    // Регистрирует документы пакета и слова потоков; возвращает номер первого документа пакета.
+    DocumentOrdinal RegisterBatch(const std::vector<DocumentData>& batch, std::vector<BatchChunk>& chunks);
+
+    // Дописывает слова документов части в прямой индекс, упорядочив их по id терма.
+    void FillBatchWordFreqs(const BatchChunk& chunk);
+
+    // Постинг-листы индекса, получающие постинги пакета, по возрастанию индекса.
+    std::vector<BatchPostings> GroupBatchPostings(const std::vector<BatchChunk>& chunks) const;
+
+    // Слова запроса, отсутствующие в словаре, ни с одним документом не совпадают и отбрасываются при разборе.
+    // Обязательные слова (+word) входят и в плюс-слова; отсутствующее в словаре обязательное слово
+    // делает запрос заведомо пустым.
+    static const size_t INLINE_QUERY_TERM_COUNT = 16;
+
+    using QueryTerms = SmallVector<TermId, INLINE_QUERY_TERM_COUNT>;
+
+    // Термы запроса по возрастанию id, без повторов. Термы типичного запроса умещаются во встроенные буферы,
+    // и разбор не обращается к куче. Последовательный и параллельный поиск разбирают запрос одинаково.
+    struct Query {
+        QueryTerms plus_terms;
+        QueryTerms minus_terms;
+        QueryTerms required_terms;
+        bool matches_nothing = false;
     };
 
     Query ParseQuery(std::string_view text) const;
 
-    QueryPar ParseQueryPar(std::string_view text) const;
+    static void SortUniqueTerms(QueryTerms& terms);
 
-    QueryPar ParseQueryParNoDuplicates(std::string_view text) const;
+    static QueryResultCache::Key MakeResultCacheKey(const Query& query, DocumentStatus status, size_t top_count);
 
-    double ComputeWordInverseDocumentFreq(std::string_view word) const;
+    // Результат запроса с отбором по статусу берётся из кэша или вычисляется search и попадает в кэш.
+    // Произвольный предикат не выразить ключом, такие запросы всегда вычисляются.
+    template<typename DocumentPredicate, typename Search>
+    std::vector<Document> FindCachedTopDocuments(const Query& query, const DocumentPredicate& document_predicate,
+                                                 size_t top_count, Search search) const;
 
-    template<typename DocumentPredicate>
-    std::vector<Document> FindAllDocuments(const Query& query, DocumentPredicate document_predicate) const;
+    static size_t GetPostingIndex(TermId term, DocumentStatus status);
+
+    // Сегмент, в котором лежат постинги документа.
+    const IndexSegment& FindSegment(DocumentOrdinal ordinal) const;
+
+    // Изменяемый сегмент, отделённый от копий сервера.
+    IndexSegment& GetMutableSegment();
+
+    DocumentOrdinal GetSegmentLastOrdinal(const IndexSegment& segment) const;
+
+    // Запечатывает заполненный изменяемый сегмент и сливает запечатанные сегменты по политике.
+    void MaintainSegments();
+
+    size_t GetSegmentTier(const IndexSegment& segment) const;
+
+    // Удаляет документ из таблицы документов и из числа документов его слов; постинги остаются до сжатия.
+    void MarkDocumentRemoved(int document_id);
+
+    // Число документов со словом во всех статусах.
+    size_t GetDocumentFreq(TermId term) const;
+
+    double ComputeWordInverseDocumentFreq(TermId term) const;
+
+    // В режиме CACHED_IDF обновляют сохранённые IDF после изменения индекса, если расхождение превысило допуск:
+    // первая - IDF слова с изменившимися постингами, вторая - все IDF при уходе числа документов.
+    void UpdateInverseDocumentFreq(TermId term);
+
+    void UpdateInverseDocumentFreqs();
+
+    template<typename Terms>
+    std::vector<WeightedPostings> GetWeightedPostings(const Terms& plus_terms, DocumentStatus status,
+                                                      const IndexSegment& segment) const;
+
+    // Отсутствующий в сегменте лист даёт nullptr.
+    template<typename Terms>
+    std::vector<const PostingList*> GetPostings(const Terms& terms, DocumentStatus status,
+                                                const IndexSegment& segment) const;
+
+    // Частое минус-слово исключает документы битовой картой из кэша, редкое - обходом своего постинг-листа.
+    struct ExcludedTerm {
+        const PostingList* postings;
+        std::shared_ptr<const DocumentBitmap> bitmap;
+    };
+
+    template<typename Terms>
+    std::vector<ExcludedTerm> GetExcludedTerms(const Terms& minus_terms, DocumentStatus status,
+                                               const IndexSegment& segment) const;
+
+    // Постинги запроса в разделе документов одного статуса. Каждый документ лежит ровно в одном разделе,
+    // поэтому разделы оцениваются независимо, а их документы попадают в общий топ.
+    struct StatusPostings {
+        std::vector<WeightedPostings> plus_postings;
+        std::vector<ExcludedTerm> excluded_terms;
+        std::vector<const PostingList*> required_postings;
+    };
 
+    // Постинги запроса в сегменте с документами из [first_ordinal, last_ordinal).
+    struct SegmentPostings {
+        DocumentOrdinal first_ordinal;
+        DocumentOrdinal last_ordinal;
+        std::vector<StatusPostings> status_postings;
+    };
+
+    // Для StatusPredicate - раздел его статуса, для остальных предикатов - все разделы.
+    // Разделы и сегменты, в которых запрос заведомо ничего не найдёт, пропускаются.
+    // IDF слов общие для всех сегментов, поэтому релевантности не зависят от разбиения индекса на сегменты.
+    template<typename QueryType, typename DocumentPredicate>
+    std::vector<SegmentPostings> GetSegmentPostings(const QueryType& query,
+                                                    const DocumentPredicate& document_predicate) const;
+
+    // Есть ли слово в документе: частые слова проверяются по битовой карте, остальные - по словам документа.
+    bool HasTerm(DocumentOrdinal ordinal, TermId term) const;
+
+    // Пространство номеров документов делится на диапазоны, и каждый поток целиком обрабатывает свой диапазон:
+    // исключает документы с минус-словами, считает релевантность по всем плюс-словам и отбирает локальный топ.
+    // Поэтому параллелизм ограничен числом ядер, а не числом слов запроса.
     template<typename ExecutionPolicy, typename DocumentPredicate>
     std::vector<Document>
-    FindAllDocuments(ExecutionPolicy&& policy, const QueryPar& query, DocumentPredicate document_predicate) const;
+    FindTopDocumentsInRanges(ExecutionPolicy&& policy, const std::vector<SegmentPostings>& segment_postings,
+                             DocumentPredicate document_predicate, size_t top_count) const;
+
+    // Диапазон [first, last) обходится по частям, лежащим в разных сегментах.
+    template<typename DocumentPredicate>
+    void FindTopDocumentsInRange(const std::vector<SegmentPostings>& segment_postings,
+                                 DocumentPredicate& document_predicate, DocumentOrdinal first, DocumentOrdinal last,
+                                 TopDocuments& top_documents) const;
+
+    // Минус-слова исключают документы до подсчёта, поэтому исключённые документы не оцениваются вовсе.
+    template<typename DocumentPredicate>
+    void FindSegmentDocuments(const std::vector<StatusPostings>& status_postings,
+                              DocumentPredicate& document_predicate, DocumentOrdinal first, DocumentOrdinal last,
+                              TopDocuments& top_documents) const;
+
+    // Конъюнктивный режим: оцениваются только документы из пересечения списков обязательных слов,
+    // релевантность по-прежнему складывается по всем плюс-словам.
+    template<typename DocumentPredicate>
+    void FindRequiredDocuments(const std::vector<WeightedPostings>& plus_postings,
+                               const std::vector<const PostingList*>& required_postings,
+                               DocumentPredicate& document_predicate, DocumentOrdinal first, DocumentOrdinal last,
+                               const ScoreAccumulator& accumulator, TopDocuments& top_documents) const;
+
+    // Полный перебор: релевантность всех документов диапазона копится в аккумуляторе (индекс - ordinal - first).
+    template<typename DocumentPredicate>
+    void FindAllDocuments(const std::vector<WeightedPostings>& plus_postings, DocumentPredicate& document_predicate,
+                          DocumentOrdinal first, DocumentOrdinal last, ScoreAccumulator& accumulator) const;
+
+    static const size_t SCORING_PARTITIONS_PER_THREAD = 4;
+    static const size_t MIN_BATCH_CHUNK_SIZE = 1024;
+    static const size_t MIN_SCORING_PARTITION_SIZE = 1024;
+    // Минус-слово с таким числом документов исключает их по битовой карте.
+    static const size_t MIN_BITMAP_POSTING_COUNT = 4096;
+    static const size_t REMOVED_COMPACTION_RATIO = 4;
 };
 
 template<typename StringContainer, typename>
 SearchServer::SearchServer(const StringContainer& stop_words)
-        : stop_words_(MakeUniqueNonEmptyStrings(stop_words)) {
-
-    if (!std::all_of(stop_words_.begin(), stop_words_.end(), [](const auto& word) {
-        return IsValidWord(word);
-    })) {
-        using namespace std::literals::string_literals;
-        throw std::invalid_argument("Forbidden characters in stop-words."s);
-    }
+        : SearchServer(StopWordFilter(stop_words)) {
 }
 
 template<typename DocumentPredicate>
 std::vector<Document>
-SearchServer::FindTopDocuments(std::string_view raw_query, DocumentPredicate document_predicate) const {
+SearchServer::FindTopDocuments(std::string_view raw_query, DocumentPredicate document_predicate,
+                               size_t top_count) const {
     const Query query = ParseQuery(raw_query);
-    auto matched_documents = FindAllDocuments(query, document_predicate);
 
-    sort(matched_documents.begin(), matched_documents.end(), [](const Document& lhs, const Document& rhs) {
-        if (std::abs(lhs.relevance - rhs.relevance) < EPSILON) {
-            return lhs.rating > rhs.rating;
-        } else {
-            return lhs.relevance > rhs.relevance;
-        }
-    });
-
-    if (matched_documents.size() > MAX_RESULT_DOCUMENT_COUNT) {
-        matched_documents.resize(MAX_RESULT_DOCUMENT_COUNT);
+    if (query.matches_nothing) {
+        return {};
     }
 
-    return matched_documents;
+    return FindCachedTopDocuments(query, document_predicate, top_count, [&] {
+        TopDocuments top_documents(top_count);
+        FindTopDocumentsInRange(GetSegmentPostings(query, document_predicate), document_predicate, 0,
+                                static_cast<DocumentOrdinal>(documents_.GetOrdinalCount()), top_documents);
+        return top_documents.Extract();
+    });
 }
 
 template<typename ExecutionPolicy, typename DocumentPredicate>
 std::vector<Document>
 SearchServer::FindTopDocuments(ExecutionPolicy&& policy, std::string_view raw_query,
-                               DocumentPredicate document_predicate) const {
+                               DocumentPredicate document_predicate, size_t top_count) const {
 
     if constexpr(std::is_same_v<std::decay_t<ExecutionPolicy>, std::execution::sequenced_policy>) {
-        return FindTopDocuments(raw_query, document_predicate);
+        return FindTopDocuments(raw_query, document_predicate, top_count);
     }
 
-    const QueryPar query = ParseQueryParNoDuplicates(raw_query);
-    auto matched_documents = FindAllDocuments(std::forward<ExecutionPolicy>(policy), query, document_predicate);
+    const Query query = ParseQuery(raw_query);
+
+    if (query.matches_nothing) {
+        return {};
+    }
 
-    sort(std::forward<ExecutionPolicy>(policy), matched_documents.begin(), matched_documents.end(),
-         [](const Document& lhs, const Document& rhs) {
-             if (std::abs(lhs.relevance - rhs.relevance) < EPSILON) {
-                 return lhs.rating > rhs.rating;
-             } else {
-                 return lhs.relevance > rhs.relevance;
-             }
-         });
+    return FindCachedTopDocuments(query, document_predicate, top_count, [&] {
+        return FindTopDocumentsInRanges(std::forward<ExecutionPolicy>(policy),
+                                        GetSegmentPostings(query, document_predicate), document_predicate, top_count);
+    });
+}
 
-    if (matched_documents.size() > MAX_RESULT_DOCUMENT_COUNT) {
-        matched_documents.resize(MAX_RESULT_DOCUMENT_COUNT);
+template<typename DocumentPredicate, typename Search>
+std::vector<Document>
+SearchServer::FindCachedTopDocuments(const Query& query, const DocumentPredicate& document_predicate,
+                                     size_t top_count, Search search) const {
+    if constexpr(std::is_same_v<DocumentPredicate, StatusPredicate>) {
+        if (result_cache_.IsEnabled()) {
+            const QueryResultCache::Key key = MakeResultCacheKey(query, document_predicate.status, top_count);
+            if (auto documents = result_cache_.Find(key, generation_)) {
+                return std::move(*documents);
+            }
+            std::vector<Document> documents = search();
+            result_cache_.Insert(key, generation_, documents);
+            return documents;
+        }
     }
 
-    return matched_documents;
+    return search();
 }
 
 template<typename ExecutionPolicy>
 std::vector<Document>
-SearchServer::FindTopDocuments(ExecutionPolicy&& policy, std::string_view raw_query, DocumentStatus status) const {
-    return FindTopDocuments(std::forward<ExecutionPolicy>(policy), raw_query,
-                            [status](int document_id, DocumentStatus document_status, int rating) {
-                                return document_status == status;
-                            });
+SearchServer::FindTopDocuments(ExecutionPolicy&& policy, std::string_view raw_query, DocumentStatus status,
+                               size_t top_count) const {
+    return FindTopDocuments(std::forward<ExecutionPolicy>(policy), raw_query, StatusPredicate{status}, top_count);
 }
 
 template<typename ExecutionPolicy>
@@ -203,29 +515,96 @@ std::vector<Document> SearchServer::FindTopDocuments(ExecutionPolicy&& policy, s
     return FindTopDocuments(std::forward<ExecutionPolicy>(policy), raw_query, DocumentStatus::ACTUAL);
 }
 
+template<typename ExecutionPolicy>
+void SearchServer::AddDocuments(ExecutionPolicy&& policy, const std::vector<DocumentData>& batch) {
+    const size_t chunk_count = std::clamp<size_t>(std::thread::hardware_concurrency() * SCORING_PARTITIONS_PER_THREAD,
+                                                  1, std::max<size_t>(batch.size() / MIN_BATCH_CHUNK_SIZE, 1));
+    std::vector<BatchChunk> chunks(chunk_count);
+
+    for (size_t i = 0; i < chunk_count; ++i) {
+        chunks[i].begin = batch.size() * i / chunk_count;
+        chunks[i].end = batch.size() * (i + 1) / chunk_count;
+    }
+
+    std::for_each(policy, chunks.begin(), chunks.end(), [this, &batch](BatchChunk& chunk) {
+        ParseBatchChunk(batch, chunk);
+    });
+
+    CheckBatch(batch, chunks);
+    const DocumentOrdinal first_ordinal = RegisterBatch(batch, chunks);
+
+    // Прямой индекс пополняется по порядку номеров документов.
+    for (const BatchChunk& chunk: chunks) {
+        FillBatchWordFreqs(chunk);
+    }
+
+    const std::vector<BatchPostings> batch_postings = GroupBatchPostings(chunks);
+
+    IndexSegment& segment = GetMutableSegment();
+
+    std::for_each(policy, batch_postings.begin(), batch_postings.end(),
+                  [&segment, first_ordinal](const BatchPostings& postings) {
+                      PostingList& posting_list = segment.GetPostings(postings.index);
+                      for (const auto* part: postings.parts) {
+                          for (const auto& [position, term_freq]: *part) {
+                              posting_list.Add(first_ordinal + static_cast<DocumentOrdinal>(position), term_freq);
+                          }
+                      }
+                      posting_list.Merge();
+                  });
+
+    // Постинг-листы идут по возрастанию индекса, поэтому листы одного слова стоят подряд.
+    for (size_t i = 0; i < batch_postings.size(); ++i) {
+        const size_t index = batch_postings[i].index;
+        segment.GetBitmaps().Invalidate(index);
+        for (const auto* part: batch_postings[i].parts) {
+            document_freqs_[index / DOCUMENT_STATUS_COUNT] += part->size();
+        }
+        if (i + 1 == batch_postings.size()
+            || batch_postings[i + 1].index / DOCUMENT_STATUS_COUNT != index / DOCUMENT_STATUS_COUNT) {
+            UpdateInverseDocumentFreq(static_cast<TermId>(index / DOCUMENT_STATUS_COUNT));
+        }
+    }
+
+    generation_ += batch.size();
+    UpdateInverseDocumentFreqs();
+    MaintainSegments();
+}
+
 template<class ExecutionPolicy>
 void SearchServer::RemoveDocument(ExecutionPolicy&& policy, int document_id) {
+    MarkDocumentRemoved(document_id);
 
-    if (!document_ids_.count(document_id)) {
-        using namespace std::literals::string_literals;
-        throw std::invalid_argument("Attempt to remove non-existing ID."s);
+    if (removed_ordinals_.size() * REMOVED_COMPACTION_RATIO > documents_.size()) {
+        CompactPostings(std::forward<ExecutionPolicy>(policy));
     }
+}
 
-    std::vector<std::string> words_to_process;
-    words_to_process.reserve(document_to_word_freqs_.at(document_id).size());
-
-    for (const auto& [word, freq]: document_to_word_freqs_.at(document_id)) {
-        words_to_process.emplace_back(word);
+template<class ExecutionPolicy>
+void SearchServer::CompactPostings(ExecutionPolicy&& policy) {
+    std::sort(removed_ordinals_.begin(), removed_ordinals_.end());
+    std::vector<size_t> positions;
+
+    for (size_t position = 0; position + 1 < segments_.size(); ++position) {
+        const auto removed = std::lower_bound(removed_ordinals_.begin(), removed_ordinals_.end(),
+                                              segments_[position]->GetFirstOrdinal());
+        if (removed != removed_ordinals_.end() && *removed < segments_[position]->GetLastOrdinal()) {
+            positions.push_back(position);
+        }
     }
 
-    std::for_each(std::forward<ExecutionPolicy>(policy), words_to_process.begin(),
-                  words_to_process.end(), [this, document_id](auto& word) {
-                word_to_document_freqs_.at(word).erase(document_id);
-            });
+    // Запечатанные сегменты не меняются на месте: вместо них встают пересобранные копии.
+    std::for_each(policy, positions.begin(), positions.end(), [this](size_t position) {
+        segments_[position] = std::make_shared<IndexSegment>(
+                IndexSegment::Merge({segments_[position].get()}, documents_.GetRemovedMask()));
+    });
+
+    if (!removed_ordinals_.empty() && removed_ordinals_.back() >= segments_.back()->GetFirstOrdinal()) {
+        GetMutableSegment().EraseRemoved(policy, documents_.GetRemovedMask());
+    }
 
-    document_to_word_freqs_.erase(document_id);
-    documents_.erase(document_id);
-    document_ids_.erase(document_id);
+    forward_index_.Erase(removed_ordinals_);
+    removed_ordinals_.clear();
 }
 
 template<class ExecutionPolicy>
@@ -238,114 +617,281 @@ SearchServer::MatchDocument(ExecutionPolicy&& policy, std::string_view raw_query
         return MatchDocument(raw_query, document_id);
     }
 
-    if (!document_ids_.count(document_id)) {
+    const auto ordinal = documents_.FindOrdinal(document_id);
+
+    if (!ordinal) {
         using namespace std::literals::string_literals;
         throw std::out_of_range("Document ID is out of range."s);
     }
 
-    const QueryPar query = ParseQueryPar(raw_query);
-    std::vector<std::string_view> matched_words(query.plus_words.size());
-
-    if (std::any_of(std::forward<ExecutionPolicy>(policy), query.minus_words.begin(), query.minus_words.end(),
-                    [this, document_id](std::string_view word) {
-                        return document_to_word_freqs_.at(document_id).count(word);
-                    })) {
+    const Query query = ParseQuery(raw_query);
+    const DocumentTerms terms = forward_index_.Get(*ordinal);
+    std::vector<std::string_view> matched_words(query.plus_terms.size());
+
+    if (query.matches_nothing
+        || std::any_of(std::forward<ExecutionPolicy>(policy), query.minus_terms.begin(), query.minus_terms.end(),
+                       [this, ordinal = *ordinal](TermId term) {
+                           return HasTerm(ordinal, term);
+                       })
+        || !std::all_of(std::forward<ExecutionPolicy>(policy), query.required_terms.begin(),
+                        query.required_terms.end(), [&terms](TermId term) {
+                    return terms.Find(term).has_value();
+                })) {
         matched_words.clear();
-        return std::tuple{matched_words, documents_.at(document_id).status};
+        return std::tuple{matched_words, documents_.GetStatus(*ordinal)};
     }
 
-    auto it = std::copy_if(std::forward<ExecutionPolicy>(policy), query.plus_words.begin(), query.plus_words.end(),
-                           matched_words.begin(),
-                           [this, document_id](std::string_view word) {
-                               return document_to_word_freqs_.at(document_id).count(word);
-                           });
+    // Слова словаря непусты, поэтому пустая строка помечает слово, которого нет в документе.
+    std::transform(std::forward<ExecutionPolicy>(policy), query.plus_terms.begin(), query.plus_terms.end(),
+                   matched_words.begin(), [this, &terms](TermId term) {
+                return terms.Find(term) ? dictionary_.GetTerm(term) : std::string_view();
+            });
+    auto it = std::remove_if(std::forward<ExecutionPolicy>(policy), matched_words.begin(), matched_words.end(),
+                             [](std::string_view word) {
+                                 return word.empty();
+                             });
     matched_words.erase(it, matched_words.end());
     std::sort(std::forward<ExecutionPolicy>(policy), matched_words.begin(), matched_words.end());
-    matched_words.erase(std::unique(std::forward<ExecutionPolicy>(policy), matched_words.begin(), matched_words.end()),
-                        matched_words.end());
 
-    return std::tuple{matched_words, documents_.at(document_id).status};
+    return std::tuple{matched_words, documents_.GetStatus(*ordinal)};
 }
 
-template<typename DocumentPredicate>
-std::vector<Document>
-SearchServer::FindAllDocuments(const Query& query, DocumentPredicate document_predicate) const {
-    std::map<int, double> document_to_relevance;
-
-    for (std::string_view word: query.plus_words) {
-        if (!word_to_document_freqs_.count(word)) {
-            continue;
-        }
-        const double inverse_document_freq = ComputeWordInverseDocumentFreq(word);
-        for (const auto [document_id, term_freq]: word_to_document_freqs_.at(word)) {
-            const auto& document_data = documents_.at(document_id);
-            if (document_predicate(document_id, document_data.status, document_data.rating)) {
-                document_to_relevance[document_id] += term_freq * inverse_document_freq;
-            }
+template<typename Terms>
+std::vector<WeightedPostings>
+SearchServer::GetWeightedPostings(const Terms& plus_terms, DocumentStatus status,
+                                  const IndexSegment& segment) const {
+    std::vector<WeightedPostings> plus_postings;
+    plus_postings.reserve(plus_terms.size());
+
+    // Слово без постингов в разделе ничего не добавляет к его релевантностям. IDF считается по всему индексу.
+    for (const TermId term: plus_terms) {
+        const PostingList* postings = segment.FindPostings(GetPostingIndex(term, status));
+        if (postings && !postings->empty() && GetDocumentFreq(term) > 0) {
+            plus_postings.push_back({postings, ComputeWordInverseDocumentFreq(term)});
         }
     }
 
-    for (std::string_view word: query.minus_words) {
-        if (word_to_document_freqs_.count(word) == 0) {
+    return plus_postings;
+}
+
+template<typename Terms>
+std::vector<const PostingList*>
+SearchServer::GetPostings(const Terms& terms, DocumentStatus status, const IndexSegment& segment) const {
+    std::vector<const PostingList*> postings;
+    postings.reserve(terms.size());
+
+    for (const TermId term: terms) {
+        postings.push_back(segment.FindPostings(GetPostingIndex(term, status)));
+    }
+
+    return postings;
+}
+
+template<typename Terms>
+std::vector<SearchServer::ExcludedTerm>
+SearchServer::GetExcludedTerms(const Terms& minus_terms, DocumentStatus status,
+                               const IndexSegment& segment) const {
+    std::vector<ExcludedTerm> excluded_terms;
+    excluded_terms.reserve(minus_terms.size());
+
+    for (const TermId term: minus_terms) {
+        const size_t index = GetPostingIndex(term, status);
+        const PostingList* postings = segment.FindPostings(index);
+        if (!postings) {
             continue;
         }
-        for (const auto [document_id, _]: word_to_document_freqs_.at(word)) {
-            document_to_relevance.erase(document_id);
+        if (postings->size() >= MIN_BITMAP_POSTING_COUNT) {
+            excluded_terms.push_back({postings, segment.GetBitmaps().Get(index, *postings)});
+        } else if (!postings->empty()) {
+            excluded_terms.push_back({postings, nullptr});
         }
     }
 
-    std::vector<Document> matched_documents;
+    return excluded_terms;
+}
 
-    for (const auto [document_id, relevance]: document_to_relevance) {
-        matched_documents.push_back({document_id, relevance, documents_.at(document_id).rating});
+template<typename QueryType, typename DocumentPredicate>
+std::vector<SearchServer::SegmentPostings>
+SearchServer::GetSegmentPostings(const QueryType& query, const DocumentPredicate& document_predicate) const {
+    SmallVector<DocumentStatus, DOCUMENT_STATUS_COUNT> statuses;
+
+    if constexpr(std::is_same_v<DocumentPredicate, StatusPredicate>) {
+        statuses.push_back(document_predicate.status);
+    } else {
+        for (const DocumentStatus status: {DocumentStatus::ACTUAL, DocumentStatus::IRRELEVANT,
+                                           DocumentStatus::BANNED, DocumentStatus::REMOVED}) {
+            statuses.push_back(status);
+        }
     }
 
-    return matched_documents;
+    std::vector<SegmentPostings> segment_postings;
+    segment_postings.reserve(segments_.size());
+
+    for (const auto& segment_ptr: segments_) {
+        const IndexSegment& segment = *segment_ptr;
+        std::vector<StatusPostings> status_postings;
+        for (const DocumentStatus status: statuses) {
+            StatusPostings postings{GetWeightedPostings(query.plus_terms, status, segment),
+                                    GetExcludedTerms(query.minus_terms, status, segment),
+                                    GetPostings(query.required_terms, status, segment)};
+            if (postings.plus_postings.empty()
+                || std::any_of(postings.required_postings.begin(), postings.required_postings.end(),
+                               [](const PostingList* required) {
+                                   return !required || required->empty();
+                               })) {
+                continue;
+            }
+            status_postings.push_back(std::move(postings));
+        }
+        if (!status_postings.empty()) {
+            segment_postings.push_back({segment.GetFirstOrdinal(), GetSegmentLastOrdinal(segment),
+                                        std::move(status_postings)});
+        }
+    }
+
+    return segment_postings;
 }
 
 template<typename ExecutionPolicy, typename DocumentPredicate>
 std::vector<Document>
-SearchServer::FindAllDocuments(ExecutionPolicy&& policy, const QueryPar& query,
-                               DocumentPredicate document_predicate) const {
-    ConcurrentMap<int, double> document_to_relevance_par(7000);
-
-    const auto func_plus = [this, &query, &document_predicate, &document_to_relevance_par](
-            std::string_view word) {
-        if (!word_to_document_freqs_.count(word)) {
-            return;
+SearchServer::FindTopDocumentsInRanges(ExecutionPolicy&& policy, const std::vector<SegmentPostings>& segment_postings,
+                                       DocumentPredicate document_predicate, size_t top_count) const {
+    const size_t ordinal_count = documents_.GetOrdinalCount();
+    const size_t max_partition_count = std::max<size_t>(ordinal_count / MIN_SCORING_PARTITION_SIZE, 1);
+    const size_t partition_count = std::clamp<size_t>(
+            std::thread::hardware_concurrency() * SCORING_PARTITIONS_PER_THREAD, 1, max_partition_count);
+    std::vector<TopDocuments> partition_tops(partition_count, TopDocuments(top_count));
+    std::vector<size_t> partitions(partition_count);
+    std::iota(partitions.begin(), partitions.end(), 0);
+
+    std::for_each(std::forward<ExecutionPolicy>(policy), partitions.begin(), partitions.end(),
+                  [this, &segment_postings, &document_predicate, &partition_tops, ordinal_count,
+                          partition_count](size_t partition) {
+                      const auto first = static_cast<DocumentOrdinal>(ordinal_count * partition / partition_count);
+                      const auto last = static_cast<DocumentOrdinal>(ordinal_count * (partition + 1) / partition_count);
+                      FindTopDocumentsInRange(segment_postings, document_predicate, first, last,
+                                              partition_tops[partition]);
+                  });
+
+    TopDocuments top_documents(top_count);
+
+    for (const TopDocuments& partition_top: partition_tops) {
+        top_documents.Merge(partition_top);
+    }
+
+    return top_documents.Extract();
+}
+
+template<typename DocumentPredicate>
+void SearchServer::FindTopDocumentsInRange(const std::vector<SegmentPostings>& segment_postings,
+                                           DocumentPredicate& document_predicate, DocumentOrdinal first,
+                                           DocumentOrdinal last, TopDocuments& top_documents) const {
+
+    for (const auto& [first_ordinal, last_ordinal, status_postings]: segment_postings) {
+        const DocumentOrdinal segment_first = std::max(first, first_ordinal);
+        const DocumentOrdinal segment_last = std::min(last, last_ordinal);
+        if (segment_first < segment_last) {
+            FindSegmentDocuments(status_postings, document_predicate, segment_first, segment_last, top_documents);
+        }
+    }
+}
+
+template<typename DocumentPredicate>
+void SearchServer::FindSegmentDocuments(const std::vector<StatusPostings>& status_postings,
+                                        DocumentPredicate& document_predicate, DocumentOrdinal first,
+                                        DocumentOrdinal last, TopDocuments& top_documents) const {
+    PooledScoreAccumulator accumulator;
+
+    for (const auto& [plus_postings, excluded_terms, required_postings]: status_postings) {
+        accumulator->Reset(last - first);
+
+        if (!removed_ordinals_.empty()) {
+            accumulator->Exclude(documents_.GetRemovedMask(), first, last);
         }
-        const double inverse_document_freq = ComputeWordInverseDocumentFreq(word);
-        const auto f = [this, &document_predicate, &document_to_relevance_par, inverse_document_freq](
-                const auto& id_to_tf) {
-            const auto [document_id, term_freq] = id_to_tf;
-            const auto& document_data = documents_.at(document_id);
-            if (document_predicate(document_id, document_data.status, document_data.rating)) {
-                document_to_relevance_par[document_id].ref_to_value += term_freq * inverse_document_freq;
-            }
-        };
-        std::for_each(word_to_document_freqs_.at(word).begin(), word_to_document_freqs_.at(word).end(), f);
-    };
 
-    std::for_each(std::forward<ExecutionPolicy>(policy), query.plus_words.begin(), query.plus_words.end(), func_plus);
+        for (const auto& [postings, bitmap]: excluded_terms) {
+            if (bitmap) {
+                accumulator->Exclude(*bitmap, first, last);
+                continue;
+            }
+            for (PostingCursor cursor(*postings, first, last); !cursor.IsEnd(); cursor.Next()) {
+                accumulator->Exclude(cursor.GetOrdinal() - first);
+            }
+        }
 
-    const auto func_minus = [this, &document_to_relevance_par](std::string_view word) {
-        if (!word_to_document_freqs_.count(word)) {
-            return;
+        if (!required_postings.empty()) {
+            FindRequiredDocuments(plus_postings, required_postings, document_predicate, first, last, *accumulator,
+                                  top_documents);
+            continue;
         }
-        for (const auto [document_id, _]: word_to_document_freqs_.at(word)) {
-            document_to_relevance_par.Erase(document_id);
+
+        if (query_evaluation_ == QueryEvaluation::MAX_SCORE) {
+            FindTopDocumentsMaxScore(
+                    plus_postings, first, last,
+                    [this, &document_predicate](DocumentOrdinal ordinal) {
+                        return document_predicate(documents_.GetId(ordinal), documents_.GetStatus(ordinal),
+                                                  documents_.GetRating(ordinal));
+                    },
+                    [this](DocumentOrdinal ordinal, double relevance) {
+                        return Document{documents_.GetId(ordinal), relevance, documents_.GetRating(ordinal)};
+                    },
+                    *accumulator, top_documents);
+            continue;
         }
-    };
 
-    std::for_each(std::forward<ExecutionPolicy>(policy), query.minus_words.begin(), query.minus_words.end(),
-                  func_minus);
+        FindAllDocuments(plus_postings, document_predicate, first, last, *accumulator);
+
+        for (const DocumentOrdinal local_ordinal: accumulator->GetTouched()) {
+            const DocumentOrdinal ordinal = first + local_ordinal;
+            top_documents.Push({documents_.GetId(ordinal), accumulator->GetScore(local_ordinal),
+                                documents_.GetRating(ordinal)});
+        }
+    }
+}
 
-    std::map<int, double> document_to_relevance = document_to_relevance_par.BuildOrdinaryMap();
-    std::vector<Document> matched_documents;
+template<typename DocumentPredicate>
+void SearchServer::FindRequiredDocuments(const std::vector<WeightedPostings>& plus_postings,
+                                         const std::vector<const PostingList*>& required_postings,
+                                         DocumentPredicate& document_predicate, DocumentOrdinal first,
+                                         DocumentOrdinal last, const ScoreAccumulator& accumulator,
+                                         TopDocuments& top_documents) const {
+    std::vector<PostingCursor> cursors;
+    cursors.reserve(plus_postings.size());
+
+    for (const WeightedPostings& weighted_postings: plus_postings) {
+        cursors.emplace_back(*weighted_postings.postings, first, last);
+    }
 
-    for (const auto [document_id, relevance]: document_to_relevance) {
-        matched_documents.emplace_back<Document>({document_id, relevance, documents_.at(document_id).rating});
+    for (const DocumentOrdinal ordinal: IntersectPostings(required_postings, first, last)) {
+        if (accumulator.IsExcluded(ordinal - first)
+            || !document_predicate(documents_.GetId(ordinal), documents_.GetStatus(ordinal),
+                                   documents_.GetRating(ordinal))) {
+            continue;
+        }
+        double relevance = 0.0;
+        for (size_t i = 0; i < cursors.size(); ++i) {
+            cursors[i].Seek(ordinal);
+            if (!cursors[i].IsEnd() && cursors[i].GetOrdinal() == ordinal) {
+                relevance += cursors[i].GetTermFreq() * plus_postings[i].inverse_document_freq;
+            }
+        }
+        top_documents.Push({documents_.GetId(ordinal), relevance, documents_.GetRating(ordinal)});
     }
+}
 
-    return matched_documents;
+template<typename DocumentPredicate>
+void SearchServer::FindAllDocuments(const std::vector<WeightedPostings>& plus_postings,
+                                    DocumentPredicate& document_predicate, DocumentOrdinal first,
+                                    DocumentOrdinal last, ScoreAccumulator& accumulator) const {
+
+    for (const auto& [postings, inverse_document_freq]: plus_postings) {
+        for (PostingCursor cursor(*postings, first, last); !cursor.IsEnd(); cursor.Next()) {
+            const DocumentOrdinal ordinal = cursor.GetOrdinal();
+            if (!accumulator.IsExcluded(ordinal - first)
+                && document_predicate(documents_.GetId(ordinal), documents_.GetStatus(ordinal),
+                                      documents_.GetRating(ordinal))) {
+                accumulator.Add(ordinal - first, cursor.GetTermFreq() * inverse_document_freq);
+            }
+        }
+    }
 }
@@ -0,0 +1,120 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <type_traits>
+
+// Вектор тривиально копируемых элементов, первые N из которых хранятся внутри объекта: пока элементов
+// не больше N, куча не используется. При переполнении элементы переносятся в кучу.
+template<typename T, size_t N>
+class SmallVector {
+    static_assert(std::is_trivially_copyable_v<T>);
+
+public:
+    SmallVector() = default;
+
+    SmallVector(const SmallVector& other) {
+        *this = other;
+    }
+
+    SmallVector(SmallVector&& other) noexcept {
+        *this = std::move(other);
+    }
+
+    SmallVector& operator=(const SmallVector& other) {
+        if (this != &other) {
+            clear();
+            Reserve(other.size_);
+            std::copy(other.begin(), other.end(), data());
+            size_ = other.size_;
+        }
+        return *this;
+    }
+
+    SmallVector& operator=(SmallVector&& other) noexcept {
+        if (this != &other) {
+            std::copy(other.inline_, other.inline_ + N, inline_);
+            heap_ = std::move(other.heap_);
+            size_ = other.size_;
+            capacity_ = other.capacity_;
+            other.size_ = 0;
+            other.capacity_ = N;
+        }
+        return *this;
+    }
+
+    void push_back(const T& value) {
+        if (size_ == capacity_) {
+            Reserve(capacity_ * 2);
+        }
+        data()[size_++] = value;
+    }
+
+    T* data() {
+        return heap_ ? heap_.get() : inline_;
+    }
+
+    const T* data() const {
+        return heap_ ? heap_.get() : inline_;
+    }
+
+    size_t size() const {
+        return size_;
+    }
+
+    bool empty() const {
+        return size_ == 0;
+    }
+
+    T* begin() {
+        return data();
+    }
+
+    T* end() {
+        return data() + size_;
+    }
+
+    const T* begin() const {
+        return data();
+    }
+
+    const T* end() const {
+        return data() + size_;
+    }
+
+    const T& operator[](size_t i) const {
+        return data()[i];
+    }
+
+    void erase(const T* first, const T* last) {
+        T* position = data() + (first - data());
+        std::copy(last, static_cast<const T*>(end()), position);
+        size_ -= last - first;
+    }
+
+    void clear() {
+        size_ = 0;
+    }
+
+    // Элементы хранятся внутри объекта, без кучи.
+    bool IsInline() const {
+        return !heap_;
+    }
+
+private:
+    T inline_[N] = {};
+    std::unique_ptr<T[]> heap_;
+    size_t size_ = 0;
+    size_t capacity_ = N;
+
+    void Reserve(size_t capacity) {
+        if (capacity <= capacity_) {
+            return;
+        }
+        auto heap = std::make_unique<T[]>(capacity);
+        std::copy(begin(), end(), heap.get());
+        heap_ = std::move(heap);
+        capacity_ = capacity;
+    }
+};
@@ -1,12 +1,41 @@
 #include "ss_tests.h"
 #include "my_assert.h"
 #include "search_server.h"
+#include "posting_list.h"
+#include "index_segment.h"
+#include "index_snapshot.h"
+#include "term_dictionary.h"
+#include "document_table.h"
+#include "score_accumulator.h"
+#include "top_documents.h"
+#include "posting_intersection.h"
+#include "document_bitmap.h"
+#include "epoch_reclaimer.h"
+#include "concurrent_search_server.h"
+#include "write_ahead_log.h"
+#include "forward_index.h"
+#include "remove_duplicates.h"
+#include "stop_word_filter.h"
+#include "small_vector.h"
+#include "query_result_cache.h"
+#include "process_queries.h"
+#include <algorithm>
 #include <iostream>
+#include <iterator>
 #include <stdexcept>
 #include <string>
 #include <vector>
 #include <numeric>
 #include <cmath>
+#include <execution>
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <filesystem>
+#include <fstream>
+#include <csignal>
+
+#include <sys/resource.h>
 
 using namespace std;
 
@@ -27,6 +56,32 @@ void TestSearchServer() {
     RUN_TEST(TestPredicate);
     RUN_TEST(TestDocumentStatusFilter);
     RUN_TEST(TestRelevanceCalculation);
+    RUN_TEST(TestPostingList);
+    RUN_TEST(TestTermDictionary);
+    RUN_TEST(TestDocumentTable);
+    RUN_TEST(TestTopDocumentsCount);
+    RUN_TEST(TestScoreAccumulator);
+    RUN_TEST(TestParallelSearch);
+    RUN_TEST(TestMaxScoreEvaluation);
+    RUN_TEST(TestPostingBlockMaxTermFreqs);
+    RUN_TEST(TestCompressedPostingList);
+    RUN_TEST(TestRequiredWords);
+    RUN_TEST(TestPostingIntersection);
+    RUN_TEST(TestMinusWordBitmaps);
+    RUN_TEST(TestStatusPartitions);
+    RUN_TEST(TestCachedInverseDocumentFreqs);
+    RUN_TEST(TestAddDocumentsBatch);
+    RUN_TEST(TestRemovedDocumentCompaction);
+    RUN_TEST(TestIndexSegments);
+    RUN_TEST(TestConcurrentSearchServer);
+    RUN_TEST(TestIndexSnapshot);
+    RUN_TEST(TestSnapshotValidation);
+    RUN_TEST(TestWriteAheadLog);
+    RUN_TEST(TestForwardIndex);
+    RUN_TEST(TestWordTokenizer);
+    RUN_TEST(TestStopWordFilter);
+    RUN_TEST(TestSmallVector);
+    RUN_TEST(TestResultCache);
 }
 
 void TestSearchServerConstructor() {
@@ -208,12 +263,12 @@ void TestGetWordFrequencies() {
     {
         SearchServer server("in the"s);
         ASSERT_EQUAL(server.GetDocumentCount(), 0);
-        const map<string_view, double> got_word_freqs = server.GetWordFrequencies(doc0_id);
+        const WordFrequencies got_word_freqs = server.GetWordFrequencies(doc0_id);
         ASSERT_HINT(got_word_freqs.empty(),
                     "Non-empty result returned for non-existing document. Check GetWordFrequencies method."s);
         server.AddDocument(doc0_id, content0, DocumentStatus::ACTUAL, ratings0);
         ASSERT_EQUAL(server.GetDocumentCount(), 1);
-        const map<string_view, double> got_word_freqs0 = server.GetWordFrequencies(doc0_id);
+        const WordFrequencies got_word_freqs0 = server.GetWordFrequencies(doc0_id);
         ASSERT_HINT(!got_word_freqs0.empty(),
                     "Empty result returned for existing document. Check GetWordFrequencies method."s);
         ASSERT_HINT(!got_word_freqs0.count("the"s), "Stop words in result. ");
@@ -241,7 +296,7 @@ void TestRemoveDocument() {
                           "Failed to remove document. documents_ not empty. Check RemoveDocument method."s);
         ASSERT_EQUAL_HINT(distance(server.begin(), server.end()), 0,
                           "Failed to remove document. document_ids_ not empty. Check RemoveDocument method."s);
-        const map<string_view, double> got_word_freqs0 = server.GetWordFrequencies(doc0_id);
+        const WordFrequencies got_word_freqs0 = server.GetWordFrequencies(doc0_id);
         ASSERT_HINT(got_word_freqs0.empty(),
                     "Failed to remove document. GetWordFrequencies() returned non-empty result. Check RemoveDocument method.");
         const auto found_docs = server.FindTopDocuments("young city cat"s);
@@ -521,4 +576,1277 @@ void TestRelevanceCalculation() {
         ASSERT_EQUAL_HINT(doc1.relevance, doc2_relevance, "Incorrect relevance calculation. Check TF*IDF algorithm."s);
         ASSERT_EQUAL_HINT(doc2.relevance, doc1_relevance, "Incorrect relevance calculation. Check TF*IDF algorithm."s);
     }
-}
\ No newline at end of file
+}
+
+void TestPostingList() {
+    PostingList postings;
+    postings.Add(1, 0.5);
+    postings.Add(5, 0.25);
+    ASSERT_HINT(!postings.HasPending(), "Ordered additions must be appended directly."s);
+    postings.Add(3, 0.75);
+    postings.Add(0, 1.0);
+    postings.Remove(5);
+    ASSERT_HINT(postings.HasPending(), "Unordered additions and removals must be buffered."s);
+    ASSERT_EQUAL(postings.size(), 2);
+    postings.Merge();
+    ASSERT_HINT(!postings.HasPending(), "Merge must empty the buffers."s);
+    const vector<DocumentOrdinal> expected_ordinals = {0, 1, 3};
+    const vector<double> expected_freqs = {1.0, 0.5, 0.75};
+    ASSERT_HINT(postings.GetOrdinals() == expected_ordinals, "Posting list must stay sorted by ordinal."s);
+    ASSERT_HINT(postings.GetTermFreqs() == expected_freqs, "Term frequencies must follow their ordinals."s);
+    postings.Remove(1);
+    postings.Add(1, 0.125);
+    postings.Merge();
+    ASSERT_EQUAL(postings.size(), 3);
+    ASSERT_EQUAL(postings.GetTermFreqs()[1], 0.125);
+}
+
+void TestTermDictionary() {
+    TermDictionary dictionary;
+    const TermId cat = dictionary.Intern("cat"s);
+    const TermId city = dictionary.Intern("city"s);
+    ASSERT_EQUAL(cat, 0u);
+    ASSERT_EQUAL(city, 1u);
+    ASSERT_EQUAL_HINT(dictionary.Intern("cat"s), cat, "Repeated word must keep its term id."s);
+    ASSERT_EQUAL(dictionary.size(), 2);
+    ASSERT_HINT(!dictionary.Find("dog"s), "Unknown word must not be found."s);
+    const string_view cat_view = dictionary.GetTerm(cat);
+    for (int i = 0; i < 100'000; ++i) {
+        dictionary.Intern("word"s + to_string(i));
+    }
+    ASSERT_EQUAL_HINT(cat_view, "cat"s, "Pooled terms must not move when the pool grows."s);
+    ASSERT_EQUAL(*dictionary.Find("word99999"s), 100'001u);
+    ASSERT_EQUAL(dictionary.GetTerm(100'001), "word99999"s);
+    const string long_word(100'000, 'x');
+    ASSERT_EQUAL(dictionary.GetTerm(dictionary.Intern(long_word)), long_word);
+    for (int i = 0; i < 100'000; i += 997) {
+        ASSERT_EQUAL(*dictionary.Find("word"s + to_string(i)), static_cast<TermId>(i + 2));
+        ASSERT_EQUAL(dictionary.GetTerm(i + 2), "word"s + to_string(i));
+    }
+
+    // Копия делит неизменяемые уровни словаря, но не видит слов, добавленных после копирования.
+    TermDictionary copy = dictionary;
+    const TermId late = dictionary.Intern("late"s);
+    ASSERT(!copy.Find("late"s));
+    ASSERT_EQUAL(copy.Intern("early"s), late);
+    ASSERT_EQUAL(copy.GetTerm(late), "early"s);
+    ASSERT_EQUAL(dictionary.GetTerm(late), "late"s);
+
+    // Копии делят пул строк, но пополняются независимо, в том числе одновременно из разных потоков.
+    SearchServer server;
+    server.AddDocument(0, "common cat"s, DocumentStatus::ACTUAL, {1});
+    vector<SearchServer> copies(2, server);
+    vector<thread> threads;
+    for (size_t i = 0; i < copies.size(); ++i) {
+        threads.emplace_back([&copies, i] {
+            for (int id = 1; id <= 2000; ++id) {
+                copies[i].AddDocument(id, "copy"s + to_string(i) + "word"s + to_string(id) + " common"s,
+                                      DocumentStatus::ACTUAL, {id});
+            }
+        });
+    }
+    for (thread& worker: threads) {
+        worker.join();
+    }
+    for (size_t i = 0; i < copies.size(); ++i) {
+        const string own_word = "copy"s + to_string(i) + "word1999"s;
+        const string other_word = "copy"s + to_string(1 - i) + "word1999"s;
+        ASSERT_EQUAL(copies[i].FindTopDocuments(own_word).size(), 1u);
+        ASSERT_HINT(copies[i].FindTopDocuments(other_word).empty(), "Copies must not see each other's words."s);
+        ASSERT_EQUAL(copies[i].GetWordFrequencies(1999).count(own_word), 1u);
+        ASSERT_EQUAL(copies[i].FindTopDocuments("common"s).size(), 5u);
+    }
+    ASSERT_EQUAL(server.GetDocumentCount(), 1);
+}
+
+void TestDocumentTable() {
+    {
+        DocumentTable documents;
+        ASSERT_EQUAL(documents.Add(42, 5, DocumentStatus::ACTUAL), 0u);
+        ASSERT_EQUAL(documents.Add(7, -1, DocumentStatus::BANNED), 1u);
+        ASSERT_EQUAL(documents.size(), 2);
+        ASSERT_EQUAL(documents.GetId(1), 7);
+        ASSERT_EQUAL(documents.GetRating(1), -1);
+        ASSERT_HINT(documents.GetStatus(1) == DocumentStatus::BANNED, "Wrong status column."s);
+        ASSERT_EQUAL_HINT(*documents.begin(), 7, "External ids must be iterated in sorted order."s);
+        documents.Remove(42);
+        ASSERT_HINT(!documents.FindOrdinal(42), "Removed document must not be found."s);
+        ASSERT_EQUAL_HINT(documents.Add(42, 3, DocumentStatus::ACTUAL), 2u, "Ordinals must not be reused."s);
+        ASSERT_EQUAL(documents.size(), 2);
+        ASSERT_EQUAL(documents.GetOrdinalCount(), 3);
+    }
+    {
+        SearchServer server;
+        server.AddDocument(42, "cat in the city"s, DocumentStatus::ACTUAL, {1, 2, 3});
+        server.RemoveDocument(42);
+        server.AddDocument(42, "dog in the city"s, DocumentStatus::ACTUAL, {7});
+        ASSERT_HINT(server.FindTopDocuments("cat"s).empty(), "Removed content must not be found."s);
+        const auto found_docs = server.FindTopDocuments("dog"s);
+        ASSERT_EQUAL(found_docs.size(), 1);
+        ASSERT_EQUAL(found_docs[0].id, 42);
+        ASSERT_EQUAL(found_docs[0].rating, 7);
+    }
+}
+
+void TestTopDocumentsCount() {
+    SearchServer server("in the"s);
+    for (int id = 0; id < 8; ++id) {
+        server.AddDocument(id, "cat in the city number "s + to_string(id), DocumentStatus::ACTUAL, {id});
+    }
+    server.AddDocument(8, "dog in the city"s, DocumentStatus::ACTUAL, {1});
+    {
+        const auto found_docs = server.FindTopDocuments("cat"s);
+        ASSERT_EQUAL_HINT(found_docs.size(), MAX_RESULT_DOCUMENT_COUNT, "Default top count must be kept."s);
+    }
+    {
+        const auto found_docs = server.FindTopDocuments("cat"s, DocumentStatus::ACTUAL, 3);
+        ASSERT_EQUAL(found_docs.size(), 3);
+        ASSERT_EQUAL_HINT(found_docs[0].id, 7, "Equal relevance must be ordered by rating."s);
+        ASSERT_EQUAL(found_docs[1].id, 6);
+        ASSERT_EQUAL(found_docs[2].id, 5);
+    }
+    {
+        const auto found_docs = server.FindTopDocuments(execution::par, "cat city"s, DocumentStatus::ACTUAL, 20);
+        ASSERT_EQUAL_HINT(found_docs.size(), 9, "Top count above the number of matches must return all of them."s);
+        ASSERT_EQUAL_HINT(found_docs[8].id, 8, "Document without the rarer word must be ranked last."s);
+        const auto seq_docs = server.FindTopDocuments(execution::seq, "cat city"s, DocumentStatus::ACTUAL, 20);
+        for (size_t i = 0; i < seq_docs.size(); ++i) {
+            ASSERT_EQUAL_HINT(found_docs[i].id, seq_docs[i].id, "Parallel top must match sequential top."s);
+        }
+    }
+    ASSERT_HINT(server.FindTopDocuments("cat"s, DocumentStatus::ACTUAL, 0).empty(), "Zero top count."s);
+
+    // Порядок выдачи различает только релевантность и рейтинг; среди равных по ним куча оставляет меньшие id,
+    // в каком бы порядке документы ни пришли.
+    const Document first{4, 0.5, 1};
+    const Document second{2, 0.5 + EPSILON / 2, 1};
+    ASSERT(!IsRankedHigher(first, second) && !IsRankedHigher(second, first));
+    ASSERT(IsRankedHigher(Document{9, 0.5, 2}, first));
+    for (const vector<int>& ids: {vector<int>{5, 1, 4, 2, 3}, vector<int>{1, 2, 3, 4, 5}, vector<int>{5, 4, 3, 2, 1}}) {
+        TopDocuments top(3);
+        for (const int id: ids) {
+            top.Push({id, 0.5, 1});
+        }
+        const vector<Document> documents = top.Extract();
+        ASSERT_EQUAL(documents.size(), 3u);
+        for (int i = 0; i < 3; ++i) {
+            ASSERT_EQUAL(documents[i].id, i + 1);
+        }
+    }
+}
+
+void TestScoreAccumulator() {
+    ScoreAccumulator accumulator;
+    accumulator.Reset(10);
+    accumulator.Exclude(3);
+    accumulator.Add(3, 1.0);
+    accumulator.Add(5, 0.5);
+    accumulator.Add(5, 0.25);
+    accumulator.Add(1, 2.0);
+    ASSERT_HINT(accumulator.IsExcluded(3), "Excluded document must stay excluded."s);
+    ASSERT_EQUAL_HINT(accumulator.GetTouched().size(), 2, "Excluded document must not be scored."s);
+    ASSERT_EQUAL(accumulator.GetTouched()[0], 5u);
+    ASSERT_EQUAL(accumulator.GetScore(5), 0.75);
+    accumulator.Reset(20);
+    ASSERT_HINT(accumulator.GetTouched().empty(), "Reset must forget touched documents."s);
+    ASSERT_HINT(!accumulator.IsExcluded(3), "Reset must clear exclusions."s);
+    ASSERT_EQUAL_HINT(accumulator.GetScore(5), 0.0, "Reset must zero scores."s);
+    accumulator.Add(15, 1.0);
+    ASSERT_EQUAL(accumulator.GetScore(15), 1.0);
+
+    const ScoreAccumulator* first = nullptr;
+    {
+        PooledScoreAccumulator pooled;
+        first = &*pooled;
+        PooledScoreAccumulator nested;
+        ASSERT_HINT(&*nested != first, "Nested queries must get separate accumulators."s);
+    }
+    PooledScoreAccumulator pooled;
+    ASSERT_HINT(&*pooled == first, "Pooled accumulator must be reused."s);
+}
+
+void TestParallelSearch() {
+    const vector<string> words = {"cat"s, "dog"s, "parrot"s, "city"s, "village"s, "young"s, "old"s};
+    SearchServer server("in the"s);
+    for (int id = 0; id < 5000; ++id) {
+        string content;
+        for (int i = 0; i <= id % 5; ++i) {
+            content += words[(id * 7 + i * 3) % words.size()] + " in the "s;
+        }
+        server.AddDocument(id * 2, content, DocumentStatus::ACTUAL, {id % 11});
+    }
+    for (int id = 0; id < 10000; id += 6) {
+        server.RemoveDocument(execution::par, id);
+    }
+    const vector<string> queries = {"cat"s, "young cat -city"s, "dog parrot village -old"s, "-cat"s, "old old city"s};
+    for (const string& query: queries) {
+        const auto seq_docs = server.FindTopDocuments(query, DocumentStatus::ACTUAL, 50);
+        const auto par_docs = server.FindTopDocuments(execution::par, query, DocumentStatus::ACTUAL, 50);
+        ASSERT_EQUAL_HINT(par_docs.size(), seq_docs.size(), "Parallel search lost or added documents: "s + query);
+        for (size_t i = 0; i < seq_docs.size(); ++i) {
+            ASSERT_HINT(abs(par_docs[i].relevance - seq_docs[i].relevance) < 1e-12,
+                        "Parallel relevance differs: "s + query);
+            ASSERT_EQUAL(par_docs[i].rating, seq_docs[i].rating);
+        }
+    }
+}
+
+void TestMaxScoreEvaluation() {
+    const vector<string> words = {"cat"s, "dog"s, "parrot"s, "city"s, "village"s, "young"s, "old"s, "fluffy"s};
+    SearchServer server("in the"s);
+    for (int id = 0; id < 10000; ++id) {
+        string content;
+        for (int i = 0; i <= id % 7; ++i) {
+            content += words[(id * 5 + i * i) % words.size()] + " in the "s;
+        }
+        server.AddDocument(id, content, static_cast<DocumentStatus>(id % 3), {id % 13});
+    }
+    for (int id = 0; id < 10000; id += 7) {
+        server.RemoveDocument(id);
+    }
+    const vector<string> queries = {"cat"s, "fluffy cat -city"s, "dog parrot village young old"s, "-cat"s,
+                                    "old old city fluffy"s, "cat dog parrot city village young old fluffy"s};
+    const auto predicate = [](int document_id, DocumentStatus, int rating) {
+        return document_id % 4 != 1 && rating > 2;
+    };
+    for (const string& query: queries) {
+        for (const size_t top_count: {size_t{1}, size_t{5}, size_t{40}}) {
+            server.SetQueryEvaluation(QueryEvaluation::EXHAUSTIVE);
+            const vector<vector<Document>> expected = {
+                    server.FindTopDocuments(query, DocumentStatus::ACTUAL, top_count),
+                    server.FindTopDocuments(execution::par, query, DocumentStatus::BANNED, top_count),
+                    server.FindTopDocuments(query, predicate, top_count)};
+            server.SetQueryEvaluation(QueryEvaluation::MAX_SCORE);
+            const vector<vector<Document>> found = {
+                    server.FindTopDocuments(query, DocumentStatus::ACTUAL, top_count),
+                    server.FindTopDocuments(execution::par, query, DocumentStatus::BANNED, top_count),
+                    server.FindTopDocuments(query, predicate, top_count)};
+            for (size_t i = 0; i < expected.size(); ++i) {
+                ASSERT_EQUAL_HINT(found[i].size(), expected[i].size(), "MaxScore lost or added documents: "s + query);
+                for (size_t j = 0; j < expected[i].size(); ++j) {
+                    ASSERT_EQUAL_HINT(found[i][j].id, expected[i][j].id, "MaxScore ranking differs: "s + query);
+                    ASSERT_HINT(found[i][j].relevance == expected[i][j].relevance,
+                                "MaxScore relevance differs: "s + query);
+                }
+            }
+        }
+    }
+}
+
+void TestPostingBlockMaxTermFreqs() {
+    const size_t block_size = PostingList::BLOCK_SIZE;
+    PostingList postings;
+    for (DocumentOrdinal ordinal = 0; ordinal < 3 * block_size; ++ordinal) {
+        postings.Add(ordinal, ordinal == block_size + 5 ? 0.5 : 0.125);
+    }
+    vector<double> expected_maxima = {0.125, 0.5, 0.125};
+    ASSERT_HINT(postings.GetBlockMaxTermFreqs() == expected_maxima, "Appends must maintain block maxima."s);
+    ASSERT_EQUAL(postings.GetMaxTermFreq(), 0.5);
+
+    PostingCursor cursor(postings, 0, 3 * block_size);
+    ASSERT_EQUAL_HINT(cursor.GetBlockMaxTermFreq(block_size), 0.125, "Bound must cover only blocks before last."s);
+    ASSERT_EQUAL(cursor.GetBlockMaxTermFreq(block_size + 1), 0.5);
+    cursor.Seek(2 * block_size);
+    ASSERT_EQUAL_HINT(cursor.GetBlockMaxTermFreq(3 * block_size), 0.125, "Bound must skip passed blocks."s);
+
+    postings.Remove(block_size + 5);
+    postings.Add(3 * block_size, 0.25);
+    postings.Merge();
+    expected_maxima = {0.125, 0.125, 0.25};
+    ASSERT_HINT(postings.GetBlockMaxTermFreqs() == expected_maxima, "Merge must rebuild block maxima."s);
+    ASSERT_EQUAL(postings.GetMaxTermFreq(), 0.25);
+}
+
+void TestCompressedPostingList() {
+    PostingList plain;
+    PostingList compressed(PostingFormat::COMPRESSED);
+    DocumentOrdinal ordinal = 0;
+    for (int i = 0; i < 1000; ++i) {
+        // Разрывы разной длины задействуют все длины кода от одного до четырёх байт.
+        ordinal += i % 97 == 0 ? 70000 + i : i % 13 == 0 ? 300 : 1 + i % 5;
+        // Частоты блоков: несколько различных значений, суммы величин 1 / n, как при индексации,
+        // и произвольные значения.
+        double term_freq = 1.0 / (1 + i % 7);
+        if (i >= 400 && i < 700) {
+            term_freq = 0.0;
+            for (int added = 0; added <= i % 3; ++added) {
+                term_freq += 1.0 / (10 + i);
+            }
+        } else if (i >= 700) {
+            term_freq = sqrt(1.0 + i);
+        }
+        plain.Add(ordinal, term_freq);
+        compressed.Add(ordinal, term_freq);
+    }
+    ASSERT_EQUAL(compressed.size(), plain.size());
+    ASSERT_HINT(compressed.GetOrdinals().size() < PostingList::BLOCK_SIZE, "Full blocks must be sealed."s);
+    ASSERT_HINT(compressed.GetMemoryUsage() < plain.GetMemoryUsage(), "Compressed postings must take less memory."s);
+
+    const auto assert_same_postings = [&plain, &compressed](DocumentOrdinal first, DocumentOrdinal last) {
+        ASSERT(compressed.FindRange(first, last) == plain.FindRange(first, last));
+        PostingCursor expected(plain, first, last);
+        PostingCursor cursor(compressed, first, last);
+        for (; !expected.IsEnd(); expected.Next(), cursor.Next()) {
+            ASSERT(!cursor.IsEnd());
+            ASSERT_EQUAL(cursor.GetOrdinal(), expected.GetOrdinal());
+            ASSERT_HINT(cursor.GetTermFreq() == expected.GetTermFreq(), "Term frequencies must be lossless."s);
+        }
+        ASSERT(cursor.IsEnd());
+    };
+    assert_same_postings(0, ordinal + 1);
+    assert_same_postings(ordinal / 3, ordinal / 2);
+
+    PostingCursor expected(plain, 0, ordinal + 1);
+    PostingCursor cursor(compressed, 0, ordinal + 1);
+    for (DocumentOrdinal target = 0; target <= ordinal + 1; target += 997) {
+        expected.Seek(target);
+        cursor.Seek(target);
+        ASSERT_EQUAL(cursor.IsEnd(), expected.IsEnd());
+        if (!cursor.IsEnd()) {
+            ASSERT_EQUAL_HINT(cursor.GetOrdinal(), expected.GetOrdinal(), "Seek must skip sealed blocks correctly."s);
+        }
+    }
+
+    const DocumentOrdinal removed_ordinal = plain.GetOrdinals()[10];
+    for (PostingList* postings: {&plain, &compressed}) {
+        postings->Remove(removed_ordinal);
+        postings->Add(ordinal + 5, 0.75);
+        postings->Merge();
+    }
+    ASSERT(compressed.GetBlockMaxTermFreqs() == plain.GetBlockMaxTermFreqs());
+    assert_same_postings(0, ordinal + 6);
+    compressed.SetFormat(PostingFormat::PLAIN);
+    ASSERT(compressed.GetOrdinals() == plain.GetOrdinals());
+    ASSERT(compressed.GetTermFreqs() == plain.GetTermFreqs());
+}
+
+void TestRequiredWords() {
+    SearchServer server("in the"s);
+    server.AddDocument(1, "cat in the city"s, DocumentStatus::ACTUAL, {1});
+    server.AddDocument(2, "dog in the city"s, DocumentStatus::ACTUAL, {2});
+    server.AddDocument(3, "cat and dog in the city"s, DocumentStatus::ACTUAL, {3});
+    server.AddDocument(4, "cat and dog in the village"s, DocumentStatus::ACTUAL, {4});
+    {
+        const auto found_docs = server.FindTopDocuments("+cat +dog"s);
+        ASSERT_EQUAL_HINT(found_docs.size(), 2, "Only documents with all required words must be found."s);
+        const auto all_docs = server.FindTopDocuments("cat dog"s);
+        for (const Document& document: found_docs) {
+            const auto it = find_if(all_docs.begin(), all_docs.end(), [&document](const Document& other) {
+                return other.id == document.id;
+            });
+            ASSERT(it != all_docs.end());
+            ASSERT_EQUAL_HINT(document.relevance, it->relevance, "Required words must keep TF-IDF relevance."s);
+        }
+    }
+    {
+        const auto found_docs = server.FindTopDocuments("+cat city -village"s);
+        ASSERT_EQUAL(found_docs.size(), 2);
+        ASSERT_EQUAL_HINT(found_docs[0].id, 1, "Optional words must still add relevance."s);
+        ASSERT_EQUAL(found_docs[1].id, 3);
+        const auto par_docs = server.FindTopDocuments(execution::par, "+cat city -village"s);
+        ASSERT_EQUAL(par_docs.size(), 2);
+        ASSERT_EQUAL(par_docs[0].id, 1);
+        ASSERT_EQUAL(par_docs[1].id, 3);
+    }
+    ASSERT_HINT(server.FindTopDocuments("+parrot cat"s).empty(), "Unknown required word matches nothing."s);
+    ASSERT_HINT(!server.FindTopDocuments("+the cat"s).empty(), "Required stop words must be ignored."s);
+    {
+        const auto [words, status] = server.MatchDocument("+dog cat"s, 1);
+        ASSERT_HINT(words.empty(), "Document without a required word must not match."s);
+        const auto [par_words, par_status] = server.MatchDocument(execution::par, "+dog cat"s, 3);
+        const vector<string_view> expected_words = {"cat"sv, "dog"sv};
+        ASSERT(par_words == expected_words);
+    }
+    for (const string& query: {"+"s, "++cat"s, "+-cat"s, "-+cat"s}) {
+        try {
+            server.FindTopDocuments(query);
+            ASSERT_HINT(false, "Malformed required word must be rejected: "s + query);
+        } catch (const invalid_argument&) {
+        }
+    }
+}
+
+void TestPostingIntersection() {
+    vector<DocumentOrdinal> lhs;
+    vector<DocumentOrdinal> rhs;
+    for (DocumentOrdinal ordinal = 0; ordinal < 2000; ++ordinal) {
+        if (ordinal % 3 == 0 || ordinal % 7 == 1) {
+            lhs.push_back(ordinal);
+        }
+        if (ordinal % 5 == 0 || ordinal % 11 == 2) {
+            rhs.push_back(ordinal);
+        }
+    }
+    vector<DocumentOrdinal> expected;
+    set_intersection(lhs.begin(), lhs.end(), rhs.begin(), rhs.end(), back_inserter(expected));
+    vector<DocumentOrdinal> found(lhs.size());
+    found.resize(IntersectOrdinals(lhs.data(), lhs.size(), rhs.data(), rhs.size(), found.data()));
+    ASSERT_HINT(found == expected, "Block intersection must match std::set_intersection."s);
+
+    PostingList small_list;
+    PostingList large_list(PostingFormat::COMPRESSED);
+    PostingList other_list;
+    for (DocumentOrdinal ordinal = 0; ordinal < 5000; ++ordinal) {
+        if (ordinal % 250 == 0) {
+            small_list.Add(ordinal, 1.0);
+        }
+        if (ordinal % 2 == 0) {
+            large_list.Add(ordinal, 1.0);
+            other_list.Add(ordinal + 1, 1.0);
+        }
+    }
+    const vector<DocumentOrdinal> expected_small = {1000, 1250, 1500, 1750};
+    ASSERT_HINT(IntersectPostings({&large_list, &small_list}, 1000, 2000) == expected_small,
+                "Galloping intersection must respect the ordinal range."s);
+    ASSERT_HINT(IntersectPostings({&large_list, &other_list}, 0, 5000).empty(), "Disjoint lists share nothing."s);
+}
+
+void TestMinusWordBitmaps() {
+    // Разреженный кусок (массив), плотный кусок (битовая карта) и одиночный номер в дальнем куске.
+    PostingList postings(PostingFormat::COMPRESSED);
+    vector<DocumentOrdinal> ordinals;
+    for (DocumentOrdinal ordinal = 0; ordinal < 20000; ordinal += 7) {
+        ordinals.push_back(ordinal);
+    }
+    for (DocumentOrdinal ordinal = 65536; ordinal < 131072; ordinal += 2) {
+        ordinals.push_back(ordinal);
+    }
+    ordinals.push_back(300000);
+    for (const DocumentOrdinal ordinal: ordinals) {
+        postings.Add(ordinal, 0.5);
+    }
+    postings.Merge();
+
+    const DocumentBitmap bitmap(postings);
+    ASSERT_EQUAL(bitmap.size(), ordinals.size());
+    ASSERT_HINT(bitmap.Contains(14) && !bitmap.Contains(15), "Sparse chunk membership."s);
+    ASSERT_HINT(bitmap.Contains(65538) && !bitmap.Contains(65539), "Dense chunk membership."s);
+    ASSERT_HINT(bitmap.Contains(300000) && !bitmap.Contains(131072), "Far chunk membership."s);
+    ASSERT_HINT(bitmap.GetMemoryUsage() < ordinals.size() * sizeof(DocumentOrdinal) / 2,
+                "Bitmap must be smaller than the ordinals it holds."s);
+
+    for (const auto& [first, last]: {pair<DocumentOrdinal, DocumentOrdinal>{19950, 65603},
+                                     {65541, 65700}, {0, 300001}}) {
+        vector<uint64_t> mask((last - first + 63) / 64);
+        bitmap.MarkRange(first, last, mask.data());
+        size_t marked_count = 0;
+        for (DocumentOrdinal ordinal = first; ordinal < last; ++ordinal) {
+            const bool is_marked = (mask[(ordinal - first) / 64] >> ((ordinal - first) % 64)) & 1;
+            ASSERT_EQUAL_HINT(is_marked, bitmap.Contains(ordinal), "Mask must mirror the bitmap in range."s);
+            marked_count += is_marked;
+        }
+        ASSERT(marked_count > 0);
+    }
+
+    // Частое минус-слово исключает документы по карте из кэша; изменения документов сбрасывают карту.
+    SearchServer server;
+    for (int id = 0; id < 5000; ++id) {
+        server.AddDocument(id, id % 2 == 0 ? "cat dog"s : "cat"s, DocumentStatus::ACTUAL, {id});
+    }
+    server.AddDocument(5000, "cat parrot"s, DocumentStatus::ACTUAL, {1});
+    ASSERT_EQUAL(server.FindTopDocuments("parrot -dog"s).size(), 1);
+    server.AddDocument(5001, "dog parrot"s, DocumentStatus::ACTUAL, {1});
+    const auto found_docs = server.FindTopDocuments(execution::par, "parrot -dog"s);
+    ASSERT_EQUAL_HINT(found_docs.size(), 1, "Added document must reach the cached bitmap."s);
+    ASSERT_EQUAL(found_docs[0].id, 5000);
+    ASSERT_HINT(get<0>(server.MatchDocument("parrot -dog"s, 5001)).empty(), "Matching must use the bitmap."s);
+    server.RemoveDocument(0);
+    server.AddDocument(0, "parrot"s, DocumentStatus::ACTUAL, {1});
+    ASSERT_EQUAL_HINT(server.FindTopDocuments("parrot -dog"s).size(), 2, "Removed document must leave the bitmap."s);
+    ASSERT_EQUAL(get<0>(server.MatchDocument(execution::par, "parrot -dog"s, 0)).size(), 1);
+}
+
+void TestStatusPartitions() {
+    SearchServer server("and"s);
+    server.AddDocument(1, "white cat and collar"s, DocumentStatus::ACTUAL, {8});
+    server.AddDocument(2, "fluffy cat fluffy tail"s, DocumentStatus::BANNED, {7});
+    server.AddDocument(3, "groomed dog expressive eyes"s, DocumentStatus::BANNED, {5});
+    server.AddDocument(4, "groomed cat"s, DocumentStatus::IRRELEVANT, {9});
+    server.AddDocument(5, "white dog"s, DocumentStatus::REMOVED, {1});
+    const auto banned_lambda = [](int /*document_id*/, DocumentStatus status, int /*rating*/) {
+        return status == DocumentStatus::BANNED;
+    };
+    for (const string& query: {"cat dog"s, "groomed -fluffy"s, "+cat white"s, "white"s}) {
+        const auto by_status = server.FindTopDocuments(query, DocumentStatus::BANNED);
+        const auto by_lambda = server.FindTopDocuments(query, banned_lambda);
+        const auto by_status_par = server.FindTopDocuments(execution::par, query, StatusPredicate{DocumentStatus::BANNED});
+        ASSERT_EQUAL_HINT(by_status.size(), by_lambda.size(), "Status partition must match the general path: "s + query);
+        ASSERT_EQUAL(by_status_par.size(), by_lambda.size());
+        for (size_t i = 0; i < by_status.size(); ++i) {
+            ASSERT_EQUAL(by_status[i].id, by_lambda[i].id);
+            ASSERT_EQUAL(by_status[i].relevance, by_lambda[i].relevance);
+            ASSERT_EQUAL(by_status_par[i].id, by_lambda[i].id);
+        }
+    }
+    {
+        const auto found_docs = server.FindTopDocuments("cat"s, DocumentStatus::IRRELEVANT);
+        ASSERT_EQUAL(found_docs.size(), 1);
+        ASSERT_EQUAL(found_docs[0].id, 4);
+        ASSERT_HINT(abs(found_docs[0].relevance - 0.5 * log(5.0 / 3)) < EPSILON,
+                    "IDF must count documents of every status."s);
+    }
+    const auto [words, status] = server.MatchDocument("white -collar"s, 5);
+    ASSERT_EQUAL(words.size(), 1);
+    ASSERT_HINT(status == DocumentStatus::REMOVED, "MatchDocument must report the document status."s);
+    server.RemoveDocument(3);
+    ASSERT_HINT(server.FindTopDocuments("dog"s, DocumentStatus::BANNED).empty(), "Removed document leaves its partition."s);
+    ASSERT_EQUAL(server.FindTopDocuments("dog"s, DocumentStatus::REMOVED).size(), 1);
+}
+
+void TestCachedInverseDocumentFreqs() {
+    SearchServer server;
+    for (int id = 0; id < 200; ++id) {
+        server.AddDocument(id, id < 20 ? "cat dog"s : "dog bird"s, DocumentStatus::ACTUAL, {id});
+    }
+    const auto cat_relevance = [&server]() {
+        const auto found_docs = server.FindTopDocuments("cat"s);
+        ASSERT(!found_docs.empty());
+        return found_docs[0].relevance;
+    };
+    ASSERT_EQUAL(cat_relevance(), 0.5 * log(200.0 / 20));
+    server.SetRelevanceMode(RelevanceMode::CACHED_IDF);
+    ASSERT_EQUAL_HINT(cat_relevance(), 0.5 * log(200.0 / 20), "Switching to cached IDF must refresh it exactly."s);
+
+    server.AddDocument(200, "bird"s, DocumentStatus::ACTUAL, {1});
+    ASSERT_EQUAL_HINT(cat_relevance(), 0.5 * log(200.0 / 20), "Small drift must keep the cached IDF."s);
+    server.RefreshInverseDocumentFreqs();
+    ASSERT_EQUAL(cat_relevance(), 0.5 * log(201.0 / 20));
+    for (int id = 201; id < 204; ++id) {
+        server.AddDocument(id, "bird"s, DocumentStatus::ACTUAL, {1});
+    }
+    ASSERT_EQUAL_HINT(cat_relevance(), 0.5 * log(204.0 / 20), "Document count drift must refresh every IDF."s);
+    server.AddDocument(204, "cat cow"s, DocumentStatus::ACTUAL, {1});
+    ASSERT_EQUAL_HINT(cat_relevance(), 0.5 * log(204.0 / 21), "Document frequency drift must refresh the word."s);
+
+    server.SetRelevanceMode(RelevanceMode::EXACT);
+    ASSERT_EQUAL(cat_relevance(), 0.5 * log(205.0 / 21));
+}
+
+void TestAddDocumentsBatch() {
+    const vector<string> texts = {"white cat and collar"s, "fluffy cat fluffy tail"s, "groomed dog expressive eyes"s,
+                                  "groomed starling eugene"s, ""s, "cat cat dog"s};
+    SearchServer expected_server("and"s);
+    SearchServer server("and"s);
+    server.AddDocument(100, "old cat"s, DocumentStatus::ACTUAL, {1});
+    expected_server.AddDocument(100, "old cat"s, DocumentStatus::ACTUAL, {1});
+    vector<DocumentData> batch;
+    for (size_t i = 0; i < texts.size(); ++i) {
+        const auto status = static_cast<DocumentStatus>(i % DOCUMENT_STATUS_COUNT);
+        const vector<int> ratings = {static_cast<int>(i), 3};
+        batch.push_back({static_cast<int>(i), texts[i], status, ratings});
+        expected_server.AddDocument(static_cast<int>(i), texts[i], status, ratings);
+    }
+    server.AddDocuments(execution::par, batch);
+
+    ASSERT_EQUAL(server.GetDocumentCount(), expected_server.GetDocumentCount());
+    for (size_t i = 0; i < texts.size(); ++i) {
+        ASSERT_HINT(server.GetWordFrequencies(static_cast<int>(i)) == expected_server.GetWordFrequencies(static_cast<int>(i)),
+                    "Batch must store the same word frequencies as AddDocument."s);
+    }
+    const auto all = [](int /*document_id*/, DocumentStatus /*status*/, int /*rating*/) {
+        return true;
+    };
+    for (const string& query: {"cat"s, "groomed -dog"s, "fluffy +cat"s, "eyes tail collar old"s}) {
+        const auto found_docs = server.FindTopDocuments(query, all);
+        const auto expected_docs = expected_server.FindTopDocuments(query, all);
+        ASSERT_EQUAL(found_docs.size(), expected_docs.size());
+        for (size_t i = 0; i < found_docs.size(); ++i) {
+            ASSERT_EQUAL(found_docs[i].id, expected_docs[i].id);
+            ASSERT_EQUAL(found_docs[i].relevance, expected_docs[i].relevance);
+            ASSERT_EQUAL(found_docs[i].rating, expected_docs[i].rating);
+        }
+    }
+
+    const auto expect_rejected = [&server](const vector<DocumentData>& bad_batch, const string& message) {
+        const int document_count = server.GetDocumentCount();
+        try {
+            server.AddDocuments(bad_batch);
+            ASSERT_HINT(false, "Batch must be rejected: "s + message);
+        } catch (const invalid_argument& error) {
+            ASSERT_EQUAL(string(error.what()), message);
+        }
+        ASSERT_EQUAL_HINT(server.GetDocumentCount(), document_count, "Rejected batch must not add documents."s);
+    };
+    expect_rejected({{200, "dog"sv, DocumentStatus::ACTUAL, {}}, {-1, "dog"sv, DocumentStatus::ACTUAL, {}}},
+                    "Negative document ID."s);
+    expect_rejected({{200, "dog"sv, DocumentStatus::ACTUAL, {}}, {200, "cat"sv, DocumentStatus::ACTUAL, {}}},
+                    "Double addition of the document."s);
+    expect_rejected({{3, "dog"sv, DocumentStatus::ACTUAL, {}}}, "Double addition of the document."s);
+    expect_rejected({{200, "d\x12og"sv, DocumentStatus::ACTUAL, {}}, {-1, "dog"sv, DocumentStatus::ACTUAL, {}}},
+                    "Document contains forbidden characters."s);
+    ASSERT_HINT(server.FindTopDocuments("dog"s, all).size() == expected_server.FindTopDocuments("dog"s, all).size(),
+                "Rejected batch must not leave postings."s);
+}
+
+void TestRemovedDocumentCompaction() {
+    SearchServer server;
+    SearchServer expected_server;
+    for (int id = 0; id < 20; ++id) {
+        const string text = "cat "s + (id % 2 ? "dog"s : "parrot"s) + (id % 5 ? " tail"s : " collar"s);
+        server.AddDocument(id, text, DocumentStatus::ACTUAL, {id});
+        if (id % 7 != 0) {
+            expected_server.AddDocument(id, text, DocumentStatus::ACTUAL, {id});
+        }
+    }
+    const size_t posting_count = server.GetPostingCount();
+    for (int id = 0; id < 20; id += 7) {
+        server.RemoveDocument(id);
+    }
+
+    const auto check_same_results = [&server, &expected_server](const string& stage) {
+        ASSERT_EQUAL_HINT(server.GetDocumentCount(), expected_server.GetDocumentCount(), stage);
+        for (const string& query: {"cat"s, "dog collar"s, "parrot -tail"s, "+collar cat"s}) {
+            const auto found_docs = server.FindTopDocuments(query);
+            const auto expected_docs = expected_server.FindTopDocuments(query);
+            ASSERT_EQUAL_HINT(found_docs.size(), expected_docs.size(), stage);
+            for (size_t i = 0; i < found_docs.size(); ++i) {
+                ASSERT_EQUAL_HINT(found_docs[i].id, expected_docs[i].id, stage);
+                ASSERT_EQUAL_HINT(found_docs[i].relevance, expected_docs[i].relevance, stage);
+            }
+        }
+    };
+
+    ASSERT_EQUAL_HINT(server.GetPostingCount(), posting_count,
+                      "Removal must only mark postings until compaction."s);
+    check_same_results("Removed documents must be excluded and IDF must stay exact before compaction."s);
+
+    server.CompactPostings(execution::par);
+    ASSERT_EQUAL_HINT(server.GetPostingCount(), expected_server.GetPostingCount(),
+                      "Compaction must erase postings of removed documents."s);
+    check_same_results("Compaction must not change results."s);
+
+    const size_t compacted_posting_count = server.GetPostingCount();
+    for (int id = 1; id < 20; id += 2) {
+        if (id % 7 != 0) {
+            server.RemoveDocument(id);
+            expected_server.RemoveDocument(id);
+        }
+    }
+    ASSERT_HINT(server.GetPostingCount() < compacted_posting_count,
+                "Many removed documents must trigger compaction."s);
+    check_same_results("Automatic compaction must not change results."s);
+}
+
+void TestIndexSegments() {
+    SearchServer server("and"s);
+    SearchServer expected_server("and"s);
+    server.SetSegmentPolicy({2, 2});
+    for (int id = 0; id < 9; ++id) {
+        const string text = "cat "s + (id % 2 ? "dog"s : "parrot"s) + (id % 3 ? " and tail"s : " collar"s);
+        const auto status = id % 4 ? DocumentStatus::ACTUAL : DocumentStatus::BANNED;
+        server.AddDocument(id, text, status, {id});
+        expected_server.AddDocument(id, text, status, {id});
+    }
+
+    // Запечатано 4 сегмента по 2 документа, слияния 2+2, 2+2 и 4+4 оставляют сегмент из 8 и изменяемый.
+    const SegmentStats stats = server.GetSegmentStats();
+    ASSERT_EQUAL(stats.seal_count, 4u);
+    ASSERT_EQUAL(stats.merge_count, 3u);
+    ASSERT_EQUAL(stats.segment_count, 2u);
+
+    const auto check_same_results = [&server, &expected_server](const string& stage) {
+        for (const string& query: {"cat"s, "dog collar"s, "parrot -tail"s, "+collar cat"s}) {
+            for (const DocumentStatus status: {DocumentStatus::ACTUAL, DocumentStatus::BANNED}) {
+                const auto found_docs = server.FindTopDocuments(execution::par, query, status);
+                const auto expected_docs = expected_server.FindTopDocuments(query, status);
+                ASSERT_EQUAL_HINT(found_docs.size(), expected_docs.size(), stage);
+                for (size_t i = 0; i < found_docs.size(); ++i) {
+                    ASSERT_EQUAL_HINT(found_docs[i].id, expected_docs[i].id, stage);
+                    ASSERT_EQUAL_HINT(found_docs[i].relevance, expected_docs[i].relevance, stage);
+                }
+            }
+            ASSERT_HINT(get<0>(server.MatchDocument(query, 8)) == get<0>(expected_server.MatchDocument(query, 8)),
+                        stage);
+        }
+    };
+
+    check_same_results("Segmented index must rank documents with global IDF."s);
+    server.RemoveDocument(1);
+    expected_server.RemoveDocument(1);
+    check_same_results("Removal from a sealed segment must keep results exact."s);
+    server.SetSegmentPolicy({1, 2});
+    ASSERT_EQUAL(server.GetSegmentStats().seal_count, 5u);
+    check_same_results("Sealing must not change results."s);
+}
+
+void TestConcurrentSearchServer() {
+    {
+        EpochReclaimer reclaimer;
+        auto object = make_shared<const int>(42);
+        const weak_ptr<const int> watcher = object;
+        auto guard = reclaimer.Pin();
+        reclaimer.Retire(move(object));
+        ASSERT_EQUAL_HINT(reclaimer.Reclaim(), 0u, "Object must not be freed while an earlier reader is active."s);
+        ASSERT_HINT(!watcher.expired(), "Object must not be freed while an earlier reader is active."s);
+        guard = {};
+        ASSERT_EQUAL(reclaimer.Reclaim(), 1u);
+        ASSERT_HINT(watcher.expired(), "Object must be freed after the readers are done."s);
+    }
+
+    ConcurrentSearchServer server(SearchServer("and"s), 2);
+    server.AddDocument(1, "cat and dog"s, DocumentStatus::ACTUAL, {1});
+    ASSERT_EQUAL_HINT(server.GetSnapshot()->GetDocumentCount(), 0,
+                      "Changes must not be visible before publication."s);
+    server.AddDocument(2, "cat and parrot"s, DocumentStatus::ACTUAL, {2});
+    const auto snapshot = server.GetSnapshot();
+    ASSERT_EQUAL(snapshot->GetDocumentCount(), 2);
+
+    server.RemoveDocument(1);
+    server.AddDocument(3, "parrot"s, DocumentStatus::ACTUAL, {3});
+    server.Publish();
+    ASSERT_EQUAL(server.GetPublishCount(), 2u);
+    ASSERT_EQUAL_HINT(snapshot->FindTopDocuments("cat"s).size(), 2u, "Snapshot must not see later changes."s);
+    ASSERT_EQUAL(server.GetSnapshot()->FindTopDocuments("cat"s).size(), 1u);
+    ASSERT_EQUAL(server.GetSnapshot()->FindTopDocuments("parrot"s).size(), 2u);
+
+    // Читатели работают параллельно с писателем и видят только целые версии.
+    atomic<bool> done = false;
+    atomic<int> errors = 0;
+    vector<thread> readers;
+    for (int reader = 0; reader < 2; ++reader) {
+        readers.emplace_back([&server, &done, &errors] {
+            int document_count = 0;
+            while (!done) {
+                const auto current = server.GetSnapshot();
+                const auto found_docs = current->FindTopDocuments("bird"s);
+                if (current->GetDocumentCount() < document_count
+                    || found_docs.size() != min<size_t>(current->GetDocumentCount() - 2, MAX_RESULT_DOCUMENT_COUNT)) {
+                    ++errors;
+                }
+                document_count = current->GetDocumentCount();
+            }
+        });
+    }
+    for (int id = 10; id < 200; ++id) {
+        server.AddDocument(id, "bird and word"s + to_string(id), DocumentStatus::ACTUAL, {id});
+    }
+    server.Publish();
+    done = true;
+    for (auto& reader: readers) {
+        reader.join();
+    }
+    ASSERT_EQUAL(errors.load(), 0);
+    ASSERT_EQUAL(server.GetSnapshot()->GetDocumentCount(), 192);
+}
+
+void TestIndexSnapshot() {
+    const string path = (filesystem::temp_directory_path() / "ss_tests.snapshot"s).string();
+    SearchServer server("and in"s);
+    server.SetSegmentPolicy({3, 2});
+    server.SetPostingFormat(PostingFormat::COMPRESSED);
+    for (int id = 0; id < 400; ++id) {
+        const string text = "cat "s + (id % 2 ? "dog"s : "parrot"s) + (id % 3 ? " and tail"s : " collar"s)
+                            + " word"s + to_string(id % 17);
+        const auto status = id % 5 ? DocumentStatus::ACTUAL : DocumentStatus::BANNED;
+        server.AddDocument(id, text, status, {id % 7});
+    }
+    server.RemoveDocument(4);
+    server.RemoveDocument(399);
+    server.SaveSnapshot(path);
+
+    SearchServer loaded = SearchServer::LoadSnapshot(path);
+    const auto check_same_results = [&server, &loaded](const string& stage) {
+        ASSERT_EQUAL_HINT(loaded.GetDocumentCount(), server.GetDocumentCount(), stage);
+        ASSERT_HINT(vector<int>(loaded.begin(), loaded.end()) == vector<int>(server.begin(), server.end()), stage);
+        for (const string& query: {"cat"s, "dog collar word3"s, "parrot -tail"s, "+collar cat in"s, "word5"s}) {
+            for (const DocumentStatus status: {DocumentStatus::ACTUAL, DocumentStatus::BANNED}) {
+                const auto found_docs = loaded.FindTopDocuments(query, status, 50);
+                const auto expected_docs = server.FindTopDocuments(query, status, 50);
+                ASSERT_EQUAL_HINT(found_docs.size(), expected_docs.size(), stage);
+                for (size_t i = 0; i < found_docs.size(); ++i) {
+                    ASSERT_EQUAL_HINT(found_docs[i].id, expected_docs[i].id, stage);
+                    ASSERT_EQUAL_HINT(found_docs[i].relevance, expected_docs[i].relevance, stage);
+                    ASSERT_EQUAL_HINT(found_docs[i].rating, expected_docs[i].rating, stage);
+                }
+            }
+            ASSERT_HINT(loaded.MatchDocument(query, 10) == server.MatchDocument(query, 10), stage);
+        }
+        ASSERT_HINT(loaded.GetWordFrequencies(10) == server.GetWordFrequencies(10), stage);
+    };
+
+    check_same_results("Loaded snapshot must answer queries like the saved server."s);
+
+    for (SearchServer* target: {&server, &loaded}) {
+        target->AddDocument(1000, "cat and newword"s, DocumentStatus::ACTUAL, {1});
+        target->RemoveDocument(5);
+        target->CompactPostings();
+    }
+    check_same_results("Loaded snapshot must accept changes."s);
+    ASSERT_EQUAL(loaded.FindTopDocuments("newword"s).size(), 1u);
+
+    // Снимок, повреждённый внутри данных, отвергает сверка контрольной суммы.
+    loaded.SaveSnapshot(path);
+    ASSERT_EQUAL(SearchServer::LoadSnapshot(path, SnapshotVerification::CHECKSUM).GetDocumentCount(),
+                 loaded.GetDocumentCount());
+    {
+        fstream file(path, ios::in | ios::out | ios::binary);
+        file.seekp(100);
+        file.put('\xFF');
+    }
+    bool is_rejected = false;
+    try {
+        SearchServer::LoadSnapshot(path, SnapshotVerification::CHECKSUM);
+    } catch (const runtime_error&) {
+        is_rejected = true;
+    }
+    ASSERT_HINT(is_rejected, "Corrupted snapshot must be rejected."s);
+    filesystem::remove(path);
+}
+
+void TestSnapshotValidation() {
+    const string path = (filesystem::temp_directory_path() / "ss_tests_validation.snapshot"s).string();
+    PostingList postings(PostingFormat::COMPRESSED);
+    for (DocumentOrdinal ordinal = 0; ordinal < 300; ++ordinal) {
+        postings.Add(ordinal * 2, 1.0 + ordinal % 3);
+    }
+    {
+        SnapshotWriter writer(path);
+        postings.Save(writer);
+        IndexSegment segment(0, PostingFormat::COMPRESSED);
+        segment.GetPostings(5).Add(7, 1.0);
+        segment.Seal(10, vector<uint64_t>(1, 0)).Save(writer);
+        writer.Finish();
+    }
+
+    // Без сверки контрольной суммы загрузка всё равно отвергает номера за пределами диапазона сегмента
+    // и листы, которых нет в словаре.
+    const MappedFile snapshot(path);
+    const auto is_loaded = [&snapshot](DocumentOrdinal first_ordinal, DocumentOrdinal last_ordinal,
+                                       size_t list_count) {
+        SnapshotReader reader(snapshot.data(), snapshot.size(), SnapshotVerification::STRUCTURE);
+        try {
+            PostingList::Load(reader, first_ordinal, last_ordinal);
+            IndexSegment::Load(reader, list_count);
+        } catch (const runtime_error&) {
+            return false;
+        }
+        return true;
+    };
+    ASSERT(is_loaded(0, 600, 6));
+    ASSERT(!is_loaded(0, 500, 6));
+    ASSERT(!is_loaded(300, 600, 6));
+    ASSERT(!is_loaded(0, 600, 5));
+
+    SnapshotReader reader(snapshot.data(), snapshot.size(), SnapshotVerification::STRUCTURE);
+    const PostingList loaded = PostingList::Load(reader, 0, 600);
+    size_t count = 0;
+    for (PostingCursor cursor(loaded, 0, 600); !cursor.IsEnd(); cursor.Next(), ++count) {
+        ASSERT_EQUAL(cursor.GetOrdinal(), count * 2);
+        ASSERT_EQUAL(cursor.GetTermFreq(), 1.0 + count % 3);
+    }
+    ASSERT_EQUAL(count, 300u);
+    filesystem::remove(path);
+}
+
+void TestWriteAheadLog() {
+    const auto directory = filesystem::temp_directory_path();
+    const string snapshot_path = (directory / "ss_tests_wal.snapshot"s).string();
+    const string log_path = (directory / "ss_tests.wal"s).string();
+    filesystem::remove(log_path);
+
+    SearchServer expected_server("and"s);
+    {
+        ConcurrentSearchServer server(SearchServer("and"s), 1, make_unique<WriteAheadLog>(log_path));
+        const auto add_document = [&server, &expected_server](int id, const string& text) {
+            server.AddDocument(id, text, DocumentStatus::ACTUAL, {id});
+            expected_server.AddDocument(id, text, DocumentStatus::ACTUAL, {id});
+        };
+        add_document(1, "cat and dog"s);
+        add_document(2, "cat and parrot"s);
+        server.Checkpoint(snapshot_path);
+        ASSERT_HINT(WriteAheadLog::Read(log_path).empty(), "Checkpoint must reset the log."s);
+
+        add_document(3, "dog collar"s);
+        server.RemoveDocument(1);
+        expected_server.RemoveDocument(1);
+        const vector<DocumentData> batch = {{4, "parrot tail"sv, DocumentStatus::BANNED, {4}},
+                                            {1, "cat again"sv, DocumentStatus::ACTUAL, {5}}};
+        server.AddDocuments(execution::par, batch);
+        expected_server.AddDocuments(batch);
+        server.RemoveDocument(4);
+        expected_server.RemoveDocument(4);
+    }
+
+    // Оборванная при сбое запись в конце журнала отбрасывается.
+    {
+        ofstream log(log_path, ios::binary | ios::app);
+        log << "\x10\x00\x00"s;
+    }
+    ASSERT_EQUAL(WriteAheadLog::Read(log_path).size(), 5u);
+
+    SearchServer recovered = SearchServer::LoadSnapshot(snapshot_path);
+    ASSERT_EQUAL(ReplayLog(log_path, recovered), 5u);
+    ASSERT_EQUAL_HINT(ReplayLog(log_path, recovered), 0u, "Applied records must be skipped."s);
+    ASSERT_EQUAL(recovered.GetGeneration(), expected_server.GetGeneration());
+    ASSERT_HINT(vector<int>(recovered.begin(), recovered.end()) == vector<int>(expected_server.begin(),
+                                                                               expected_server.end()),
+                "Recovered server must contain the logged documents."s);
+    for (const string& query: {"cat"s, "dog -collar"s, "parrot"s}) {
+        for (const DocumentStatus status: {DocumentStatus::ACTUAL, DocumentStatus::BANNED}) {
+            const auto found_docs = recovered.FindTopDocuments(query, status);
+            const auto expected_docs = expected_server.FindTopDocuments(query, status);
+            ASSERT_EQUAL(found_docs.size(), expected_docs.size());
+            for (size_t i = 0; i < found_docs.size(); ++i) {
+                ASSERT_EQUAL(found_docs[i].id, expected_docs[i].id);
+                ASSERT_EQUAL(found_docs[i].relevance, expected_docs[i].relevance);
+                ASSERT_EQUAL(found_docs[i].rating, expected_docs[i].rating);
+            }
+        }
+    }
+
+    // Журнал продолжается с поколения восстановленного сервера.
+    {
+        ConcurrentSearchServer server(move(recovered), 1, make_unique<WriteAheadLog>(log_path));
+        server.AddDocument(6, "bird"s, DocumentStatus::ACTUAL, {6});
+    }
+    SearchServer restarted = SearchServer::LoadSnapshot(snapshot_path);
+    ASSERT_EQUAL(ReplayLog(log_path, restarted), 6u);
+    ASSERT_EQUAL(restarted.FindTopDocuments("bird"s).size(), 1u);
+
+    // Пакет, оборванный сбоем, отбрасывается целиком, и журнал продолжается с записи перед ним.
+    filesystem::remove(log_path);
+    {
+        ConcurrentSearchServer server(SearchServer("and"s), 1, make_unique<WriteAheadLog>(log_path));
+        server.AddDocument(10, "first"s, DocumentStatus::ACTUAL, {1});
+        server.AddDocuments(execution::seq, vector<DocumentData>{{11, "second"sv, DocumentStatus::ACTUAL, {1}},
+                                                                 {12, "third"sv, DocumentStatus::ACTUAL, {1}}});
+    }
+    ASSERT_EQUAL(WriteAheadLog::Read(log_path).size(), 3u);
+    filesystem::resize_file(log_path, filesystem::file_size(log_path) - 1);
+    ASSERT_EQUAL(WriteAheadLog::Read(log_path).size(), 1u);
+    SearchServer torn("and"s);
+    ASSERT_EQUAL(ReplayLog(log_path, torn), 1u);
+    ASSERT_EQUAL(torn.GetDocumentCount(), 1);
+    {
+        WriteAheadLog log(log_path);
+        log.Append({2, LogRecord::Type::ADD, 13, DocumentStatus::ACTUAL, {1}, "fourth"s});
+        log.Sync(2);
+    }
+    ASSERT_EQUAL(ReplayLog(log_path, torn), 1u);
+    ASSERT_EQUAL(torn.FindTopDocuments("fourth"s).size(), 1u);
+
+    // Неудачная синхронизация останавливает сервер: изменение не публикуется, дальнейшие изменения отклоняются.
+    filesystem::remove(log_path);
+    {
+        ConcurrentSearchServer server(SearchServer("and"s), 1, make_unique<WriteAheadLog>(log_path));
+        server.AddDocument(1, "cat"s, DocumentStatus::ACTUAL, {1});
+
+        // Запись за ограничением размера файла не удаётся с EFBIG.
+        rlimit file_size_limit;
+        getrlimit(RLIMIT_FSIZE, &file_size_limit);
+        const rlimit lowered_limit = {static_cast<rlim_t>(filesystem::file_size(log_path)), file_size_limit.rlim_max};
+        const auto previous_handler = signal(SIGXFSZ, SIG_IGN);
+        setrlimit(RLIMIT_FSIZE, &lowered_limit);
+        const auto throws = [](const auto& action) {
+            try {
+                action();
+            } catch (const runtime_error&) {
+                return true;
+            }
+            return false;
+        };
+        const bool is_add_rejected = throws([&server] {
+            server.AddDocument(2, "dog"s, DocumentStatus::ACTUAL, {1});
+        });
+        setrlimit(RLIMIT_FSIZE, &file_size_limit);
+        signal(SIGXFSZ, previous_handler);
+
+        ASSERT(is_add_rejected);
+        ASSERT(server.GetSnapshot()->FindTopDocuments("dog"s).empty());
+        ASSERT(throws([&server] {
+            server.AddDocument(3, "parrot"s, DocumentStatus::ACTUAL, {1});
+        }));
+        ASSERT(throws([&server] {
+            server.Publish();
+        }));
+        ASSERT(throws([&server, &snapshot_path] {
+            server.Checkpoint(snapshot_path);
+        }));
+        ASSERT(server.GetSnapshot()->FindTopDocuments("dog"s).empty());
+        ASSERT_EQUAL(server.GetSnapshot()->GetDocumentCount(), 1);
+    }
+    ASSERT_EQUAL(WriteAheadLog::Read(log_path).size(), 1u);
+
+    filesystem::remove(snapshot_path);
+    filesystem::remove(log_path);
+}
+
+void TestForwardIndex() {
+    SearchServer server("and"s);
+    const int document_count = static_cast<int>(ForwardIndex::BLOCK_SIZE) + 10;
+    for (int id = 0; id < document_count; ++id) {
+        server.AddDocument(id, "cat cat and dog word"s + to_string(id % 3), DocumentStatus::ACTUAL, {1});
+    }
+    const auto get_word_freqs = [](const SearchServer& search_server, int document_id) {
+        const WordFrequencies word_freqs = search_server.GetWordFrequencies(document_id);
+        return map<string_view, double>(word_freqs.begin(), word_freqs.end());
+    };
+    const map<string_view, double> expected_word_freqs = {{"cat"sv, 0.5}, {"dog"sv, 0.25}, {"word1"sv, 0.25}};
+    ASSERT(get_word_freqs(server, 7) == expected_word_freqs);
+    ASSERT(get_word_freqs(server, document_count - 4) == expected_word_freqs);
+    ASSERT_EQUAL(*server.GetWordFrequencies(7).Find("cat"s), 0.5);
+    ASSERT(!server.GetWordFrequencies(7).Find("and"s));
+    ASSERT(!server.GetWordFrequencies(7).Find("word2"s));
+
+    // Копия делит блоки прямого индекса, но не видит изменений оригинала.
+    const SearchServer copy = server;
+    server.AddDocument(document_count, "cat parrot"s, DocumentStatus::ACTUAL, {1});
+    server.RemoveDocument(7);
+    server.RemoveDocument(document_count - 4);
+    server.CompactPostings();
+    ASSERT(get_word_freqs(copy, 7) == expected_word_freqs);
+    ASSERT(get_word_freqs(copy, document_count - 4) == expected_word_freqs);
+    ASSERT(copy.GetWordFrequencies(document_count).empty());
+    ASSERT(server.GetWordFrequencies(7).empty());
+    ASSERT(get_word_freqs(server, 10) == expected_word_freqs);
+    ASSERT_EQUAL(server.GetWordFrequencies(document_count).size(), 2u);
+    ASSERT(get<0>(server.MatchDocument("parrot dog"s, document_count)) == vector<string_view>{"parrot"sv});
+    ASSERT(get<0>(server.MatchDocument(execution::par, "+word1 dog"s, 10))
+           == (vector<string_view>{"dog"sv, "word1"sv}));
+
+    // Дубликаты - документы с тем же набором слов; остаётся документ с наименьшим id.
+    SearchServer duplicates("and"s);
+    duplicates.AddDocument(1, "cat dog"s, DocumentStatus::ACTUAL, {1});
+    duplicates.AddDocument(2, "dog cat cat"s, DocumentStatus::ACTUAL, {1});
+    duplicates.AddDocument(3, "cat and parrot"s, DocumentStatus::ACTUAL, {1});
+    duplicates.AddDocument(4, "dog and cat"s, DocumentStatus::BANNED, {1});
+    duplicates.AddDocument(5, "parrot cat"s, DocumentStatus::ACTUAL, {1});
+    RemoveDuplicates(duplicates);
+    ASSERT(vector<int>(duplicates.begin(), duplicates.end()) == (vector<int>{1, 3}));
+}
+
+void TestWordTokenizer() {
+    // Эталон: слова между пробелами и признак управляющего символа в слове, побайтно.
+    const auto split_naive = [](string_view text) {
+        vector<pair<string_view, bool>> words;
+        size_t begin = 0;
+        while (begin < text.size()) {
+            if (text[begin] == ' ') {
+                ++begin;
+                continue;
+            }
+            size_t end = begin;
+            bool has_forbidden_chars = false;
+            while (end < text.size() && text[end] != ' ') {
+                has_forbidden_chars = has_forbidden_chars || static_cast<unsigned char>(text[end]) < ' ';
+                ++end;
+            }
+            words.emplace_back(text.substr(begin, end - begin), has_forbidden_chars);
+            begin = end;
+        }
+        return words;
+    };
+    const auto split = [](string_view text) {
+        vector<pair<string_view, bool>> words;
+        for (WordTokenizer tokenizer(text); tokenizer.Next();) {
+            words.emplace_back(tokenizer.GetWord(), tokenizer.HasForbiddenChars());
+        }
+        return words;
+    };
+
+    // Слова на границах блоков, длиннее блока, пробелы по краям и байты со старшим битом.
+    vector<string> texts = {""s, " "s, "cat"s, "  cat  dog "s, string(63, 'a') + " b"s, string(64, 'a') + " b"s,
+                            string(63, ' ') + "ab"s, string(200, 'x'), "\xD0\xBA\xD1\x82 \x7F\x80"s,
+                            "cat\tdog"s, string(70, 'a') + '\x01' + string(70, 'b') + " ok"s, "\x1F"s, "a\0b"s};
+    uint32_t seed = 42;
+    for (int i = 0; i < 300; ++i) {
+        string text;
+        for (int length = i % 150; length > 0; --length) {
+            seed = seed * 1103515245 + 12345;
+            const uint32_t kind = (seed >> 16) % 16;
+            text += kind < 4 ? ' ' : kind == 4 ? static_cast<char>((seed >> 8) % 32) : static_cast<char>('a' + kind);
+        }
+        texts.push_back(text);
+    }
+    for (const string& text: texts) {
+        ASSERT_HINT(split(text) == split_naive(text), text);
+    }
+
+    ASSERT(SplitIntoWordsView("  young cat  "s) == (vector<string_view>{"young"sv, "cat"sv}));
+    ASSERT(SplitIntoWords(" a b "s) == (vector<string>{"a"s, "b"s}));
+    ASSERT(HasForbiddenChars("ca\x1Ft"s));
+    ASSERT(!HasForbiddenChars("\xD0\xBA\x7F"s));
+}
+
+namespace {
+
+constexpr auto TEST_STOP_WORDS = MakeStaticStopWordFilter("a", "and", "in", "of", "the", "with", "\xD0\xB8");
+
+// Таблица строится при компиляции.
+static_assert(TEST_STOP_WORDS.Contains("and"));
+static_assert(TEST_STOP_WORDS.Contains("\xD0\xB8"));
+static_assert(!TEST_STOP_WORDS.Contains("an"));
+static_assert(!TEST_STOP_WORDS.Contains("ant"));
+static_assert(!TEST_STOP_WORDS.Contains(""));
+
+} // namespace
+
+void TestStopWordFilter() {
+    vector<string> words;
+    for (int i = 0; i < 1000; ++i) {
+        words.push_back("w"s + to_string(i * 7919 % 100003));
+    }
+    vector<string> source_words = words;
+    source_words.push_back(words[10]);
+    source_words.push_back(""s);
+    const StopWordFilter filter(source_words);
+    ASSERT_EQUAL(filter.size(), words.size());
+    for (const string& word: words) {
+        ASSERT_HINT(filter.Contains(word), word);
+    }
+    // Те же длины и первые байты проходят быстрый отсев, но слов нет в таблице.
+    for (int i = 1000; i < 3000; ++i) {
+        const string word = "w"s + to_string(i * 7919 % 100003);
+        ASSERT_HINT(!filter.Contains(word), word);
+    }
+    ASSERT(!filter.Contains(""s));
+    ASSERT(!StopWordFilter().Contains("w1"s));
+    ASSERT(vector<string_view>(filter.begin(), filter.end()).size() == words.size());
+
+    // Сервер со стоп-словами, зашитыми в программу, и с теми же словами строкой разбирает тексты одинаково.
+    SearchServer static_server{StopWordFilter(TEST_STOP_WORDS)};
+    SearchServer server("a and in of the with \xD0\xB8"s);
+    for (SearchServer* target: {&static_server, &server}) {
+        target->AddDocument(1, "cat in the city"s, DocumentStatus::ACTUAL, {1});
+        target->AddDocument(2, "dog with a collar"s, DocumentStatus::ACTUAL, {1});
+        ASSERT(target->GetWordFrequencies(1).size() == 2u);
+        ASSERT(target->FindTopDocuments("the and in"s).empty());
+        ASSERT(get<0>(target->MatchDocument("dog with collar"s, 2)) == (vector<string_view>{"collar"sv, "dog"sv}));
+    }
+
+    bool is_rejected = false;
+    try {
+        SearchServer invalid_server{StopWordFilter(vector<string>{"in"s, "o\x01f"s})};
+    } catch (const invalid_argument&) {
+        is_rejected = true;
+    }
+    ASSERT_HINT(is_rejected, "Stop words with forbidden characters must be rejected."s);
+}
+
+void TestSmallVector() {
+    SmallVector<int, 4> values;
+    for (const int value: {5, 3, 5, 1}) {
+        values.push_back(value);
+    }
+    ASSERT(values.IsInline());
+    ASSERT(vector<int>(values.begin(), values.end()) == (vector<int>{5, 3, 5, 1}));
+
+    // Пятый элемент переносит все в кучу.
+    values.push_back(3);
+    ASSERT(!values.IsInline());
+    sort(values.begin(), values.end());
+    values.erase(unique(values.begin(), values.end()), values.end());
+    ASSERT(vector<int>(values.begin(), values.end()) == (vector<int>{1, 3, 5}));
+
+    const SmallVector<int, 4> copy = values;
+    SmallVector<int, 4> moved = move(values);
+    ASSERT(vector<int>(copy.begin(), copy.end()) == (vector<int>{1, 3, 5}));
+    ASSERT(vector<int>(moved.begin(), moved.end()) == (vector<int>{1, 3, 5}));
+    ASSERT(values.empty() && values.IsInline());
+    for (int value = 0; value < 10; ++value) {
+        values.push_back(value);
+    }
+    ASSERT_EQUAL(values.size(), 10u);
+    ASSERT_EQUAL(values[9], 9);
+
+    // Повторы слов запроса не меняют ни релевантность, ни совпавшие слова.
+    SearchServer server("and"s);
+    server.AddDocument(1, "cat dog"s, DocumentStatus::ACTUAL, {1});
+    server.AddDocument(2, "cat parrot"s, DocumentStatus::ACTUAL, {1});
+    const auto found_docs = server.FindTopDocuments("dog cat dog -parrot -parrot"s);
+    const auto par_found_docs = server.FindTopDocuments(execution::par, "cat dog -parrot"s);
+    ASSERT_EQUAL(found_docs.size(), 1u);
+    ASSERT_EQUAL(par_found_docs.size(), 1u);
+    ASSERT_EQUAL(found_docs[0].relevance, par_found_docs[0].relevance);
+    ASSERT(get<0>(server.MatchDocument(execution::par, "dog cat dog and +cat"s, 1))
+           == (vector<string_view>{"cat"sv, "dog"sv}));
+}
+
+void TestResultCache() {
+    SearchServer server("and"s);
+    server.AddDocument(1, "white cat"s, DocumentStatus::ACTUAL, {1});
+    server.AddDocument(2, "black cat"s, DocumentStatus::ACTUAL, {2});
+    server.AddDocument(3, "black dog"s, DocumentStatus::BANNED, {3});
+    server.SetResultCacheCapacity(64);
+
+    // Запросы с теми же словами в другом порядке и с повторами - один ключ.
+    const auto found_docs = server.FindTopDocuments("cat black -dog"s);
+    ASSERT_EQUAL(found_docs.size(), 2u);
+    const auto cached_docs = server.FindTopDocuments(execution::par, "-dog black cat and cat"s);
+    ASSERT_EQUAL(cached_docs.size(), 2u);
+    ASSERT_EQUAL(cached_docs[0].id, found_docs[0].id);
+    ASSERT_EQUAL(cached_docs[0].relevance, found_docs[0].relevance);
+    ResultCacheStats stats = server.GetResultCacheStats();
+    ASSERT_EQUAL(stats.hits, 1u);
+    ASSERT_EQUAL(stats.misses, 1u);
+    ASSERT_EQUAL(stats.entry_count, 1u);
+    ASSERT(stats.memory_usage > 0);
+
+    // Статус и число документов входят в ключ, произвольный предикат кэш обходит.
+    ASSERT_EQUAL(server.FindTopDocuments("cat black -dog"s, DocumentStatus::BANNED).size(), 0u);
+    ASSERT_EQUAL(server.FindTopDocuments("cat black -dog"s, DocumentStatus::ACTUAL, 1).size(), 1u);
+    server.FindTopDocuments("cat"s, [](int, DocumentStatus, int) { return true; });
+    stats = server.GetResultCacheStats();
+    ASSERT_EQUAL(stats.hits + stats.misses, 4u);
+    ASSERT_EQUAL(stats.entry_count, 3u);
+
+    // Изменение индекса делает записи устаревшими.
+    server.AddDocument(4, "black cat"s, DocumentStatus::ACTUAL, {4});
+    ASSERT_EQUAL(server.FindTopDocuments("black cat -dog"s).size(), 3u);
+    server.RemoveDocument(4);
+    ASSERT_EQUAL(server.FindTopDocuments("black cat -dog"s).size(), 2u);
+    stats = server.GetResultCacheStats();
+    ASSERT_EQUAL(stats.invalidations, 2u);
+    ASSERT_EQUAL(stats.hits, 1u);
+
+    // Копия получает пустой кэш той же ёмкости.
+    const SearchServer copy = server;
+    ASSERT_EQUAL(copy.GetResultCacheStats().entry_count, 0u);
+    copy.FindTopDocuments("cat"s);
+    ASSERT_EQUAL(copy.GetResultCacheStats().entry_count, 1u);
+
+    // В полный кэш однократные запросы не вытесняют записи, повторный запрос вытесняет давнюю запись.
+    QueryResultCache cache(2, 1);
+    const vector<Document> documents = {{1, 0.5, 1}};
+    for (uint32_t i = 0; i < 3; ++i) {
+        QueryResultCache::Key key;
+        key.push_back(i);
+        ASSERT(!cache.Find(key, 0));
+        cache.Insert(key, 0, documents);
+    }
+    stats = cache.GetStats();
+    ASSERT_EQUAL(stats.entry_count, 2u);
+    ASSERT_EQUAL(stats.rejections, 1u);
+    QueryResultCache::Key key;
+    key.push_back(2);
+    ASSERT(!cache.Find(key, 0));
+    cache.Insert(key, 0, documents);
+    ASSERT_EQUAL(cache.GetStats().evictions, 1u);
+    const auto cached = cache.Find(key, 0);
+    ASSERT(cached && cached->size() == 1u && (*cached)[0].id == 1);
+
+    // Параллельные запросы делят кэш и получают те же результаты, что и без него.
+    SearchServer cached_server("and with"s);
+    for (int id = 0; id < 200; ++id) {
+        cached_server.AddDocument(id, "pet "s + to_string(id % 7) + " cat "s + to_string(id % 11),
+                                  DocumentStatus::ACTUAL, {id});
+    }
+    vector<string> queries;
+    for (int i = 0; i < 400; ++i) {
+        queries.push_back("pet "s + to_string(i % 13) + " -"s + to_string(i % 5));
+    }
+    const auto expected = ProcessQueries(cached_server, queries);
+    cached_server.SetResultCacheCapacity(8);
+    const auto actual = ProcessQueries(cached_server, queries);
+    ASSERT_EQUAL(actual.size(), expected.size());
+    for (size_t i = 0; i < expected.size(); ++i) {
+        ASSERT_EQUAL(actual[i].size(), expected[i].size());
+        for (size_t j = 0; j < expected[i].size(); ++j) {
+            ASSERT_EQUAL(actual[i][j].id, expected[i][j].id);
+        }
+    }
+    stats = cached_server.GetResultCacheStats();
+    ASSERT_EQUAL(stats.hits + stats.misses, queries.size());
+    ASSERT(stats.hits > 0);
+    ASSERT(stats.entry_count <= 8u);
+}
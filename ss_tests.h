@@ -32,4 +32,56 @@ void TestPredicate();
 
 void TestDocumentStatusFilter();
 
-void TestRelevanceCalculation();
\ No newline at end of file
+void TestRelevanceCalculation();
+
+void TestPostingList();
+
+void TestTermDictionary();
+
+void TestDocumentTable();
+
+void TestTopDocumentsCount();
+
+void TestScoreAccumulator();
+
+void TestParallelSearch();
+
+void TestMaxScoreEvaluation();
+
+void TestPostingBlockMaxTermFreqs();
+
+void TestCompressedPostingList();
+
+void TestRequiredWords();
+
+void TestPostingIntersection();
+
+void TestMinusWordBitmaps();
+
+void TestStatusPartitions();
+
+void TestCachedInverseDocumentFreqs();
+
+void TestAddDocumentsBatch();
+
+void TestRemovedDocumentCompaction();
+
+void TestIndexSegments();
+
+void TestConcurrentSearchServer();
+
+void TestIndexSnapshot();
+
+void TestSnapshotValidation();
+
+void TestWriteAheadLog();
+
+void TestForwardIndex();
+
+void TestWordTokenizer();
+
+void TestStopWordFilter();
+
+void TestSmallVector();
+
+void TestResultCache();
@@ -0,0 +1,41 @@
+#include "stop_word_filter.h"
+
+#include <algorithm>
+
+using namespace std;
+
+bool StopWordFilter::Contains(string_view word) const {
+    return table_.Contains(word);
+}
+
+size_t StopWordFilter::size() const {
+    return table_.size;
+}
+
+const string_view* StopWordFilter::begin() const {
+    return table_.slots;
+}
+
+const string_view* StopWordFilter::end() const {
+    return table_.slots + table_.size;
+}
+
+void StopWordFilter::Build(vector<string> words) {
+    sort(words.begin(), words.end());
+    words.erase(unique(words.begin(), words.end()), words.end());
+
+    auto storage = make_shared<Storage>();
+    // Слоты ссылаются на строки хранилища, поэтому таблица строится после того, как они заняли своё место.
+    storage->words = move(words);
+    const vector<string_view> word_views(storage->words.begin(), storage->words.end());
+    storage->slots.resize(word_views.size());
+    storage->displacements.resize(word_views.size());
+    vector<size_t> bucket_sizes(word_views.size());
+    BuildStopWordTable(word_views, storage->slots, storage->displacements, bucket_sizes);
+
+    table_ = {storage->slots.data(), storage->displacements.data(), storage->slots.size(), {}};
+    for (const string_view word: word_views) {
+        table_.masks.Add(word);
+    }
+    storage_ = move(storage);
+}
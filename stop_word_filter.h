@@ -0,0 +1,218 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Быстрый отсев слов, которых заведомо нет среди стоп-слов: по длине и первому байту.
+struct StopWordMasks {
+    // Бит min(длина, 63) - есть слово такой длины.
+    uint64_t length_mask = 0;
+    // Бит b - есть слово с первым байтом b.
+    std::array<uint64_t, 4> first_byte_mask = {};
+
+    constexpr void Add(std::string_view word) {
+        const auto first_byte = static_cast<unsigned char>(word[0]);
+        length_mask |= uint64_t{1} << (word.size() < 63 ? word.size() : 63);
+        first_byte_mask[first_byte / 64] |= uint64_t{1} << (first_byte % 64);
+    }
+
+    constexpr bool MayContain(std::string_view word) const {
+        if (word.empty()) {
+            return false;
+        }
+        const auto first_byte = static_cast<unsigned char>(word[0]);
+        return ((length_mask >> (word.size() < 63 ? word.size() : 63)) & 1)
+               && ((first_byte_mask[first_byte / 64] >> (first_byte % 64)) & 1);
+    }
+};
+
+// Таблица стоп-слов с поиском по минимальному совершенному хешу: n различных слов лежат в n слотах,
+// по одному в слоте. Слово относится к корзине Hash(word, 0) % n. Неотрицательное смещение d корзины
+// даёт слот Hash(word, d + 1) % n, отрицательное указывает слот единственного слова корзины: -d - 1.
+// Поиск - одно или два хеширования и одно сравнение строк.
+struct StopWordTable {
+    const std::string_view* slots = nullptr;
+    const int32_t* displacements = nullptr;
+    size_t size = 0;
+    StopWordMasks masks;
+
+    static constexpr uint64_t Hash(std::string_view word, uint64_t seed) {
+        uint64_t hash = 0xCBF29CE484222325ull ^ (seed * 0x9E3779B97F4A7C15ull);
+        for (const char c: word) {
+            hash = (hash ^ static_cast<unsigned char>(c)) * 0x100000001B3ull;
+        }
+        return hash ^ (hash >> 32);
+    }
+
+    constexpr bool Contains(std::string_view word) const {
+        if (size == 0 || !masks.MayContain(word)) {
+            return false;
+        }
+        const int32_t displacement = displacements[Hash(word, 0) % size];
+        const size_t slot = displacement < 0 ? static_cast<size_t>(-(displacement + 1))
+                                             : Hash(word, static_cast<uint64_t>(displacement) + 1) % size;
+        return slots[slot] == word;
+    }
+};
+
+// Раскладывает n = words.size() различных непустых слов по слотам таблицы. slots, displacements и рабочий
+// массив bucket_sizes - по n элементов; слоты должны быть пустыми, смещения и размеры корзин - нулевыми.
+// Корзины раскладываются от больших к меньшим: для корзины подбирается смещение, при котором все её слова
+// попадают в свободные слоты, а корзины из одного слова занимают оставшиеся слоты напрямую.
+template<typename Words, typename Slots, typename Displacements, typename BucketSizes>
+constexpr void BuildStopWordTable(const Words& words, Slots& slots, Displacements& displacements,
+                                  BucketSizes& bucket_sizes) {
+    using namespace std::literals::string_literals;
+    const size_t n = words.size();
+    size_t max_bucket_size = 0;
+
+    for (size_t i = 0; i < n; ++i) {
+        if (words[i].empty()) {
+            throw std::invalid_argument("Empty stop word"s);
+        }
+        const size_t bucket = StopWordTable::Hash(words[i], 0) % n;
+        ++bucket_sizes[bucket];
+        max_bucket_size = bucket_sizes[bucket] > max_bucket_size ? bucket_sizes[bucket] : max_bucket_size;
+    }
+
+    for (size_t bucket_size = max_bucket_size; bucket_size >= 2; --bucket_size) {
+        for (size_t bucket = 0; bucket < n; ++bucket) {
+            if (bucket_sizes[bucket] != bucket_size) {
+                continue;
+            }
+            for (uint64_t displacement = 0;; ++displacement) {
+                // Слова корзины занимают слоты по очереди; при столкновении занятые слоты освобождаются.
+                size_t placed = 0;
+                bool is_placed = true;
+                for (size_t i = 0; i < n && is_placed; ++i) {
+                    if (StopWordTable::Hash(words[i], 0) % n != bucket) {
+                        continue;
+                    }
+                    auto& slot = slots[StopWordTable::Hash(words[i], displacement + 1) % n];
+                    if (!slot.empty()) {
+                        if (slot == words[i]) {
+                            throw std::invalid_argument("Duplicate stop word"s);
+                        }
+                        is_placed = false;
+                    } else {
+                        slot = words[i];
+                        ++placed;
+                    }
+                }
+                if (is_placed) {
+                    displacements[bucket] = static_cast<int32_t>(displacement);
+                    break;
+                }
+                for (size_t i = 0; i < n && placed > 0; ++i) {
+                    auto& slot = slots[StopWordTable::Hash(words[i], displacement + 1) % n];
+                    if (StopWordTable::Hash(words[i], 0) % n == bucket && slot == words[i]) {
+                        slot = {};
+                        --placed;
+                    }
+                }
+            }
+        }
+    }
+
+    size_t free_slot = 0;
+
+    for (size_t i = 0; i < n; ++i) {
+        const size_t bucket = StopWordTable::Hash(words[i], 0) % n;
+        if (bucket_sizes[bucket] != 1) {
+            continue;
+        }
+        while (!slots[free_slot].empty()) {
+            ++free_slot;
+        }
+        slots[free_slot] = words[i];
+        displacements[bucket] = -static_cast<int32_t>(free_slot) - 1;
+    }
+}
+
+// Стоп-слова, зашитые в программу. Если фильтр объявлен constexpr, таблица строится при компиляции
+// и не использует кучу. Слова должны быть различными и непустыми.
+template<size_t N>
+class StaticStopWordFilter {
+public:
+    constexpr explicit StaticStopWordFilter(const std::array<std::string_view, N>& words) {
+        std::array<size_t, N> bucket_sizes = {};
+        BuildStopWordTable(words, slots_, displacements_, bucket_sizes);
+        for (const std::string_view word: words) {
+            masks_.Add(word);
+        }
+    }
+
+    constexpr StopWordTable GetTable() const {
+        return {slots_.data(), displacements_.data(), N, masks_};
+    }
+
+    constexpr bool Contains(std::string_view word) const {
+        return GetTable().Contains(word);
+    }
+
+private:
+    std::array<std::string_view, N> slots_ = {};
+    std::array<int32_t, N> displacements_ = {};
+    StopWordMasks masks_;
+};
+
+template<typename... Words>
+constexpr StaticStopWordFilter<sizeof...(Words)> MakeStaticStopWordFilter(const Words&... words) {
+    return StaticStopWordFilter<sizeof...(Words)>({std::string_view(words)...});
+}
+
+// Стоп-слова сервера: таблица строится по словам, скопированным в кучу, или ссылается на таблицу
+// StaticStopWordFilter. Фильтр не меняется после построения, копии делят таблицу.
+class StopWordFilter {
+public:
+    StopWordFilter() = default;
+
+    // Пустые слова пропускаются, повторы учитываются один раз.
+    template<typename StringContainer>
+    explicit StopWordFilter(const StringContainer& words);
+
+    // Таблица filter не копируется и должна пережить фильтр, например быть constexpr-переменной.
+    template<size_t N>
+    explicit StopWordFilter(const StaticStopWordFilter<N>& filter) : table_(filter.GetTable()) {
+    }
+
+    bool Contains(std::string_view word) const;
+
+    size_t size() const;
+
+    // Слова в порядке слотов таблицы.
+    const std::string_view* begin() const;
+
+    const std::string_view* end() const;
+
+private:
+    struct Storage {
+        std::vector<std::string> words;
+        std::vector<std::string_view> slots;
+        std::vector<int32_t> displacements;
+    };
+
+    std::shared_ptr<const Storage> storage_;
+    StopWordTable table_;
+
+    void Build(std::vector<std::string> words);
+};
+
+template<typename StringContainer>
+StopWordFilter::StopWordFilter(const StringContainer& words) {
+    std::vector<std::string> non_empty_words;
+
+    for (const auto& word: words) {
+        if (!std::string_view(word).empty()) {
+            non_empty_words.emplace_back(word);
+        }
+    }
+
+    Build(std::move(non_empty_words));
+}
@@ -1,17 +1,180 @@
 #include "string_processing.h"
+#include <cstring>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#include <immintrin.h>
+#define STRING_PROCESSING_SIMD
+#endif
 
 using namespace std;
 
-vector<string> SplitIntoWords(string_view str) {
+namespace {
+
+const char MAX_FORBIDDEN_CHAR = 31;
+
+#ifdef STRING_PROCESSING_SIMD
+
+// SSE2 входит в базовый набор x86-64 и доступен без проверки процессора.
+void BuildMasksSse2(const char* data, uint64_t& space_mask, uint64_t& forbidden_mask) {
+    space_mask = 0;
+    forbidden_mask = 0;
+    const __m128i spaces = _mm_set1_epi8(' ');
+    const __m128i max_forbidden = _mm_set1_epi8(MAX_FORBIDDEN_CHAR);
+
+    for (size_t offset = 0; offset < 64; offset += 16) {
+        const __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + offset));
+        // Байт не больше 31 без знака совпадает со своим минимумом с 31.
+        const __m128i forbidden = _mm_cmpeq_epi8(_mm_min_epu8(chunk, max_forbidden), chunk);
+        space_mask |= uint64_t{static_cast<uint16_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, spaces)))} << offset;
+        forbidden_mask |= uint64_t{static_cast<uint16_t>(_mm_movemask_epi8(forbidden))} << offset;
+    }
+}
+
+__attribute__((target("avx2")))
+void BuildMasksAvx2(const char* data, uint64_t& space_mask, uint64_t& forbidden_mask) {
+    space_mask = 0;
+    forbidden_mask = 0;
+    const __m256i spaces = _mm256_set1_epi8(' ');
+    const __m256i max_forbidden = _mm256_set1_epi8(MAX_FORBIDDEN_CHAR);
+
+    for (size_t offset = 0; offset < 64; offset += 32) {
+        const __m256i chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + offset));
+        const __m256i forbidden = _mm256_cmpeq_epi8(_mm256_min_epu8(chunk, max_forbidden), chunk);
+        space_mask |= uint64_t{static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(chunk, spaces)))}
+                      << offset;
+        forbidden_mask |= uint64_t{static_cast<uint32_t>(_mm256_movemask_epi8(forbidden))} << offset;
+    }
+}
+
+#else
+
+void BuildMasksScalar(const char* data, uint64_t& space_mask, uint64_t& forbidden_mask) {
+    space_mask = 0;
+    forbidden_mask = 0;
+
+    for (size_t offset = 0; offset < 64; ++offset) {
+        const auto c = static_cast<unsigned char>(data[offset]);
+        space_mask |= uint64_t{c == ' '} << offset;
+        forbidden_mask |= uint64_t{c <= MAX_FORBIDDEN_CHAR} << offset;
+    }
+}
+
+#endif
+
+// Маски пробелов и управляющих символов для 64 байт data: бит i соответствует байту data[i].
+void BuildMasks(const char* data, uint64_t& space_mask, uint64_t& forbidden_mask) {
+#ifdef STRING_PROCESSING_SIMD
+    static const bool has_avx2 = __builtin_cpu_supports("avx2");
+    if (has_avx2) {
+        BuildMasksAvx2(data, space_mask, forbidden_mask);
+    } else {
+        BuildMasksSse2(data, space_mask, forbidden_mask);
+    }
+#else
+    BuildMasksScalar(data, space_mask, forbidden_mask);
+#endif
+}
+
+size_t CountTrailingZeros(uint64_t mask) {
+    return static_cast<size_t>(__builtin_ctzll(mask));
+}
+
+// Биты с номерами не меньше offset; offset < 64.
+uint64_t GetBitsFrom(size_t offset) {
+    return ~uint64_t{0} << offset;
+}
+
+} // namespace
+
+WordTokenizer::WordTokenizer(string_view text) : text_(text) {
+
+    if (!text_.empty()) {
+        LoadBlock(0);
+    }
+}
+
+bool WordTokenizer::Next() {
+    uint64_t word_begins = 0;
+
+    // Начало слова - первый байт, не являющийся пробелом.
+    while (true) {
+        if (position_ >= text_.size()) {
+            return false;
+        }
+        if (position_ - block_begin_ == BLOCK_SIZE) {
+            LoadBlock(position_);
+        }
+        word_begins = ~space_mask_ & GetBitsFrom(position_ - block_begin_);
+        if (word_begins) {
+            break;
+        }
+        position_ = block_begin_ + BLOCK_SIZE;
+    }
+
+    const size_t begin = block_begin_ + CountTrailingZeros(word_begins);
+    size_t offset = begin - block_begin_;
+    size_t end = 0;
+    uint64_t forbidden = 0;
+
+    // Конец слова - первый пробел после начала или конец текста.
+    while (true) {
+        const uint64_t word_ends = space_mask_ & GetBitsFrom(offset);
+        if (word_ends) {
+            const size_t end_offset = CountTrailingZeros(word_ends);
+            forbidden |= forbidden_mask_ & GetBitsFrom(offset) & ~GetBitsFrom(end_offset);
+            end = block_begin_ + end_offset;
+            break;
+        }
+        forbidden |= forbidden_mask_ & GetBitsFrom(offset);
+        if (block_begin_ + BLOCK_SIZE >= text_.size()) {
+            end = text_.size();
+            break;
+        }
+        LoadBlock(block_begin_ + BLOCK_SIZE);
+        offset = 0;
+    }
+
+    word_ = text_.substr(begin, end - begin);
+    has_forbidden_chars_ = forbidden != 0;
+    position_ = end;
+
+    return true;
+}
+
+string_view WordTokenizer::GetWord() const {
+    return word_;
+}
+
+bool WordTokenizer::HasForbiddenChars() const {
+    return has_forbidden_chars_;
+}
+
+void WordTokenizer::LoadBlock(size_t block_begin) {
+    block_begin_ = block_begin;
+    const char* data = text_.data() + block_begin;
+    // Неполный последний блок дополняется пробелами.
+    char padded[BLOCK_SIZE];
+
+    if (text_.size() - block_begin < BLOCK_SIZE) {
+        memset(padded, ' ', BLOCK_SIZE);
+        memcpy(padded, data, text_.size() - block_begin);
+        data = padded;
+    }
+
+    BuildMasks(data, space_mask_, forbidden_mask_);
+}
+
+bool HasForbiddenChars(string_view text) {
+    return any_of(text.begin(), text.end(), [](char c) {
+        return static_cast<unsigned char>(c) <= MAX_FORBIDDEN_CHAR;
+    });
+}
+
+vector<string> SplitIntoWords(string_view text) {
     vector<string> result;
-    str.remove_prefix(min(str.size(), str.find_first_not_of(' ')));
-    const int64_t pos_end = str.npos;
 
-    while (!str.empty()) {
-        int64_t space = str.find(' ');
-        result.push_back(space == pos_end ? string(str) : string(str.substr(0, str.find(' '))));
-        str.remove_prefix(min(str.size(), str.find(' ')));
-        str.remove_prefix(min(str.size(), str.find_first_not_of(' ')));
+    for (WordTokenizer tokenizer(text); tokenizer.Next();) {
+        result.emplace_back(tokenizer.GetWord());
     }
 
     return result;
@@ -19,17 +182,10 @@ vector<string> SplitIntoWords(string_view str) {
 
 vector<string_view> SplitIntoWordsView(string_view str) {
     vector<string_view> result;
-    str.remove_prefix(min(str.size(), str.find_first_not_of(' ')));
-    const int64_t pos_end = str.npos;
 
-    while (!str.empty()) {
-        int64_t space = str.find(' ');
-        result.push_back(space == pos_end ? str : str.substr(0, str.find(' ')));
-        str.remove_prefix(min(str.size(), str.find(' ')));
-        str.remove_prefix(min(str.size(), str.find_first_not_of(' ')));
+    for (WordTokenizer tokenizer(str); tokenizer.Next();) {
+        result.push_back(tokenizer.GetWord());
     }
 
     return result;
 }
-
-
@@ -5,6 +5,43 @@
 #include <set>
 #include <string_view>
 #include <algorithm>
+#include <cstddef>
+#include <cstdint>
+
+// Ленивый разбор текста на слова, разделённые пробелами, без выделения памяти. Текст просматривается
+// блоками по 64 байта: для блока за один проход строятся битовые маски пробелов и управляющих символов
+// (коды 0-31, запрещённые в словах), а границы слов находятся по маскам. На x86-64 маски строятся инструкциями
+// AVX2 по 32 байта, если их поддерживает процессор, иначе SSE2 по 16 байт; на других платформах - побайтно.
+class WordTokenizer {
+public:
+    explicit WordTokenizer(std::string_view text);
+
+    // Переходит к следующему слову; false, если слов больше нет.
+    bool Next();
+
+    std::string_view GetWord() const;
+
+    // Есть ли в текущем слове управляющие символы.
+    bool HasForbiddenChars() const;
+
+private:
+    static const size_t BLOCK_SIZE = 64;
+
+    std::string_view text_;
+    // Начало текущего блока и маски его байтов; байты за концом текста считаются пробелами.
+    size_t block_begin_ = 0;
+    uint64_t space_mask_ = 0;
+    uint64_t forbidden_mask_ = 0;
+    // Первый ещё не разобранный байт.
+    size_t position_ = 0;
+    std::string_view word_;
+    bool has_forbidden_chars_ = false;
+
+    void LoadBlock(size_t block_begin);
+};
+
+// Есть ли в тексте управляющие символы (коды 0-31).
+bool HasForbiddenChars(std::string_view text);
 
 std::vector<std::string> SplitIntoWords(std::string_view text);
 
@@ -0,0 +1,144 @@
+#include "term_dictionary.h"
+#include "index_snapshot.h"
+#include <algorithm>
+#include <cstring>
+#include <iterator>
+
+using namespace std;
+
+string_view StringPool::Store(string_view str) {
+    lock_guard lock(mutex_);
+
+    if (str.size() > BLOCK_SIZE / 4) {
+        // Длинные строки получают собственный блок, чтобы не оставлять пустым хвост текущего.
+        const auto& block = large_blocks_.emplace_back(make_unique<char[]>(str.size()));
+        allocated_bytes_ += str.size();
+        memcpy(block.get(), str.data(), str.size());
+        return {block.get(), str.size()};
+    }
+
+    if (blocks_.empty() || block_used_ + str.size() > BLOCK_SIZE) {
+        blocks_.emplace_back(make_unique<char[]>(BLOCK_SIZE));
+        allocated_bytes_ += BLOCK_SIZE;
+        block_used_ = 0;
+    }
+
+    char* dst = blocks_.back().get() + block_used_;
+    memcpy(dst, str.data(), str.size());
+    block_used_ += str.size();
+
+    return {dst, str.size()};
+}
+
+size_t StringPool::GetAllocatedBytes() const {
+    lock_guard lock(mutex_);
+    return allocated_bytes_;
+}
+
+TermId TermDictionary::Intern(string_view word) {
+
+    if (const auto term = Find(word)) {
+        return *term;
+    }
+
+    const string_view stored = pool_->Store(word);
+    const TermId term = static_cast<TermId>(size());
+    tail_.terms.push_back(stored);
+    tail_.term_ids.emplace(stored, term);
+
+    if (tail_.terms.size() == MAX_TAIL_SIZE) {
+        SealTail();
+    }
+
+    return term;
+}
+
+optional<TermId> TermDictionary::Find(string_view word) const {
+
+    for (const auto& level: levels_) {
+        if (const auto it = level->term_ids.find(word); it != level->term_ids.end()) {
+            return it->second;
+        }
+    }
+
+    if (const auto it = tail_.term_ids.find(word); it != tail_.term_ids.end()) {
+        return it->second;
+    }
+
+    return nullopt;
+}
+
+string_view TermDictionary::GetTerm(TermId term) const {
+
+    if (term >= tail_.first_term) {
+        return tail_.terms.at(term - tail_.first_term);
+    }
+
+    const auto level = prev(upper_bound(levels_.begin(), levels_.end(), term,
+                                        [](TermId value, const shared_ptr<const Level>& level) {
+                                            return value < level->first_term;
+                                        }));
+    return (*level)->terms[term - (*level)->first_term];
+}
+
+size_t TermDictionary::size() const {
+    return tail_.first_term + tail_.terms.size();
+}
+
+void TermDictionary::Save(SnapshotWriter& writer) const {
+    writer.Write(static_cast<uint64_t>(size()));
+
+    for (const auto& level: levels_) {
+        for (const string_view term: level->terms) {
+            writer.WriteString(term);
+        }
+    }
+    for (const string_view term: tail_.terms) {
+        writer.WriteString(term);
+    }
+}
+
+TermDictionary TermDictionary::Load(SnapshotReader& reader) {
+    TermDictionary dictionary;
+    const auto term_count = reader.Read<uint64_t>();
+    Level& level = dictionary.tail_;
+    level.term_ids.reserve(term_count);
+
+    for (uint64_t term = 0; term < term_count; ++term) {
+        const string_view word = reader.ReadString();
+        level.terms.push_back(word);
+        level.term_ids.emplace(word, static_cast<TermId>(term));
+    }
+
+    dictionary.SealTail();
+
+    return dictionary;
+}
+
+void TermDictionary::SealTail() {
+    const TermId next_term = static_cast<TermId>(size());
+
+    if (!tail_.terms.empty()) {
+        levels_.push_back(make_shared<const Level>(move(tail_)));
+    }
+
+    // Слияние уровня с предыдущим, не большим его, оставляет O(log) уровней, а каждое слово копируется
+    // при слияниях O(log) раз.
+    while (levels_.size() >= 2 && levels_[levels_.size() - 2]->terms.size() <= levels_.back()->terms.size()) {
+        const Level& first = *levels_[levels_.size() - 2];
+        const Level& second = *levels_.back();
+        auto merged = make_shared<Level>();
+        merged->first_term = first.first_term;
+        merged->terms.reserve(first.terms.size() + second.terms.size());
+        merged->terms.insert(merged->terms.end(), first.terms.begin(), first.terms.end());
+        merged->terms.insert(merged->terms.end(), second.terms.begin(), second.terms.end());
+        merged->term_ids.reserve(merged->terms.size());
+        merged->term_ids.insert(first.term_ids.begin(), first.term_ids.end());
+        merged->term_ids.insert(second.term_ids.begin(), second.term_ids.end());
+        levels_.pop_back();
+        levels_.back() = move(merged);
+    }
+
+    tail_ = Level();
+    tail_.first_term = next_term;
+}
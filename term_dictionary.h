@@ -0,0 +1,74 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+class SnapshotReader;
+class SnapshotWriter;
+
+using TermId = uint32_t;
+
+// Пул строк: память выделяется крупными блоками и не перемещается,
+// поэтому выданные string_view остаются валидными всё время жизни пула. Пополнять пул можно из разных потоков;
+// чтение выданных строк блокировок не требует.
+class StringPool {
+public:
+    std::string_view Store(std::string_view str);
+
+    size_t GetAllocatedBytes() const;
+
+private:
+    static const size_t BLOCK_SIZE = 64 * 1024;
+
+    mutable std::mutex mutex_;
+    std::vector<std::unique_ptr<char[]>> blocks_;
+    std::vector<std::unique_ptr<char[]>> large_blocks_;
+    size_t block_used_ = 0;
+    size_t allocated_bytes_ = 0;
+};
+
+// Словарь термов: каждое различное слово хранится один раз и получает плотный id.
+// Копии словаря делят пул строк: строки в нём только добавляются и не перемещаются, поэтому слова копии
+// остаются валидными, пока жива хотя бы одна копия. Пул пополняется под блокировкой, поэтому разные копии
+// можно пополнять одновременно из разных потоков; одну копию - по-прежнему из одного потока.
+// Слова разбиты на уровни по диапазонам id: новые слова попадают в небольшой изменяемый хвост, заполненный хвост
+// становится неизменяемым уровнем, общим для копий, а соседние уровни близкого размера сливаются. Поэтому копия
+// словаря стоит O(размера хвоста), а не O(числа слов).
+class TermDictionary {
+public:
+    TermId Intern(std::string_view word);
+
+    std::optional<TermId> Find(std::string_view word) const;
+
+    std::string_view GetTerm(TermId term) const;
+
+    size_t size() const;
+
+    void Save(SnapshotWriter& writer) const;
+
+    // Слова загруженного словаря ссылаются на память снимка, новые слова попадают в пул.
+    static TermDictionary Load(SnapshotReader& reader);
+
+private:
+    static const size_t MAX_TAIL_SIZE = 4096;
+
+    // Слова с id из [first_term, first_term + terms.size()).
+    struct Level {
+        TermId first_term = 0;
+        std::vector<std::string_view> terms;
+        std::unordered_map<std::string_view, TermId> term_ids;
+    };
+
+    std::shared_ptr<StringPool> pool_ = std::make_shared<StringPool>();
+    // По возрастанию id.
+    std::vector<std::shared_ptr<const Level>> levels_;
+    Level tail_;
+
+    void SealTail();
+};
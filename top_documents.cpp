@@ -0,0 +1,76 @@
+#include "top_documents.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+using namespace std;
+
+bool IsRankedHigher(const Document& lhs, const Document& rhs) {
+
+    if (abs(lhs.relevance - rhs.relevance) < EPSILON) {
+        return lhs.rating > rhs.rating;
+    }
+
+    return lhs.relevance > rhs.relevance;
+}
+
+namespace {
+
+// Куча под столько документов выделяется сразу, чтобы не расти по одному; большие топы растут как вектор.
+const size_t MAX_RESERVED_CAPACITY = 64;
+
+// Порядок в куче: IsRankedHigher, а при равенстве по нему - меньший id.
+bool IsSelectedBefore(const Document& lhs, const Document& rhs) {
+
+    if (abs(lhs.relevance - rhs.relevance) < EPSILON && lhs.rating == rhs.rating) {
+        return lhs.id < rhs.id;
+    }
+
+    return IsRankedHigher(lhs, rhs);
+}
+
+} // namespace
+
+TopDocuments::TopDocuments(size_t capacity) : capacity_(capacity) {
+}
+
+void TopDocuments::Push(const Document& document) {
+
+    if (heap_.size() < capacity_) {
+        if (heap_.empty()) {
+            heap_.reserve(min(capacity_, MAX_RESERVED_CAPACITY));
+        }
+        heap_.push_back(document);
+        push_heap(heap_.begin(), heap_.end(), IsSelectedBefore);
+    } else if (capacity_ > 0 && IsSelectedBefore(document, heap_.front())) {
+        pop_heap(heap_.begin(), heap_.end(), IsSelectedBefore);
+        heap_.back() = document;
+        push_heap(heap_.begin(), heap_.end(), IsSelectedBefore);
+    }
+}
+
+void TopDocuments::Merge(const TopDocuments& other) {
+
+    for (const Document& document: other.heap_) {
+        Push(document);
+    }
+}
+
+double TopDocuments::GetEntryThreshold() const {
+
+    if (capacity_ == 0) {
+        return numeric_limits<double>::infinity();
+    }
+
+    if (heap_.size() < capacity_) {
+        return -numeric_limits<double>::infinity();
+    }
+
+    // При разнице релевантностей меньше EPSILON исход решает рейтинг.
+    return heap_.front().relevance - EPSILON;
+}
+
+vector<Document> TopDocuments::Extract() {
+    sort_heap(heap_.begin(), heap_.end(), IsSelectedBefore);
+    return move(heap_);
+}
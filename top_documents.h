@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+#include "document.h"
+
+static const double EPSILON = 1e-6;
+
+// Порядок выдачи: по убыванию релевантности, при равной с точностью EPSILON - по убыванию рейтинга.
+bool IsRankedHigher(const Document& lhs, const Document& rhs);
+
+// Ограниченная куча лучших документов: хранит не более capacity документов,
+// в вершине кучи - худший из отобранных. Документы, равные по IsRankedHigher, куча различает по id,
+// чтобы отбор не зависел от порядка обхода.
+class TopDocuments {
+public:
+    explicit TopDocuments(size_t capacity);
+
+    void Push(const Document& document);
+
+    void Merge(const TopDocuments& other);
+
+    // Документ с релевантностью не выше порога гарантированно не попадёт в топ.
+    // Пока топ не заполнен, порог равен минус бесконечности.
+    double GetEntryThreshold() const;
+
+    // Возвращает отобранные документы, упорядоченные от лучшего к худшему.
+    std::vector<Document> Extract();
+
+private:
+    size_t capacity_;
+    std::vector<Document> heap_;
+};
\ No newline at end of file
@@ -0,0 +1,350 @@
+#include "write_ahead_log.h"
+#include "index_snapshot.h"
+#include "search_server.h"
+
+#include <cstring>
+#include <execution>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+#include <unordered_set>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+using namespace std;
+
+namespace {
+
+// Запись журнала: размер данных (uint32), контрольная сумма данных (uint64), данные.
+const size_t RECORD_HEADER_SIZE = sizeof(uint32_t) + sizeof(uint64_t);
+
+template<typename T>
+void Put(vector<char>& out, const T& value) {
+    const auto* bytes = reinterpret_cast<const char*>(&value);
+    out.insert(out.end(), bytes, bytes + sizeof(T));
+}
+
+template<typename T>
+bool Get(const char*& in, const char* end, T& value) {
+
+    if (static_cast<size_t>(end - in) < sizeof(T)) {
+        return false;
+    }
+
+    memcpy(&value, in, sizeof(T));
+    in += sizeof(T);
+    return true;
+}
+
+uint64_t ComputeChecksum(const char* data, size_t size) {
+    SnapshotChecksum checksum;
+    checksum.Update(data, size);
+    return checksum.Get();
+}
+
+void EncodeRecord(const LogRecord& record, vector<char>& out) {
+    const size_t header_begin = out.size();
+    out.resize(header_begin + RECORD_HEADER_SIZE);
+    const size_t payload_begin = out.size();
+
+    Put(out, record.sequence);
+    Put(out, record.type);
+    if (record.type == LogRecord::Type::BATCH) {
+        Put(out, record.batch_size);
+    }
+    Put(out, record.document_id);
+    Put(out, record.status);
+    Put(out, static_cast<uint32_t>(record.ratings.size()));
+    for (const int rating: record.ratings) {
+        Put(out, rating);
+    }
+    Put(out, static_cast<uint32_t>(record.text.size()));
+    out.insert(out.end(), record.text.begin(), record.text.end());
+
+    const auto payload_size = static_cast<uint32_t>(out.size() - payload_begin);
+    const uint64_t checksum = ComputeChecksum(out.data() + payload_begin, payload_size);
+    memcpy(out.data() + header_begin, &payload_size, sizeof(payload_size));
+    memcpy(out.data() + header_begin + sizeof(payload_size), &checksum, sizeof(checksum));
+}
+
+// Разбирает запись из [in, end) и сдвигает in за неё. Оборванная или повреждённая запись не разбирается.
+bool DecodeRecord(const char*& in, const char* end, LogRecord& record) {
+    const char* position = in;
+    uint32_t payload_size;
+    uint64_t checksum;
+
+    if (!Get(position, end, payload_size) || !Get(position, end, checksum)
+        || static_cast<size_t>(end - position) < payload_size
+        || ComputeChecksum(position, payload_size) != checksum) {
+        return false;
+    }
+
+    const char* payload_end = position + payload_size;
+    uint32_t rating_count;
+    uint32_t text_size;
+
+    if (!Get(position, payload_end, record.sequence) || !Get(position, payload_end, record.type)) {
+        return false;
+    }
+
+    record.batch_size = 0;
+
+    if ((record.type == LogRecord::Type::BATCH && !Get(position, payload_end, record.batch_size))
+        || !Get(position, payload_end, record.document_id) || !Get(position, payload_end, record.status)
+        || !Get(position, payload_end, rating_count)) {
+        return false;
+    }
+
+    record.ratings.resize(min<size_t>(rating_count, (payload_end - position) / sizeof(int)));
+    for (int& rating: record.ratings) {
+        Get(position, payload_end, rating);
+    }
+
+    if (record.ratings.size() != rating_count || !Get(position, payload_end, text_size)
+        || static_cast<size_t>(payload_end - position) != text_size) {
+        return false;
+    }
+
+    record.text.assign(position, payload_end);
+    in = payload_end;
+    return true;
+}
+
+string ReadFile(const string& path) {
+    ifstream in(path, ios::binary);
+    return {istreambuf_iterator<char>(in), istreambuf_iterator<char>()};
+}
+
+// Разбирает записи data до первой повреждённой и передаёт их on_record, кроме записей BATCH. Пакет передаётся,
+// только если дописан целиком. Возвращает длину разобранной части без оборванного пакета.
+template<typename RecordHandler>
+size_t DecodeRecords(const string& data, RecordHandler on_record) {
+    const char* const begin = data.data();
+    const char* position = begin;
+    const char* complete_end = begin;
+    vector<LogRecord> batch;
+    size_t batch_remaining = 0;
+    LogRecord record;
+
+    while (DecodeRecord(position, begin + data.size(), record)) {
+        if (record.type == LogRecord::Type::BATCH) {
+            if (batch_remaining > 0) {
+                break;
+            }
+            batch_remaining = record.batch_size;
+        } else if (batch_remaining > 0) {
+            batch.push_back(move(record));
+            --batch_remaining;
+        } else {
+            on_record(move(record));
+        }
+
+        if (batch_remaining == 0) {
+            for (LogRecord& batch_record: batch) {
+                on_record(move(batch_record));
+            }
+            batch.clear();
+            complete_end = position;
+        }
+    }
+
+    return complete_end - begin;
+}
+
+} // namespace
+
+WriteAheadLog::WriteAheadLog(const string& path) {
+    // Целые записи остаются, хвост после них - след сбоя посреди записи.
+    durable_size_ = static_cast<off_t>(DecodeRecords(ReadFile(path), [this](LogRecord&& record) {
+        appended_sequence_ = record.sequence;
+    }));
+    durable_sequence_ = appended_sequence_;
+    fd_ = open(path.c_str(), O_WRONLY | O_CREAT, 0644);
+
+    if (fd_ < 0 || ftruncate(fd_, durable_size_) != 0 || lseek(fd_, 0, SEEK_END) < 0) {
+        if (fd_ >= 0) {
+            close(fd_);
+        }
+        throw runtime_error("Cannot open log "s + path);
+    }
+}
+
+WriteAheadLog::~WriteAheadLog() {
+    close(fd_);
+}
+
+void WriteAheadLog::Append(const LogRecord& record) {
+    lock_guard lock(mutex_);
+
+    if (is_failed_) {
+        throw runtime_error("Log is unusable after a write error"s);
+    }
+
+    EncodeRecord(record, buffer_);
+    appended_sequence_ = record.sequence;
+}
+
+void WriteAheadLog::AppendBatch(const vector<LogRecord>& records) {
+
+    if (records.empty()) {
+        return;
+    }
+
+    lock_guard lock(mutex_);
+
+    if (is_failed_) {
+        throw runtime_error("Log is unusable after a write error"s);
+    }
+
+    LogRecord header;
+    header.sequence = records.front().sequence - 1;
+    header.type = LogRecord::Type::BATCH;
+    header.batch_size = static_cast<uint32_t>(records.size());
+    EncodeRecord(header, buffer_);
+
+    for (const LogRecord& record: records) {
+        EncodeRecord(record, buffer_);
+    }
+
+    appended_sequence_ = records.back().sequence;
+}
+
+void WriteAheadLog::Sync(uint64_t sequence) {
+    unique_lock lock(mutex_);
+
+    while (durable_sequence_ < sequence) {
+        if (is_failed_) {
+            throw runtime_error("Log is unusable after a write error"s);
+        }
+        if (is_syncing_) {
+            synced_.wait(lock);
+            continue;
+        }
+
+        // Этот поток становится ведущим и записывает всё накопленное, пока остальные ждут или пополняют буфер.
+        is_syncing_ = true;
+        vector<char> batch;
+        batch.swap(buffer_);
+        const uint64_t batch_sequence = appended_sequence_;
+        lock.unlock();
+
+        bool is_written = true;
+        try {
+            WriteAll(batch);
+        } catch (...) {
+            is_written = false;
+        }
+
+        lock.lock();
+        is_syncing_ = false;
+        synced_.notify_all();
+
+        if (!is_written) {
+            // Ни одна запись после сбоя не попадает на диск: иначе изменение, о неудаче которого узнал писатель,
+            // сохранила бы синхронизация другого потока. Недописанный хвост отрезается, чтобы журнал читался.
+            is_failed_ = true;
+            if (ftruncate(fd_, durable_size_) == 0) {
+                lseek(fd_, durable_size_, SEEK_SET);
+            }
+            throw runtime_error("Cannot write log"s);
+        }
+
+        durable_sequence_ = batch_sequence;
+        durable_size_ += static_cast<off_t>(batch.size());
+        ++sync_count_;
+    }
+}
+
+void WriteAheadLog::Reset() {
+    unique_lock lock(mutex_);
+    synced_.wait(lock, [this] {
+        return !is_syncing_;
+    });
+
+    buffer_.clear();
+
+    if (ftruncate(fd_, 0) != 0 || lseek(fd_, 0, SEEK_SET) < 0 || fdatasync(fd_) != 0) {
+        throw runtime_error("Cannot reset log"s);
+    }
+
+    // Ждущие Sync потоки отпускаются: их записи уже сохранены в снимке.
+    durable_sequence_ = appended_sequence_;
+    durable_size_ = 0;
+    is_failed_ = false;
+    synced_.notify_all();
+}
+
+uint64_t WriteAheadLog::GetDurableSequence() const {
+    lock_guard lock(mutex_);
+    return durable_sequence_;
+}
+
+size_t WriteAheadLog::GetSyncCount() const {
+    lock_guard lock(mutex_);
+    return sync_count_;
+}
+
+vector<LogRecord> WriteAheadLog::Read(const string& path) {
+    vector<LogRecord> records;
+    DecodeRecords(ReadFile(path), [&records](LogRecord&& record) {
+        records.push_back(move(record));
+    });
+    return records;
+}
+
+void WriteAheadLog::WriteAll(const vector<char>& data) {
+
+    for (size_t written = 0; written < data.size();) {
+        const ssize_t result = write(fd_, data.data() + written, data.size() - written);
+        if (result < 0) {
+            throw runtime_error("Cannot write log"s);
+        }
+        written += result;
+    }
+
+    if (fdatasync(fd_) != 0) {
+        throw runtime_error("Cannot sync log"s);
+    }
+}
+
+size_t ReplayLog(const string& path, SearchServer& search_server) {
+    const vector<LogRecord> records = WriteAheadLog::Read(path);
+    vector<DocumentData> batch;
+    unordered_set<int> batch_ids;
+    size_t replayed_count = 0;
+
+    const auto apply_batch = [&] {
+        search_server.AddDocuments(execution::par, batch);
+        replayed_count += batch.size();
+        batch.clear();
+        batch_ids.clear();
+    };
+
+    for (const LogRecord& record: records) {
+        if (record.sequence <= search_server.GetGeneration() + batch.size()) {
+            continue;
+        }
+        if (record.sequence != search_server.GetGeneration() + batch.size() + 1) {
+            throw runtime_error("Log has a gap before record "s + to_string(record.sequence));
+        }
+
+        if (record.type == LogRecord::Type::ADD) {
+            batch.push_back({record.document_id, record.text, record.status, record.ratings});
+            batch_ids.insert(record.document_id);
+            continue;
+        }
+
+        if (batch_ids.count(record.document_id)) {
+            apply_batch();
+        }
+        search_server.RemoveDocument(record.document_id);
+        ++replayed_count;
+    }
+
+    if (!batch.empty()) {
+        apply_batch();
+    }
+
+    return replayed_count;
+}
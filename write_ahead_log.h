@@ -0,0 +1,90 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <sys/types.h>
+
+#include "document.h"
+
+class SearchServer;
+
+// Изменение документа в журнале. Номер записи - поколение сервера после изменения (SearchServer::GetGeneration).
+// Запись BATCH в файле открывает пакет из batch_size следующих за ней записей, её номер - поколение до пакета.
+struct LogRecord {
+    enum class Type : uint8_t {
+        ADD,
+        REMOVE,
+        BATCH,
+    };
+
+    uint64_t sequence = 0;
+    Type type = Type::ADD;
+    int document_id = 0;
+    DocumentStatus status = DocumentStatus::ACTUAL;
+    std::vector<int> ratings;
+    std::string text;
+    uint32_t batch_size = 0;
+};
+
+// Журнал упреждающей записи: изменения дописываются в конец файла записями с контрольной суммой.
+// Фиксация групповая: записи копятся в памяти, и первый из ждущих Sync потоков записывает и синхронизирует
+// с диском всё накопленное, в том числе записи потоков, которые пришли, пока шла предыдущая синхронизация.
+// После ошибки записи оборванный хвост отрезается от файла, и журнал отказывает в Append и Sync до Reset.
+class WriteAheadLog {
+public:
+    // Открывает журнал для дописывания; оборванный при сбое хвост отбрасывается.
+    explicit WriteAheadLog(const std::string& path);
+
+    WriteAheadLog(const WriteAheadLog&) = delete;
+
+    WriteAheadLog& operator=(const WriteAheadLog&) = delete;
+
+    ~WriteAheadLog();
+
+    // Номера записей должны возрастать. Запись не попадает на диск до вызова Sync.
+    void Append(const LogRecord& record);
+
+    // Дописывает записи пакетом: при восстановлении пакет, оборванный сбоем, отбрасывается целиком.
+    void AppendBatch(const std::vector<LogRecord>& records);
+
+    // Возвращает, когда записи с номерами до sequence включительно окажутся на диске.
+    void Sync(uint64_t sequence);
+
+    // Очищает журнал, когда его записи уже сохранены в снимке.
+    void Reset();
+
+    // Номер последней записи, которая уже на диске.
+    uint64_t GetDurableSequence() const;
+
+    // Сколько раз журнал синхронизировался с диском.
+    size_t GetSyncCount() const;
+
+    // Целые записи журнала по порядку, без записей BATCH; чтение останавливается на первой повреждённой записи,
+    // и записи недописанного пакета перед ней отбрасываются.
+    static std::vector<LogRecord> Read(const std::string& path);
+
+private:
+    int fd_ = -1;
+    mutable std::mutex mutex_;
+    std::condition_variable synced_;
+    std::vector<char> buffer_;
+    uint64_t appended_sequence_ = 0;
+    uint64_t durable_sequence_ = 0;
+    // Длина файла, занятая записями, которые уже на диске.
+    off_t durable_size_ = 0;
+    bool is_failed_ = false;
+    bool is_syncing_ = false;
+    size_t sync_count_ = 0;
+
+    void WriteAll(const std::vector<char>& data);
+};
+
+// Применяет к серверу записи журнала с номерами больше его поколения. Добавления подряд идущих документов
+// применяются пакетом с параллельным разбором текстов; удаление документа, добавляемого в текущем пакете,
+// дожидается пакета. Возвращает число применённых записей.
+size_t ReplayLog(const std::string& path, SearchServer& search_server);